@@ -0,0 +1,54 @@
+/** @file
+ *
+ * @brief Millisecond time base shared by the application modules.
+ */
+
+#include "app_clock.h"
+
+#include "app_util_platform.h"
+
+static TickType_t m_last_ticks;                                        /**< Tick count of the last reading. */
+static uint32_t   m_wraps;                                             /**< Wrap-arounds of the tick counter. */
+
+
+/**@brief Converts a tick count to milliseconds, counting the wrap-arounds of the tick counter.
+ *
+ * @details Must be called from a critical region which also covers reading the tick count, or a
+ *          reading preempted by a newer one would be taken for a wrap-around.
+ */
+static uint32_t ticks_to_ms(TickType_t ticks)
+{
+    if (ticks < m_last_ticks)
+    {
+        m_wraps++;
+    }
+
+    m_last_ticks = ticks;
+
+    // Truncating the 64-bit product keeps the result continuous modulo 2^32.
+    return (uint32_t)(((((uint64_t)m_wraps << 32) | ticks) * 1000) / configTICK_RATE_HZ);
+}
+
+
+uint32_t app_clock_ms(void)
+{
+    uint32_t ms;
+
+    CRITICAL_REGION_ENTER();
+    ms = ticks_to_ms(xTaskGetTickCount());
+    CRITICAL_REGION_EXIT();
+
+    return ms;
+}
+
+
+uint32_t app_clock_ms_from_isr(void)
+{
+    uint32_t ms;
+
+    CRITICAL_REGION_ENTER();
+    ms = ticks_to_ms(xTaskGetTickCountFromISR());
+    CRITICAL_REGION_EXIT();
+
+    return ms;
+}
@@ -0,0 +1,76 @@
+/** @file
+ *
+ * @defgroup app_clock Application clock
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Millisecond time base shared by the application modules.
+ *
+ * @details All application modules keep their deadlines in milliseconds derived from the
+ *          FreeRTOS tick counter. The tick counter is extended by the number of its wrap-arounds
+ *          before the conversion, so the millisecond time wraps modulo 2^32 like the tick counter
+ *          does and intervals stay exact across the tick wrap after 48.5 days. A wrap is only
+ *          noticed if the time is read at least once per tick counter period. Deadlines must be
+ *          compared with @ref app_clock_expired, which is safe across wrap-around.
+ *
+ *          Short intervals are measured with timestamps of the RTC which drives the FreeRTOS
+ *          tick. They keep running while the CPU sleeps and have a resolution of 30.5 us, but
+ *          wrap around after 512 s.
+ */
+
+#ifndef APP_CLOCK_H__
+#define APP_CLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "nrf_rtc.h"
+#include "task.h"
+
+#define APP_CLOCK_NO_DEADLINE    UINT32_MAX                          /**< Returned by process functions that have nothing scheduled. */
+#define APP_CLOCK_STAMP_RTC      NRF_RTC1                            /**< RTC instance of the FreeRTOS port. */
+#define APP_CLOCK_STAMP_HZ       32768                               /**< Timestamp frequency. */
+#define APP_CLOCK_STAMP_MASK     0x00FFFFFF                          /**< Width of the RTC counter. */
+
+/**@brief Returns current time in milliseconds. Must be called from task context. */
+uint32_t app_clock_ms(void);
+
+
+/**@brief Returns current time in milliseconds. Must be called from interrupt context. */
+uint32_t app_clock_ms_from_isr(void);
+
+
+/**@brief Checks whether a deadline has passed.
+ *
+ * @param[in] now       Current time in milliseconds.
+ * @param[in] deadline  Deadline in milliseconds.
+ */
+static inline bool app_clock_expired(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+
+/**@brief Returns the number of milliseconds left until a deadline, or 0 if it has passed. */
+static inline uint32_t app_clock_remaining(uint32_t now, uint32_t deadline)
+{
+    return app_clock_expired(now, deadline) ? 0 : (deadline - now);
+}
+
+/**@brief Returns a timestamp for measuring short intervals. May be called from any context. */
+static inline uint32_t app_clock_stamp(void)
+{
+    return nrf_rtc_counter_get(APP_CLOCK_STAMP_RTC);
+}
+
+
+/**@brief Returns the microseconds between two timestamps, which must be less than 512 s apart. */
+static inline uint32_t app_clock_stamp_us(uint32_t from, uint32_t to)
+{
+    return (uint32_t)((((uint64_t)((to - from) & APP_CLOCK_STAMP_MASK)) * 1000000) / APP_CLOCK_STAMP_HZ);
+}
+
+#endif // APP_CLOCK_H__
+
+/** @} */
@@ -0,0 +1,347 @@
+/** @file
+ *
+ * @brief Deferred processing and optional binary mode of the NRF_LOG macros.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "SEGGER_RTT.h"
+
+#define NRF_LOG_MODULE_NAME LOG
+#include "app_log.h"
+#include "nrf_log_ctrl.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define BACKEND_RTT_CHANNEL    0                                       /**< RTT up channel of the NRF_LOG backend. */
+
+static app_log_stats_t m_stats;                                        /**< Log statistics. */
+static volatile bool   m_pending;                                      /**< Whether entries have been written since the idle hook looked. */
+static app_log_limit_t * mp_limits;                                    /**< Registered rate-limited call sites. */
+
+#define LIMIT_WINDOW_STAMPS    ((uint32_t)(((uint64_t)APP_LOG_LIMIT_WINDOW_MS * APP_CLOCK_STAMP_HZ) / 1000))
+
+STATIC_ASSERT(LIMIT_WINDOW_STAMPS <= APP_CLOCK_STAMP_MASK / 2);
+
+#if APP_LOG_BINARY
+
+#define RECORD_HEADER_SIZE     6                                       /**< Offset, argument count and timestamp. */
+
+static uint8_t         m_rtt_buffer[APP_LOG_RTT_BUFFER_SIZE];          /**< RTT up buffer. */
+static uint32_t        m_dropped;                                      /**< Records dropped since the last one written. */
+
+
+static void header_encode(uint8_t * p_record, uint16_t id, uint8_t count)
+{
+    uint32_t stamp = app_clock_stamp();
+
+    UNUSED_RETURN_VALUE(uint16_encode(id, &p_record[0]));
+    p_record[2] = count;
+    p_record[3] = (uint8_t)stamp;
+    p_record[4] = (uint8_t)(stamp >> 8);
+    p_record[5] = (uint8_t)(stamp >> 16);
+}
+
+
+/**@brief Writes a record, preceded by the number of records dropped before it. */
+static void record_put(const uint8_t * p_record, uint16_t len)
+{
+    CRITICAL_REGION_ENTER();
+
+    m_stats.entries++;
+
+    if (m_dropped > 0)
+    {
+        uint8_t dropped[RECORD_HEADER_SIZE + sizeof(uint32_t)];
+
+        header_encode(dropped, APP_LOG_ID_DROPPED, 1);
+        UNUSED_RETURN_VALUE(uint32_encode(m_dropped, &dropped[RECORD_HEADER_SIZE]));
+
+        if (SEGGER_RTT_WriteNoLock(APP_LOG_RTT_CHANNEL, dropped, sizeof(dropped)) != 0)
+        {
+            m_dropped = 0;
+        }
+    }
+
+    // In skip mode a record is written completely or not at all.
+    if ((m_dropped > 0) || (SEGGER_RTT_WriteNoLock(APP_LOG_RTT_CHANNEL, p_record, len) == 0))
+    {
+        m_dropped++;
+        m_stats.dropped++;
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_log_init(void)
+{
+    UNUSED_RETURN_VALUE(SEGGER_RTT_ConfigUpBuffer(APP_LOG_RTT_CHANNEL,
+                                                  "AppLog",
+                                                  m_rtt_buffer,
+                                                  sizeof(m_rtt_buffer),
+                                                  SEGGER_RTT_MODE_NO_BLOCK_SKIP));
+}
+
+
+void app_log_write(uint32_t id, uint8_t nargs, const uint32_t * p_args)
+{
+    uint8_t record[RECORD_HEADER_SIZE + APP_LOG_ARGS_MAX * sizeof(uint32_t)];
+
+    nargs = MIN(nargs, APP_LOG_ARGS_MAX);
+    header_encode(record, (uint16_t)id, nargs);
+
+    for (uint8_t i = 0; i < nargs; i++)
+    {
+        UNUSED_RETURN_VALUE(uint32_encode(p_args[i], &record[RECORD_HEADER_SIZE + i * sizeof(uint32_t)]));
+    }
+
+    record_put(record, RECORD_HEADER_SIZE + nargs * sizeof(uint32_t));
+}
+
+
+void app_log_string(const char * p_string)
+{
+    uint8_t record[RECORD_HEADER_SIZE + UINT8_MAX];
+    size_t  len = MIN(strlen(p_string), UINT8_MAX);
+
+    header_encode(record, APP_LOG_ID_STRING, (uint8_t)len);
+    memcpy(&record[RECORD_HEADER_SIZE], p_string, len);
+
+    record_put(record, RECORD_HEADER_SIZE + len);
+}
+
+#else
+
+static uint32_t        m_buffered;                                     /**< Estimated bytes in the NRF_LOG buffer. */
+
+#if NRF_LOG_BACKEND_RTT_ENABLED
+static uint8_t         m_rtt_buffer[APP_LOG_RTT_BUFFER_SIZE];          /**< RTT up buffer of the lines written with app_log_string(). */
+#endif
+
+
+void app_log_init(void)
+{
+#if NRF_LOG_BACKEND_RTT_ENABLED
+    UNUSED_RETURN_VALUE(SEGGER_RTT_ConfigUpBuffer(APP_LOG_RTT_CHANNEL,
+                                                  "AppText",
+                                                  m_rtt_buffer,
+                                                  sizeof(m_rtt_buffer),
+                                                  SEGGER_RTT_MODE_NO_BLOCK_SKIP));
+#endif
+}
+
+
+void app_log_write(uint32_t id, uint8_t nargs, const uint32_t * p_args)
+{
+    UNUSED_PARAMETER(id);
+    UNUSED_PARAMETER(nargs);
+    UNUSED_PARAMETER(p_args);
+}
+
+
+void app_log_deferred(uint8_t nargs)
+{
+    uint32_t size = (APP_LOG_HEADER_WORDS + nargs) * sizeof(uint32_t);
+
+    CRITICAL_REGION_ENTER();
+
+    m_stats.entries++;
+
+    if (m_buffered + size > NRF_LOG_BUFSIZE)
+    {
+        // The entry replaces older ones or is discarded, depending on NRF_LOG_ALLOW_OVERFLOW.
+        m_stats.dropped++;
+    }
+    else
+    {
+        m_buffered        += size;
+        m_stats.high_water = MAX(m_stats.high_water, m_buffered);
+    }
+
+    m_pending = true;
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_log_string(const char * p_string)
+{
+#if NRF_LOG_BACKEND_RTT_ENABLED
+    char   line[UINT8_MAX + 2];
+    size_t len = MIN(strlen(p_string), UINT8_MAX);
+
+    memcpy(line, p_string, len);
+    line[len++] = '\r';
+    line[len++] = '\n';
+
+    CRITICAL_REGION_ENTER();
+
+    m_stats.entries++;
+
+    // The backend writes its channel from the logger task without a lock, so the lines go to a
+    // channel of their own. In skip mode a line is written completely or not at all.
+    if (SEGGER_RTT_WriteNoLock(APP_LOG_RTT_CHANNEL, line, len) == 0)
+    {
+        m_stats.dropped++;
+    }
+
+    CRITICAL_REGION_EXIT();
+#else
+    NRF_LOG_INFO("%s", NRF_LOG_PUSH((char *)p_string));
+#endif
+}
+
+#endif // APP_LOG_BINARY
+
+
+#if NRF_LOG_BACKEND_RTT_ENABLED
+/**@brief Waits until the RTT backend can take an entry without spinning, or gives up. */
+static void rtt_wait(void)
+{
+    for (uint8_t i = 0; i < APP_LOG_STALL_RETRIES; i++)
+    {
+        const SEGGER_RTT_BUFFER_UP * p_up  = &_SEGGER_RTT.aUp[BACKEND_RTT_CHANNEL];
+        uint32_t                     read  = p_up->RdOff;
+        uint32_t                     write = p_up->WrOff;
+        uint32_t                     space = (read > write) ? (read - write - 1)
+                                                            : (p_up->SizeOfBuffer - 1 - write + read);
+
+        if (space >= NRF_LOG_BACKEND_RTT_TEMP_BUFFER_SIZE)
+        {
+            return;
+        }
+
+        m_stats.stalls++;
+        vTaskDelay(pdMS_TO_TICKS(APP_LOG_STALL_MS));
+    }
+}
+#endif
+
+
+bool app_log_pending_take(void)
+{
+    bool pending = m_pending;
+
+    m_pending = false;
+
+    return pending;
+}
+
+
+/**@brief Logs the entries suppressed by call sites whose window expired without a further entry. */
+static void limits_flush(void)
+{
+    uint32_t now = app_clock_stamp();
+
+    for (app_log_limit_t * p_limit = mp_limits; p_limit != NULL; p_limit = p_limit->p_next)
+    {
+        uint32_t suppressed = 0;
+
+        CRITICAL_REGION_ENTER();
+
+        if (((now - p_limit->window_start) & APP_CLOCK_STAMP_MASK) >= LIMIT_WINDOW_STAMPS)
+        {
+            // The next entry of the call site then starts a window without a summary.
+            suppressed          = p_limit->suppressed;
+            p_limit->suppressed = 0;
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        if (suppressed > 0)
+        {
+            NRF_LOG_WARNING("%d entries suppressed at %s:%d.\r\n", suppressed, p_limit->p_file, p_limit->line);
+        }
+    }
+}
+
+
+void app_log_drain(void)
+{
+    bool more;
+
+    // Drained at least every APP_LOG_DRAIN_INTERVAL_MS, well within the wrap of the stamps.
+    limits_flush();
+
+#if !APP_LOG_BINARY
+    uint32_t buffered;
+
+    CRITICAL_REGION_ENTER();
+    buffered = m_buffered;
+    CRITICAL_REGION_EXIT();
+#endif
+
+    do
+    {
+#if NRF_LOG_BACKEND_RTT_ENABLED
+        rtt_wait();
+#endif
+        more = NRF_LOG_PROCESS();
+    } while (more);
+
+#if !APP_LOG_BINARY
+    // Entries written while draining stay accounted for until the next drain.
+    CRITICAL_REGION_ENTER();
+    m_buffered -= buffered;
+    CRITICAL_REGION_EXIT();
+#endif
+}
+
+
+bool app_log_limit_pass(app_log_limit_t * p_limit, uint32_t * p_suppressed)
+{
+    // The RTC counter can be read from any context, unlike the tick count.
+    uint32_t now  = app_clock_stamp();
+    bool     pass = false;
+
+    *p_suppressed = 0;
+
+    CRITICAL_REGION_ENTER();
+
+    // A call site idle for longer than the counter wrap may continue a stale window; it then
+    // logs at most APP_LOG_LIMIT_BURST entries too few.
+    if (!p_limit->started || (((now - p_limit->window_start) & APP_CLOCK_STAMP_MASK) >= LIMIT_WINDOW_STAMPS))
+    {
+        *p_suppressed         = p_limit->suppressed;
+        p_limit->window_start = now;
+        p_limit->count        = 0;
+        p_limit->suppressed   = 0;
+
+        if (!p_limit->started)
+        {
+            p_limit->started = true;
+            p_limit->p_next  = mp_limits;
+            mp_limits        = p_limit;
+        }
+    }
+
+    if (p_limit->count < APP_LOG_LIMIT_BURST)
+    {
+        p_limit->count++;
+        pass = true;
+    }
+    else
+    {
+        if (p_limit->suppressed < UINT16_MAX)
+        {
+            p_limit->suppressed++;
+        }
+        m_stats.suppressed++;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return pass;
+}
+
+
+const app_log_stats_t * app_log_stats_get(void)
+{
+    return &m_stats;
+}
@@ -0,0 +1,343 @@
+/** @file
+ *
+ * @defgroup app_log Application log
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Deferred processing and optional binary mode of the NRF_LOG macros.
+ *
+ * @details Modules include this header instead of nrf_log.h. Deferred entries are only stored
+ *          in the NRF_LOG buffer by their producers. The idle hook wakes the lowest priority
+ *          logger task with @ref app_log_pending_take, which formats them and passes them to the
+ *          backends with @ref app_log_drain, so logging never delays the Thread stack task. The
+ *          logger waits while the RTT buffer is full instead of letting the backend spin. The
+ *          fill level of the NRF_LOG buffer is not visible outside the SDK, so it is estimated
+ *          from the entries written. Entries of SDK modules are not accounted for, so the logger
+ *          also drains the buffer every @ref APP_LOG_DRAIN_INTERVAL_MS.
+ *
+ *          The level of each module is set by its <NAME>_LOG_LEVEL macro, which defaults to
+ *          @ref APP_LOG_DEFAULT_LEVEL. Like the SDK, entries are only enabled up to the lower of
+ *          the module level and NRF_LOG_DEFAULT_LEVEL, so raising a module level above the default
+ *          level has no effect. Entries of disabled levels leave neither code nor strings in
+ *          the image. The release log profile of the armgcc Makefile builds with errors only.
+ *
+ *          With @ref APP_LOG_BINARY set, the
+ *          NRF_LOG_ERROR, NRF_LOG_WARNING, NRF_LOG_INFO and NRF_LOG_DEBUG macros no longer format
+ *          text. Each call site stores its format string, prefixed with the level and the module
+ *          name, in the .log_dict section, which is kept in the ELF file but not loaded into
+ *          flash. At run time only the address of the string and the raw 32-bit arguments are
+ *          written to RTT channel @ref APP_LOG_RTT_CHANNEL. tools/app_log_decode.py extracts the
+ *          dictionary from the ELF file and turns the captured channel back into text.
+ *
+ *          Records are little-endian: the lower 16 bits of the format string address, the number of arguments, a
+ *          24-bit @ref app_clock_stamp timestamp and the arguments. A record which does not fit
+ *          into the RTT buffer is dropped as a whole and reported by the next record that fits.
+ *
+ *          Call sites that fire once per message use the rate-limited variants such as
+ *          @ref APP_LOG_INFO_LIMITED. Each call site keeps its own state: it logs the first
+ *          @ref APP_LOG_LIMIT_BURST entries of a window of @ref APP_LOG_LIMIT_WINDOW_MS and counts
+ *          the rest, so a busy call site can neither fill the buffers nor silence others. The
+ *          number of suppressed entries is logged ahead of the first entry of the next window,
+ *          or by @ref app_log_drain once the window has expired if the call site stays quiet.
+ *
+ * @note %s arguments are decoded only if they point to constant strings of the ELF file. Text
+ *       from RAM has to be written with @ref app_log_string.
+ */
+
+#ifndef APP_LOG_H__
+#define APP_LOG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nordic_common.h"
+#include "sdk_config.h"
+
+#ifndef APP_LOG_DEFAULT_LEVEL
+#define APP_LOG_DEFAULT_LEVEL     NRF_LOG_DEFAULT_LEVEL                /**< Log level of the application modules, unless set per module. */
+#endif
+
+/* Log levels of the application modules, by NRF_LOG_MODULE_NAME. Entries above the level of their
+   module, or above NRF_LOG_DEFAULT_LEVEL, are not compiled in. */
+#ifndef AGGREGATOR_LOG_LEVEL
+#define AGGREGATOR_LOG_LEVEL      APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef APP_LOG_LEVEL
+#define APP_LOG_LEVEL             APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef BLOCK_LOG_LEVEL
+#define BLOCK_LOG_LEVEL           APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef FASTPATH_LOG_LEVEL
+#define FASTPATH_LOG_LEVEL        APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef GATEWAYS_LOG_LEVEL
+#define GATEWAYS_LOG_LEVEL        APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef KEEPALIVE_LOG_LEVEL
+#define KEEPALIVE_LOG_LEVEL       APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef LOG_LOG_LEVEL
+#define LOG_LOG_LEVEL             APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef METRICS_LOG_LEVEL
+#define METRICS_LOG_LEVEL         APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef PIPELINE_LOG_LEVEL
+#define PIPELINE_LOG_LEVEL        APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef POLL_LOG_LEVEL
+#define POLL_LOG_LEVEL            APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef SAMPLER_LOG_LEVEL
+#define SAMPLER_LOG_LEVEL         APP_LOG_DEFAULT_LEVEL
+#endif
+#ifndef SESSION_LOG_LEVEL
+#define SESSION_LOG_LEVEL         APP_LOG_DEFAULT_LEVEL
+#endif
+
+#if defined(NRF_LOG_MODULE_NAME) && !defined(NRF_LOG_LEVEL)
+#define NRF_LOG_LEVEL             CONCAT_2(NRF_LOG_MODULE_NAME, _LOG_LEVEL)
+#endif
+
+/**@brief Whether entries of a level are enabled in the current module, as decided by the SDK for its own macros. */
+#define APP_LOG_LEVEL_ENABLED(level) (((level) <= NRF_LOG_LEVEL) && ((level) <= NRF_LOG_DEFAULT_LEVEL))
+
+#include "nrf_log.h"
+
+#ifndef APP_LOG_BINARY
+#define APP_LOG_BINARY            0                                    /**< Write log entries in binary form. */
+#endif
+
+#ifndef APP_LOG_RTT_CHANNEL
+#define APP_LOG_RTT_CHANNEL       1                                    /**< RTT up channel of the binary log or of the lines of @ref app_log_string, below SEGGER_RTT_CONFIG_MAX_NUM_UP_BUFFERS. */
+#endif
+
+#ifndef APP_LOG_RTT_BUFFER_SIZE
+#define APP_LOG_RTT_BUFFER_SIZE   1024                                 /**< Size of the RTT buffer of @ref APP_LOG_RTT_CHANNEL. */
+#endif
+
+#ifndef APP_LOG_STALL_MS
+#define APP_LOG_STALL_MS          10                                   /**< Delay of the logger while the RTT buffer is full in [ms]. */
+#endif
+
+#ifndef APP_LOG_STALL_RETRIES
+#define APP_LOG_STALL_RETRIES     10                                   /**< Delays before an entry is passed to a full RTT buffer, which drops it. */
+#endif
+
+#ifndef APP_LOG_DRAIN_INTERVAL_MS
+#define APP_LOG_DRAIN_INTERVAL_MS 1000                                 /**< Longest time the logger waits before draining entries the idle hook did not report, in [ms]. */
+#endif
+
+#ifndef APP_LOG_LIMIT_BURST
+#define APP_LOG_LIMIT_BURST       5                                    /**< Entries logged per window by a rate-limited call site. */
+#endif
+
+#ifndef APP_LOG_LIMIT_WINDOW_MS
+#define APP_LOG_LIMIT_WINDOW_MS   1000                                 /**< Window of a rate-limited call site in [ms], below 256 s. */
+#endif
+
+#define APP_LOG_HEADER_WORDS      2                                    /**< Words of an entry header in the NRF_LOG buffer. */
+#define APP_LOG_ARGS_MAX          6                                    /**< Maximum number of arguments of a log entry. */
+#define APP_LOG_ID_STRING         0xFFFF                               /**< Record of a string; the argument count is its length. */
+#define APP_LOG_ID_DROPPED        0xFFFE                               /**< Record of the number of records dropped. */
+
+/**@brief Log statistics. */
+typedef struct
+{
+    uint32_t entries;                                                  /**< Entries written. */
+    uint32_t dropped;                                                  /**< Entries lost because the buffer was full. */
+    uint32_t high_water;                                               /**< Highest fill level of the NRF_LOG buffer in bytes. */
+    uint32_t stalls;                                                   /**< Delays of the logger while the RTT buffer was full. */
+    uint32_t suppressed;                                               /**< Entries suppressed by rate-limited call sites. */
+} app_log_stats_t;
+
+/**@brief State of a rate-limited call site. */
+typedef struct app_log_limit_s
+{
+    const char             * p_file;                                   /**< Source file of the call site, named in summaries. */
+    uint16_t                 line;                                     /**< Source line of the call site. */
+    uint32_t                 window_start;                             /**< Start of the window, see @ref app_clock_stamp. */
+    uint16_t                 count;                                    /**< Entries seen in the window. */
+    uint16_t                 suppressed;                               /**< Entries suppressed since the last summary. */
+    bool                     started;                                  /**< Whether a window has been started, and the state registered. */
+    struct app_log_limit_s * p_next;                                   /**< Next registered call site. */
+} app_log_limit_t;
+
+/**@brief Sets up RTT channel @ref APP_LOG_RTT_CHANNEL, for the binary log or for the lines of @ref app_log_string. */
+void app_log_init(void);
+
+/**@brief Accounts for a deferred entry. Used by the log macros. May be called from any context.
+ *
+ * @param[in] nargs  Number of arguments.
+ */
+void app_log_deferred(uint8_t nargs);
+
+/**@brief Returns whether entries have been written since the last call. To be called from the idle hook. */
+bool app_log_pending_take(void);
+
+/**@brief Processes all deferred entries. To be called from the logger task when notified by the
+ *        idle hook, and at least every @ref APP_LOG_DRAIN_INTERVAL_MS.
+ *
+ * @details Also logs the entries suppressed by rate-limited call sites whose window has expired.
+ */
+void app_log_drain(void);
+
+/**@brief Returns log statistics. */
+const app_log_stats_t * app_log_stats_get(void);
+
+/**@brief Decides whether an entry of a rate-limited call site is logged. Used by the log macros.
+ *        May be called from any context. Registers the state on its first call.
+ *
+ * @param[inout] p_limit       State of the call site.
+ * @param[out]   p_suppressed  Entries suppressed in the previous window, to be logged first.
+ *
+ * @return True if the entry is to be logged.
+ */
+bool app_log_limit_pass(app_log_limit_t * p_limit, uint32_t * p_suppressed);
+
+/**@brief Writes a record. Used by the log macros. May be called from any context.
+ *
+ * @param[in] id      Address of the format string in the dictionary, of which the lower 16 bits are written.
+ * @param[in] nargs   Number of arguments.
+ * @param[in] p_args  Arguments.
+ */
+void app_log_write(uint32_t id, uint8_t nargs, const uint32_t * p_args);
+
+/**@brief Writes a line of text from RAM, truncated to 255 characters. May be called from any context.
+ *
+ * @details In binary mode the line is a string record. Otherwise it is written directly to RTT
+ *          channel @ref APP_LOG_RTT_CHANNEL, as the NRF_LOG string buffer only holds a single line
+ *          and the backend channel is written by the logger task without a lock.
+ */
+void app_log_string(const char * p_string);
+
+#if APP_LOG_BINARY
+
+#define APP_LOG_DICT_SECTION      ".log_dict,\"\",%progbits @"         /**< Non-allocated section; '@' comments out the flags GCC appends. */
+
+#define APP_LOG_FORMAT(...)       APP_LOG_FORMAT_(__VA_ARGS__, )
+#define APP_LOG_FORMAT_(fmt, ...) fmt
+
+#define APP_LOG_ARGS_0(fmt)                    app_log_write(app_log_id, 0, NULL)
+#define APP_LOG_ARGS_1(fmt, a1)                APP_LOG_ARGS((uint32_t)(a1))
+#define APP_LOG_ARGS_2(fmt, a1, a2)            APP_LOG_ARGS((uint32_t)(a1), (uint32_t)(a2))
+#define APP_LOG_ARGS_3(fmt, a1, a2, a3)        APP_LOG_ARGS((uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3))
+#define APP_LOG_ARGS_4(fmt, a1, a2, a3, a4)                                                             \
+    APP_LOG_ARGS((uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3), (uint32_t)(a4))
+#define APP_LOG_ARGS_5(fmt, a1, a2, a3, a4, a5)                                                         \
+    APP_LOG_ARGS((uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3), (uint32_t)(a4), (uint32_t)(a5))
+#define APP_LOG_ARGS_6(fmt, a1, a2, a3, a4, a5, a6)                                                     \
+    APP_LOG_ARGS((uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3), (uint32_t)(a4), (uint32_t)(a5),        \
+                 (uint32_t)(a6))
+
+#define APP_LOG_ARGS(...)                                                                               \
+    do                                                                                                  \
+    {                                                                                                   \
+        const uint32_t app_log_args[] = { __VA_ARGS__ };                                                \
+        app_log_write(app_log_id, ARRAY_SIZE(app_log_args), app_log_args);                              \
+    } while (0)
+
+/**@brief Stores the format string in the dictionary and writes a record if the level is enabled.
+ *
+ * @details Like the NRF_LOG macros, this expands to an if statement.
+ */
+#define APP_LOG_ENTRY(level, prefix, ...)                                                               \
+    if (APP_LOG_LEVEL_ENABLED(level))                                                                   \
+    {                                                                                                   \
+        static const char app_log_format[] __attribute__((section(APP_LOG_DICT_SECTION))) =             \
+            prefix ":" STRINGIFY(NRF_LOG_MODULE_NAME) ":" APP_LOG_FORMAT(__VA_ARGS__);                  \
+        const uint32_t app_log_id = (uint32_t)app_log_format;                                           \
+        CONCAT_2(APP_LOG_ARGS_, NUM_VA_ARGS_LESS_1(__VA_ARGS__))(__VA_ARGS__);                          \
+    }
+
+#undef NRF_LOG_ERROR
+#undef NRF_LOG_WARNING
+#undef NRF_LOG_INFO
+#undef NRF_LOG_DEBUG
+
+#define NRF_LOG_ERROR(...)        APP_LOG_ENTRY(NRF_LOG_SEVERITY_ERROR,   "E", __VA_ARGS__)
+#define NRF_LOG_WARNING(...)      APP_LOG_ENTRY(NRF_LOG_SEVERITY_WARNING, "W", __VA_ARGS__)
+#define NRF_LOG_INFO(...)         APP_LOG_ENTRY(NRF_LOG_SEVERITY_INFO,    "I", __VA_ARGS__)
+#define NRF_LOG_DEBUG(...)        APP_LOG_ENTRY(NRF_LOG_SEVERITY_DEBUG,   "D", __VA_ARGS__)
+
+#elif NRF_LOG_ENABLED && NRF_LOG_DEFERRED
+
+/**@brief Stores an entry in the NRF_LOG buffer and accounts for it if the level is enabled. */
+#define APP_LOG_DEFERRED(level, entry, ...)                                                             \
+    if (APP_LOG_LEVEL_ENABLED(level))                                                                   \
+    {                                                                                                   \
+        entry(__VA_ARGS__);                                                                             \
+        app_log_deferred(NUM_VA_ARGS_LESS_1(__VA_ARGS__));                                              \
+    }
+
+#undef NRF_LOG_ERROR
+#undef NRF_LOG_WARNING
+#undef NRF_LOG_INFO
+#undef NRF_LOG_DEBUG
+
+#define NRF_LOG_ERROR(...)        APP_LOG_DEFERRED(NRF_LOG_SEVERITY_ERROR,   NRF_LOG_INTERNAL_ERROR,   __VA_ARGS__)
+#define NRF_LOG_WARNING(...)      APP_LOG_DEFERRED(NRF_LOG_SEVERITY_WARNING, NRF_LOG_INTERNAL_WARNING, __VA_ARGS__)
+#define NRF_LOG_INFO(...)         APP_LOG_DEFERRED(NRF_LOG_SEVERITY_INFO,    NRF_LOG_INTERNAL_INFO,    __VA_ARGS__)
+#define NRF_LOG_DEBUG(...)        APP_LOG_DEFERRED(NRF_LOG_SEVERITY_DEBUG,   NRF_LOG_INTERNAL_DEBUG,   __VA_ARGS__)
+
+#endif // APP_LOG_BINARY
+
+#if APP_LOG_BINARY || NRF_LOG_ENABLED
+
+/**@brief Logs an entry unless its call site exceeded @ref APP_LOG_LIMIT_BURST entries in the
+ *        current window, preceded by the number of entries suppressed in the previous one.
+ *
+ * @details Like the NRF_LOG macros, this expands to an if statement.
+ */
+#define APP_LOG_LIMITED(level, entry, ...)                                                              \
+    if (APP_LOG_LEVEL_ENABLED(level))                                                                   \
+    {                                                                                                   \
+        static app_log_limit_t app_log_limit = {.p_file = __FILE__, .line = __LINE__};                  \
+        uint32_t               app_log_suppressed;                                                      \
+        if (app_log_limit_pass(&app_log_limit, &app_log_suppressed))                                    \
+        {                                                                                               \
+            if (app_log_suppressed > 0)                                                                 \
+            {                                                                                           \
+                entry("%d similar entries suppressed.\r\n", app_log_suppressed);                        \
+            }                                                                                           \
+            entry(__VA_ARGS__);                                                                         \
+        }                                                                                               \
+    }
+
+/**@brief Writes a line of text from RAM with @ref app_log_string, rate-limited like
+ *        @ref APP_LOG_LIMITED. The number of suppressed lines is logged with @p entry.
+ */
+#define APP_LOG_STRING_LIMITED(level, entry, p_string)                                                  \
+    if (APP_LOG_LEVEL_ENABLED(level))                                                                   \
+    {                                                                                                   \
+        static app_log_limit_t app_log_limit = {.p_file = __FILE__, .line = __LINE__};                  \
+        uint32_t               app_log_suppressed;                                                      \
+        if (app_log_limit_pass(&app_log_limit, &app_log_suppressed))                                    \
+        {                                                                                               \
+            if (app_log_suppressed > 0)                                                                 \
+            {                                                                                           \
+                entry("%d similar entries suppressed.\r\n", app_log_suppressed);                        \
+            }                                                                                           \
+            app_log_string(p_string);                                                                   \
+        }                                                                                               \
+    }
+
+#else
+
+#define APP_LOG_LIMITED(level, entry, ...)
+#define APP_LOG_STRING_LIMITED(level, entry, p_string)
+
+#endif // APP_LOG_BINARY || NRF_LOG_ENABLED
+
+#define APP_LOG_ERROR_LIMITED(...)   APP_LOG_LIMITED(NRF_LOG_SEVERITY_ERROR,   NRF_LOG_ERROR,   __VA_ARGS__)
+#define APP_LOG_WARNING_LIMITED(...) APP_LOG_LIMITED(NRF_LOG_SEVERITY_WARNING, NRF_LOG_WARNING, __VA_ARGS__)
+#define APP_LOG_INFO_LIMITED(...)    APP_LOG_LIMITED(NRF_LOG_SEVERITY_INFO,    NRF_LOG_INFO,    __VA_ARGS__)
+#define APP_LOG_DEBUG_LIMITED(...)   APP_LOG_LIMITED(NRF_LOG_SEVERITY_DEBUG,   NRF_LOG_DEBUG,   __VA_ARGS__)
+
+#define APP_LOG_INFO_STRING_LIMITED(p_string) APP_LOG_STRING_LIMITED(NRF_LOG_SEVERITY_INFO, NRF_LOG_INFO, p_string)
+
+#endif // APP_LOG_H__
+
+/** @} */
@@ -0,0 +1,507 @@
+/** @file
+ *
+ * @brief Collects statistics of the application modules and exports them.
+ */
+
+#include "app_metrics.h"
+
+#include <stdio.h>
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "block_transfer.h"
+#include "input_limiter.h"
+#include "input_probe.h"
+#include "latency_trace.h"
+#include "mqttsn_fastpath.h"
+#include "mqttsn_gateways.h"
+#include "mqttsn_keepalive.h"
+#include "mqttsn_rtt.h"
+#include "mqttsn_session.h"
+#include "poll_control.h"
+#include "publish_aggregator.h"
+#include "publish_filter.h"
+#include "publish_pipeline.h"
+#include "sampler.h"
+
+#include <openthread/cli.h>
+
+#define NRF_LOG_MODULE_NAME METRICS
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#if APP_METRICS_LOG_INTERVAL_MS
+static uint32_t m_next_log;                                            /**< Time of the next periodic log dump. */
+#endif
+
+static void metrics_cli_command(int argc, char * argv[]);
+
+static const otCliCommand m_cli_commands[] =
+{
+    {"metrics", metrics_cli_command},
+};
+
+
+static void session_print(app_metrics_output_t output)
+{
+    char                           line[APP_METRICS_LINE_SIZE];
+    const mqttsn_session_stats_t * p_stats = mqttsn_session_stats_get();
+
+    snprintf(line, sizeof(line), "session: state=%s attempts=%lu/%lu failovers=%lu backoff_ms=%lu",
+             mqttsn_session_state_name(mqttsn_session_state_get()),
+             (unsigned long)p_stats->attempts,
+             (unsigned long)p_stats->attempts_total,
+             (unsigned long)p_stats->failovers,
+             (unsigned long)p_stats->backoff_ms);
+    output(line);
+
+    snprintf(line, sizeof(line), "session: losses=%lu recoveries=%lu recovery_ms last=%lu max=%lu avg=%lu",
+             (unsigned long)p_stats->losses,
+             (unsigned long)p_stats->recoveries,
+             (unsigned long)p_stats->last_recovery_ms,
+             (unsigned long)p_stats->max_recovery_ms,
+             (unsigned long)(p_stats->recoveries ? p_stats->total_recovery_ms / p_stats->recoveries : 0));
+    output(line);
+
+    const mqttsn_keepalive_stats_t * p_keepalive = mqttsn_keepalive_stats_get();
+
+    snprintf(line, sizeof(line), "keepalive: duration_s=%u down=%lu up=%lu probes=%lu suppressed=%lu",
+             p_keepalive->duration_s,
+             (unsigned long)p_keepalive->step_downs,
+             (unsigned long)p_keepalive->step_ups,
+             (unsigned long)p_keepalive->probes,
+             (unsigned long)p_keepalive->suppressed);
+    output(line);
+
+    snprintf(line, sizeof(line), "session: sleeps=%lu wakeups=%lu asleep_ms=%lu",
+             (unsigned long)p_stats->sleeps,
+             (unsigned long)p_stats->wakeups,
+             (unsigned long)p_stats->asleep_ms);
+    output(line);
+}
+
+
+static void rtt_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t i = 0; i < MQTTSN_RTT_GATEWAY_COUNT; i++)
+    {
+        const mqttsn_rtt_stats_t * p_stats = mqttsn_rtt_stats_get(i);
+
+        if (p_stats == NULL)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "rtt gw %u: srtt=%lu rttvar=%lu rto=%lu min=%lu max=%lu",
+                 p_stats->gateway_id,
+                 (unsigned long)p_stats->srtt_ms,
+                 (unsigned long)p_stats->rttvar_ms,
+                 (unsigned long)p_stats->rto_ms,
+                 (unsigned long)p_stats->min_rtt_ms,
+                 (unsigned long)p_stats->max_rtt_ms);
+        output(line);
+
+        snprintf(line, sizeof(line), "rtt gw %u: samples=%lu ambiguous=%lu timeouts=%lu",
+                 p_stats->gateway_id,
+                 (unsigned long)p_stats->samples,
+                 (unsigned long)p_stats->ambiguous,
+                 (unsigned long)p_stats->timeouts);
+        output(line);
+    }
+}
+
+
+static void gateways_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t i = 0; i < MQTTSN_GATEWAYS_COUNT; i++)
+    {
+        const mqttsn_gateways_entry_t * p_entry = mqttsn_gateways_entry_get(i);
+
+        if (p_entry == NULL)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "gateway %u: hops=%u failures=%u cost_ms=%lu",
+                 p_entry->gateway_id,
+                 p_entry->hops,
+                 p_entry->failures,
+                 (unsigned long)p_entry->cost_ms);
+        output(line);
+    }
+}
+
+
+static void pipeline_print(app_metrics_output_t output)
+{
+    char                             line[APP_METRICS_LINE_SIZE];
+    const publish_pipeline_stats_t * p_stats = publish_pipeline_stats_get();
+
+    snprintf(line, sizeof(line), "pipeline: queued=%lu sent=%lu dropped=%lu errors=%lu depth=%u/%u burst=%lu",
+             (unsigned long)p_stats->queued,
+             (unsigned long)p_stats->sent,
+             (unsigned long)p_stats->dropped,
+             (unsigned long)p_stats->send_errors,
+             p_stats->depth,
+             p_stats->max_depth,
+             (unsigned long)p_stats->max_burst);
+    output(line);
+
+    snprintf(line, sizeof(line), "pipeline: spilled=%lu spill_errors=%lu fragmented=%lu payload_max=%u",
+             (unsigned long)p_stats->spilled,
+             (unsigned long)p_stats->spill_errors,
+             (unsigned long)p_stats->fragmented,
+             publish_pipeline_payload_max());
+    output(line);
+
+#if PUBLISH_PIPELINE_FLASH_SPILL
+    const flash_log_stats_t * p_flash = flash_log_stats_get();
+
+    snprintf(line, sizeof(line), "flash log: count=%lu recovered=%lu appended=%lu consumed=%lu dropped=%lu erases=%lu",
+             (unsigned long)p_flash->count,
+             (unsigned long)p_flash->recovered,
+             (unsigned long)p_flash->appended,
+             (unsigned long)p_flash->consumed,
+             (unsigned long)p_flash->dropped,
+             (unsigned long)p_flash->erases);
+    output(line);
+#endif
+
+    snprintf(line, sizeof(line), "pipeline: compressed=%lu bytes_in=%lu bytes_out=%lu",
+             (unsigned long)p_stats->compressed,
+             (unsigned long)p_stats->compressed_in,
+             (unsigned long)p_stats->compressed_out);
+    output(line);
+
+    snprintf(line, sizeof(line), "pipeline: attached=%u detaches=%lu detached_ms=%lu",
+             publish_pipeline_is_attached(),
+             (unsigned long)p_stats->detaches,
+             (unsigned long)p_stats->detached_ms);
+    output(line);
+}
+
+
+static void latency_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t stage = 0; stage < LATENCY_TRACE_STAGE_COUNT; stage++)
+    {
+        const latency_trace_histogram_t * p_histogram = latency_trace_histogram_get(stage);
+
+        snprintf(line, sizeof(line), "latency %s: count=%lu avg_us=%lu max_us=%lu",
+                 latency_trace_stage_name(stage),
+                 (unsigned long)p_histogram->count,
+                 (unsigned long)(p_histogram->count ? p_histogram->total_us / p_histogram->count : 0),
+                 (unsigned long)p_histogram->max_us);
+        output(line);
+
+        if (p_histogram->count == 0)
+        {
+            continue;
+        }
+
+        // Buckets are printed in two lines so that large counts still fit.
+        for (uint8_t first = 0; first < LATENCY_TRACE_BUCKETS; first += LATENCY_TRACE_BUCKETS / 2)
+        {
+            int len = snprintf(line, sizeof(line), "latency %s: le_us=%lu..%lu",
+                               latency_trace_stage_name(stage),
+                               (unsigned long)LATENCY_TRACE_BUCKET_MIN_US << first,
+                               (unsigned long)LATENCY_TRACE_BUCKET_MIN_US << (first + LATENCY_TRACE_BUCKETS / 2 - 1));
+
+            for (uint8_t i = first; (i < first + LATENCY_TRACE_BUCKETS / 2) && (len < (int)sizeof(line)); i++)
+            {
+                len += snprintf(&line[len], sizeof(line) - len, " %lu", (unsigned long)p_histogram->buckets[i]);
+            }
+
+            output(line);
+        }
+    }
+}
+
+
+static void sampler_print(app_metrics_output_t output)
+{
+    char                    line[APP_METRICS_LINE_SIZE];
+    const sampler_stats_t * p_stats = sampler_stats_get();
+
+    if (p_stats == NULL)
+    {
+        return;
+    }
+
+    snprintf(line, sizeof(line), "sampler: samples=%lu blocks=%lu dropped_blocks=%lu put_errors=%lu",
+             (unsigned long)p_stats->samples,
+             (unsigned long)p_stats->blocks,
+             (unsigned long)p_stats->dropped_blocks,
+             (unsigned long)p_stats->put_errors);
+    output(line);
+
+    snprintf(line, sizeof(line), "sampler jitter_us: avg=%lu max=%lu",
+             (unsigned long)((p_stats->samples > 1) ? p_stats->jitter_total_us / (p_stats->samples - 1) : 0),
+             (unsigned long)p_stats->jitter_max_us);
+    output(line);
+}
+
+
+static void aggregator_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t i = 0; i < PUBLISH_AGGREGATOR_COUNT; i++)
+    {
+        const publish_aggregator_t * p_aggregator = publish_aggregator_get(i);
+
+        if (p_aggregator == NULL)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "aggregator topic %u: window=%u samples=%lu records=%lu put_errors=%lu",
+                 p_aggregator->p_topic->topic.topic_id,
+                 p_aggregator->window,
+                 (unsigned long)p_aggregator->samples,
+                 (unsigned long)p_aggregator->records,
+                 (unsigned long)p_aggregator->put_errors);
+        output(line);
+    }
+}
+
+
+static void log_print(app_metrics_output_t output)
+{
+    char                    line[APP_METRICS_LINE_SIZE];
+    const app_log_stats_t * p_stats = app_log_stats_get();
+
+    snprintf(line, sizeof(line), "log: entries=%lu dropped=%lu high_water=%lu/%u stalls=%lu suppressed=%lu",
+             (unsigned long)p_stats->entries,
+             (unsigned long)p_stats->dropped,
+             (unsigned long)p_stats->high_water,
+             NRF_LOG_BUFSIZE,
+             (unsigned long)p_stats->stalls,
+             (unsigned long)p_stats->suppressed);
+    output(line);
+}
+
+
+static void input_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t i = 0; i < INPUT_LIMITER_SOURCE_COUNT; i++)
+    {
+        const input_limiter_source_t * p_source = input_limiter_source_get(i);
+
+        if (p_source == NULL)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "input pin %lu: accepted=%lu bounced=%lu rate_limited=%lu glitches=%lu",
+                 (unsigned long)p_source->pin,
+                 (unsigned long)p_source->accepted,
+                 (unsigned long)p_source->bounced,
+                 (unsigned long)p_source->rate_limited,
+                 (unsigned long)p_source->glitches);
+        output(line);
+    }
+
+    const input_probe_stats_t * p_probe = input_probe_stats_get();
+
+    if (p_probe != NULL)
+    {
+        snprintf(line, sizeof(line), "input latency_us: samples=%lu last=%lu min=%lu max=%lu avg=%lu",
+                 (unsigned long)p_probe->samples,
+                 (unsigned long)p_probe->last_us,
+                 (unsigned long)(p_probe->samples ? p_probe->min_us : 0),
+                 (unsigned long)p_probe->max_us,
+                 (unsigned long)(p_probe->samples ? p_probe->total_us / p_probe->samples : 0));
+        output(line);
+    }
+}
+
+
+static void filter_print(app_metrics_output_t output)
+{
+    char line[APP_METRICS_LINE_SIZE];
+
+    for (uint8_t i = 0; i < PUBLISH_FILTER_COUNT; i++)
+    {
+        const publish_filter_t * p_filter = publish_filter_get(i);
+
+        if (p_filter == NULL)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "filter topic %u: passed=%lu suppressed=%lu heartbeats=%lu",
+                 p_filter->p_topic->topic.topic_id,
+                 (unsigned long)p_filter->passed,
+                 (unsigned long)p_filter->suppressed,
+                 (unsigned long)p_filter->heartbeats);
+        output(line);
+    }
+}
+
+
+static void fastpath_print(app_metrics_output_t output)
+{
+    char                            line[APP_METRICS_LINE_SIZE];
+    const mqttsn_fastpath_stats_t * p_stats = mqttsn_fastpath_stats_get();
+
+    snprintf(line, sizeof(line), "fastpath: posted=%lu superseded=%lu overflows=%lu sent=%lu bytes=%lu",
+             (unsigned long)p_stats->posted,
+             (unsigned long)p_stats->superseded,
+             (unsigned long)p_stats->overflows,
+             (unsigned long)p_stats->sent,
+             (unsigned long)p_stats->sent_bytes);
+    output(line);
+
+    snprintf(line, sizeof(line), "fastpath: rate_limited=%lu no_route=%lu errors=%lu fragmented=%lu",
+             (unsigned long)p_stats->rate_limited,
+             (unsigned long)p_stats->no_route,
+             (unsigned long)p_stats->errors,
+             (unsigned long)p_stats->fragmented);
+    output(line);
+
+    snprintf(line, sizeof(line), "fastpath: local_sent=%lu local_received=%lu local_dropped=%lu",
+             (unsigned long)p_stats->local_sent,
+             (unsigned long)p_stats->local_received,
+             (unsigned long)p_stats->local_dropped);
+    output(line);
+}
+
+
+static void block_print(app_metrics_output_t output)
+{
+    char                           line[APP_METRICS_LINE_SIZE];
+    const block_transfer_stats_t * p_stats = block_transfer_stats_get();
+
+    snprintf(line, sizeof(line), "block tx: transfers=%lu failures=%lu chunks=%lu resent=%lu",
+             (unsigned long)p_stats->tx_transfers,
+             (unsigned long)p_stats->tx_failures,
+             (unsigned long)p_stats->tx_chunks,
+             (unsigned long)p_stats->tx_resent);
+    output(line);
+
+    snprintf(line, sizeof(line), "block tx: bytes_in=%lu bytes_out=%lu",
+             (unsigned long)p_stats->tx_bytes_in,
+             (unsigned long)p_stats->tx_bytes_out);
+    output(line);
+
+    snprintf(line, sizeof(line), "block rx: transfers=%lu chunks=%lu nacks=%lu",
+             (unsigned long)p_stats->rx_transfers,
+             (unsigned long)p_stats->rx_chunks,
+             (unsigned long)p_stats->rx_nacks);
+    output(line);
+}
+
+
+static void poll_print(app_metrics_output_t output)
+{
+    char                         line[APP_METRICS_LINE_SIZE];
+    const poll_control_stats_t * p_stats = poll_control_stats_get();
+
+    if (p_stats == NULL)
+    {
+        return;
+    }
+
+    // Radio duty cycle in hundredths of a percent.
+    uint32_t duty = p_stats->uptime_ms ? (uint32_t)(((uint64_t)p_stats->radio_on_ms * 10000) / p_stats->uptime_ms) : 0;
+
+    snprintf(line, sizeof(line), "poll: period_ms=%lu speedups=%lu fast_ms=%lu polls=%lu tx=%lu rx=%lu",
+             (unsigned long)p_stats->period_ms,
+             (unsigned long)p_stats->speedups,
+             (unsigned long)p_stats->fast_ms,
+             (unsigned long)p_stats->polls,
+             (unsigned long)p_stats->tx_frames,
+             (unsigned long)p_stats->rx_frames);
+    output(line);
+
+    snprintf(line, sizeof(line), "poll: radio_on_ms=%lu uptime_ms=%lu duty=%lu.%02lu%%",
+             (unsigned long)p_stats->radio_on_ms,
+             (unsigned long)p_stats->uptime_ms,
+             (unsigned long)(duty / 100),
+             (unsigned long)(duty % 100));
+    output(line);
+}
+
+
+static void cli_output(const char * p_line)
+{
+    otCliUartOutputFormat("%s\r\n", p_line);
+}
+
+
+static void log_output(const char * p_line)
+{
+    // Not deferred, so that a dump neither overflows the log buffers nor waits for the logger.
+    app_log_string(p_line);
+}
+
+
+static void metrics_cli_command(int argc, char * argv[])
+{
+    UNUSED_PARAMETER(argc);
+    UNUSED_PARAMETER(argv);
+
+    app_metrics_print(cli_output);
+    otCliUartAppendResult(OT_ERROR_NONE);
+}
+
+
+void app_metrics_init(void)
+{
+    otCliUartSetUserCommands(m_cli_commands, ARRAY_SIZE(m_cli_commands));
+
+#if APP_METRICS_LOG_INTERVAL_MS
+    m_next_log = app_clock_ms() + APP_METRICS_LOG_INTERVAL_MS;
+#endif
+}
+
+
+void app_metrics_print(app_metrics_output_t output)
+{
+    session_print(output);
+    rtt_print(output);
+    gateways_print(output);
+    pipeline_print(output);
+    latency_print(output);
+    sampler_print(output);
+    aggregator_print(output);
+    input_print(output);
+    filter_print(output);
+    fastpath_print(output);
+    block_print(output);
+    poll_print(output);
+    log_print(output);
+}
+
+
+void app_metrics_log(void)
+{
+    app_metrics_print(log_output);
+}
+
+
+uint32_t app_metrics_process(void)
+{
+#if APP_METRICS_LOG_INTERVAL_MS
+    uint32_t now = app_clock_ms();
+
+    if (app_clock_expired(now, m_next_log))
+    {
+        app_metrics_log();
+        m_next_log = now + APP_METRICS_LOG_INTERVAL_MS;
+    }
+
+    return app_clock_remaining(now, m_next_log);
+#else
+    return APP_CLOCK_NO_DEADLINE;
+#endif
+}
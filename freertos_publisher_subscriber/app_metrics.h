@@ -0,0 +1,44 @@
+/** @file
+ *
+ * @defgroup app_metrics Application metrics
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Collects statistics of the application modules and exports them.
+ *
+ * @details Metrics can be read with the "metrics" command of the Thread CLI, and are optionally
+ *          written to the log every @ref APP_METRICS_LOG_INTERVAL_MS.
+ */
+
+#ifndef APP_METRICS_H__
+#define APP_METRICS_H__
+
+#include <stdint.h>
+
+#ifndef APP_METRICS_LOG_INTERVAL_MS
+#define APP_METRICS_LOG_INTERVAL_MS    0                               /**< Period of metrics log dumps in [ms]. 0 disables periodic dumps. */
+#endif
+
+#define APP_METRICS_LINE_SIZE          128                             /**< Maximum length of a single metrics line. */
+
+/**@brief Metrics output function, called once for every line of the report. */
+typedef void (*app_metrics_output_t)(const char * p_line);
+
+/**@brief Registers the metrics CLI command. Shall be called after the Thread CLI has been initialized. */
+void app_metrics_init(void);
+
+/**@brief Renders all metrics line by line to the given output. */
+void app_metrics_print(app_metrics_output_t output);
+
+/**@brief Writes all metrics to the log. */
+void app_metrics_log(void);
+
+/**@brief Runs the periodic metrics log dump.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t app_metrics_process(void);
+
+#endif // APP_METRICS_H__
+
+/** @} */
@@ -0,0 +1,671 @@
+/** @file
+ *
+ * @brief Transfer of buffers larger than a single PUBLISH over MQTT-SN.
+ */
+
+#include "block_transfer.h"
+
+#include <string.h>
+
+#include <openthread/platform/random.h>
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "mqttsn_rtt.h"
+#include "mqttsn_session.h"
+#include "payload_codec.h"
+#include "publish_pipeline.h"
+
+#define NRF_LOG_MODULE_NAME BLOCK
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define MAGIC               0xB7                                       /**< First byte of every block transfer message. */
+#define DATA_HEADER_SIZE    8                                          /**< Size of the chunk header. */
+#define NACK_HEADER_SIZE    5                                          /**< Size of the NACK header. */
+#define DONE_SIZE           3                                          /**< Size of the DONE message. */
+#define BITMAP_SIZE         ((BLOCK_TRANSFER_CHUNKS_MAX + 7) / 8)      /**< Size of a chunk bitmap. */
+#define RETRY_MS            100                                        /**< Delay before retrying a rejected publish in [ms]. */
+#define NO_CHUNK            UINT16_MAX                                 /**< No chunk is waiting to be sent. */
+#define DONE_HOLD_MS        ((BLOCK_TRANSFER_TX_RETRIES + 1) * BLOCK_TRANSFER_TX_TIMEOUT_MS)  /**< Time a complete transfer is confirmed again, the longest a sender retries. */
+
+/**@brief Block transfer message types. */
+typedef enum
+{
+    MSG_DATA = 1,                                                      /**< Chunk of data. */
+    MSG_NACK = 2,                                                      /**< Request of missing chunks. */
+    MSG_DONE = 3,                                                      /**< Confirmation of a complete transfer. */
+} msg_type_t;
+
+/**@brief Sender state. */
+typedef struct
+{
+    bool                     active;                                   /**< Whether a transfer is in progress. */
+    const uint8_t          * p_data;                                   /**< Data to send, encoded if compression is enabled. */
+    uint32_t                 len;                                      /**< Length of the data to send. */
+    uint32_t                 data_len;                                 /**< Length of the data of the application. */
+    block_transfer_handler_t handler;                                  /**< Completion handler. */
+    uint8_t                  id;                                       /**< Transfer ID. */
+    uint8_t                  chunk_size;                               /**< Size of all but the last chunk. */
+    uint16_t                 count;                                    /**< Number of chunks. */
+    uint16_t                 next;                                     /**< Next chunk sent for the first time. */
+    uint8_t                  resend[BITMAP_SIZE];                      /**< Chunks to be sent again. */
+    uint16_t                 inflight_seq[BLOCK_TRANSFER_WINDOW];      /**< Chunks waiting for PUBACK, or @ref NO_CHUNK. */
+    uint16_t                 inflight_msg_id[BLOCK_TRANSFER_WINDOW];   /**< Message IDs of the chunks waiting for PUBACK. */
+    uint8_t                  retries;                                  /**< Timeouts without a response of the receiver. */
+    uint32_t                 deadline;                                 /**< Response supervision deadline. */
+} tx_state_t;
+
+/**@brief Receiver state. */
+typedef struct
+{
+    uint8_t                * p_buffer;                                 /**< Buffer for the chunks of the next transfer, NULL if none. */
+    uint32_t                 size;                                     /**< Buffer size. */
+    uint8_t                * p_data;                                   /**< Buffer of the application. */
+    uint32_t                 data_size;                                /**< Size of the buffer of the application. */
+    block_transfer_handler_t handler;                                  /**< Completion handler. */
+    bool                     started;                                  /**< Whether a transfer is being received. */
+    bool                     done;                                     /**< Whether the last transfer with @ref id is complete. */
+    uint32_t                 done_at;                                  /**< Time at which the last transfer completed. */
+    uint8_t                  id;                                       /**< Transfer ID. */
+    uint8_t                  chunk_size;                               /**< Size of all but the last chunk. */
+    uint16_t                 count;                                    /**< Number of chunks. */
+    uint16_t                 received;                                 /**< Number of distinct chunks received. */
+    uint8_t                  bitmap[BITMAP_SIZE];                      /**< Received chunks. */
+    uint32_t                 len;                                      /**< Transfer length, known once the last chunk has arrived. */
+    uint8_t                  nacks;                                    /**< NACKs sent without any progress. */
+    uint32_t                 deadline;                                 /**< Time of the next NACK. */
+} rx_state_t;
+
+static mqttsn_client_t       * mp_client;                              /**< MQTT-SN client. */
+static const mqttsn_topics_entry_t * mp_topic;                        /**< Topic of block transfer messages, NULL if disabled. */
+static const mqttsn_topics_entry_t * mp_rx_topic;                     /**< Topic of the messages of the peer. */
+static tx_state_t              m_tx;                                   /**< Sender state. */
+static rx_state_t              m_rx;                                   /**< Receiver state. */
+static uint8_t                 m_next_id;                              /**< ID of the next transfer. */
+static block_transfer_stats_t  m_stats;                                /**< Block transfer statistics. */
+
+#if BLOCK_TRANSFER_COMPRESS
+static uint8_t                 m_tx_encoded[PAYLOAD_CODEC_BOUND(BLOCK_TRANSFER_COMPRESS_MAX)]; /**< Encoded data of the sender. */
+static uint8_t                 m_rx_encoded[PAYLOAD_CODEC_BOUND(BLOCK_TRANSFER_COMPRESS_MAX)]; /**< Encoded data of the receiver. */
+#endif
+
+
+static bool bit_get(const uint8_t * p_bitmap, uint16_t index)
+{
+    return (p_bitmap[index / 8] & (1 << (index % 8))) != 0;
+}
+
+
+static void bit_set(uint8_t * p_bitmap, uint16_t index)
+{
+    p_bitmap[index / 8] |= (1 << (index % 8));
+}
+
+
+static void bit_clear(uint8_t * p_bitmap, uint16_t index)
+{
+    p_bitmap[index / 8] &= ~(1 << (index % 8));
+}
+
+
+static uint32_t message_publish(const uint8_t * p_message, uint16_t len, uint16_t * p_msg_id)
+{
+    uint32_t err_code = mqttsn_client_publish(mp_client, mp_topic->topic.topic_id, p_message, len, p_msg_id);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        mqttsn_rtt_request_sent(MQTTSN_RTT_REQUEST_PUBLISH, *p_msg_id);
+    }
+
+    return err_code;
+}
+
+
+/**@brief Finishes the transfer of the sender. */
+static void tx_finish(uint32_t err_code)
+{
+    m_tx.active = false;
+
+    if (err_code == NRF_SUCCESS)
+    {
+        m_stats.tx_transfers++;
+    }
+    else
+    {
+        m_stats.tx_failures++;
+    }
+
+    NRF_LOG_INFO("Transfer %d finished. Error: 0x%x\r\n", m_tx.id, err_code);
+
+    if (m_tx.handler != NULL)
+    {
+        m_tx.handler(err_code, m_tx.data_len);
+    }
+}
+
+
+/**@brief Returns the chunk to be sent next, or @ref NO_CHUNK. Chunks requested again go first. */
+static uint16_t tx_chunk_next(void)
+{
+    for (uint16_t seq = 0; seq < m_tx.next; seq++)
+    {
+        if (bit_get(m_tx.resend, seq))
+        {
+            return seq;
+        }
+    }
+
+    return (m_tx.next < m_tx.count) ? m_tx.next : NO_CHUNK;
+}
+
+
+static int8_t tx_inflight_find(uint16_t msg_id)
+{
+    for (uint8_t i = 0; i < BLOCK_TRANSFER_WINDOW; i++)
+    {
+        if ((m_tx.inflight_seq[i] != NO_CHUNK) && (m_tx.inflight_msg_id[i] == msg_id))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+static uint32_t tx_chunk_send(uint16_t seq, uint8_t slot)
+{
+    uint8_t  message[DATA_HEADER_SIZE + BLOCK_TRANSFER_CHUNK_MAX];
+    uint32_t offset = (uint32_t)seq * m_tx.chunk_size;
+    uint16_t len    = MIN(m_tx.chunk_size, m_tx.len - offset);
+    uint16_t msg_id;
+
+    message[0] = MAGIC;
+    message[1] = MSG_DATA;
+    message[2] = m_tx.id;
+    message[3] = m_tx.chunk_size;
+    UNUSED_RETURN_VALUE(uint16_encode(seq, &message[4]));
+    UNUSED_RETURN_VALUE(uint16_encode(m_tx.count, &message[6]));
+    memcpy(&message[DATA_HEADER_SIZE], &m_tx.p_data[offset], len);
+
+    uint32_t err_code = message_publish(message, DATA_HEADER_SIZE + len, &msg_id);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (seq < m_tx.next)
+    {
+        bit_clear(m_tx.resend, seq);
+        m_stats.tx_resent++;
+    }
+    else
+    {
+        m_tx.next++;
+    }
+
+    m_tx.inflight_seq[slot]    = seq;
+    m_tx.inflight_msg_id[slot] = msg_id;
+    m_tx.deadline              = app_clock_ms() + BLOCK_TRANSFER_TX_TIMEOUT_MS;
+    m_stats.tx_chunks++;
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t tx_process(void)
+{
+    if (!m_tx.active || !mqttsn_session_is_ready())
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    for (uint8_t slot = 0; slot < BLOCK_TRANSFER_WINDOW; slot++)
+    {
+        uint16_t seq = tx_chunk_next();
+
+        if (seq == NO_CHUNK)
+        {
+            break;
+        }
+
+        if (m_tx.inflight_seq[slot] != NO_CHUNK)
+        {
+            continue;
+        }
+
+        if (tx_chunk_send(seq, slot) != NRF_SUCCESS)
+        {
+            return RETRY_MS;
+        }
+    }
+
+    uint32_t now = app_clock_ms();
+
+    if (!app_clock_expired(now, m_tx.deadline))
+    {
+        return app_clock_remaining(now, m_tx.deadline);
+    }
+
+    if (++m_tx.retries > BLOCK_TRANSFER_TX_RETRIES)
+    {
+        tx_finish(NRF_ERROR_TIMEOUT);
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    // Send unacknowledged chunks again, or the last chunk to make the receiver respond.
+    bool pending = false;
+
+    for (uint8_t slot = 0; slot < BLOCK_TRANSFER_WINDOW; slot++)
+    {
+        if (m_tx.inflight_seq[slot] != NO_CHUNK)
+        {
+            bit_set(m_tx.resend, m_tx.inflight_seq[slot]);
+            m_tx.inflight_seq[slot] = NO_CHUNK;
+            pending = true;
+        }
+    }
+
+    if (!pending && (tx_chunk_next() == NO_CHUNK))
+    {
+        bit_set(m_tx.resend, m_tx.count - 1);
+    }
+
+    m_tx.deadline = now + BLOCK_TRANSFER_TX_TIMEOUT_MS;
+
+    return 0;
+}
+
+
+static void tx_nack_handle(const uint8_t * p_message, uint16_t len)
+{
+    if (!m_tx.active || (len < NACK_HEADER_SIZE) || (p_message[2] != m_tx.id))
+    {
+        return;
+    }
+
+    uint16_t base = uint16_decode(&p_message[3]);
+
+    for (uint16_t i = 0; i < (len - NACK_HEADER_SIZE) * 8; i++)
+    {
+        uint16_t seq = base + i;
+
+        if ((seq < m_tx.next) && bit_get(&p_message[NACK_HEADER_SIZE], i))
+        {
+            bit_set(m_tx.resend, seq);
+        }
+    }
+
+    m_tx.retries  = 0;
+    m_tx.deadline = app_clock_ms() + BLOCK_TRANSFER_TX_TIMEOUT_MS;
+}
+
+
+static void rx_done_send(void)
+{
+    uint8_t  message[DONE_SIZE] = {MAGIC, MSG_DONE, m_rx.id};
+    uint16_t msg_id;
+
+    UNUSED_RETURN_VALUE(message_publish(message, sizeof(message), &msg_id));
+}
+
+
+/**@brief Requests the missing chunks, starting from the first one. */
+static void rx_nack_send(void)
+{
+    uint8_t  message[NACK_HEADER_SIZE + BITMAP_SIZE];
+    uint16_t bitmap_size = MIN(BITMAP_SIZE, publish_pipeline_payload_max() - NACK_HEADER_SIZE);
+    uint16_t base        = 0;
+    uint16_t msg_id;
+
+    while ((base < m_rx.count) && bit_get(m_rx.bitmap, base))
+    {
+        base++;
+    }
+
+    memset(message, 0, sizeof(message));
+    message[0] = MAGIC;
+    message[1] = MSG_NACK;
+    message[2] = m_rx.id;
+    UNUSED_RETURN_VALUE(uint16_encode(base, &message[3]));
+
+    for (uint16_t i = 0; (i < bitmap_size * 8) && (base + i < m_rx.count); i++)
+    {
+        if (!bit_get(m_rx.bitmap, base + i))
+        {
+            bit_set(&message[NACK_HEADER_SIZE], i);
+        }
+    }
+
+    if (message_publish(message, NACK_HEADER_SIZE + bitmap_size, &msg_id) == NRF_SUCCESS)
+    {
+        m_stats.rx_nacks++;
+    }
+}
+
+
+static void rx_chunk_handle(const uint8_t * p_message, uint16_t len)
+{
+    if ((m_rx.p_buffer == NULL) || (len < DATA_HEADER_SIZE))
+    {
+        return;
+    }
+
+    uint8_t  id         = p_message[2];
+    uint8_t  chunk_size = p_message[3];
+    uint16_t seq        = uint16_decode(&p_message[4]);
+    uint16_t count      = uint16_decode(&p_message[6]);
+    uint16_t data_len   = len - DATA_HEADER_SIZE;
+    uint32_t offset     = (uint32_t)seq * chunk_size;
+
+    m_stats.rx_chunks++;
+
+    if (m_rx.done)
+    {
+        // A peer which has reset may reuse the ID of a complete transfer. It cannot be told from
+        // a sender which has missed DONE, but it starts long after that sender has given up, or
+        // with a different layout.
+        if ((id == m_rx.id) && (chunk_size == m_rx.chunk_size) && (count == m_rx.count) &&
+            !app_clock_expired(app_clock_ms(), m_rx.done_at + DONE_HOLD_MS))
+        {
+            // The sender has missed DONE.
+            rx_done_send();
+            return;
+        }
+
+        m_rx.done = false;
+    }
+
+    if (!m_rx.started || (id != m_rx.id))
+    {
+        if ((count == 0) || (count > BLOCK_TRANSFER_CHUNKS_MAX) ||
+            (((uint32_t)(count - 1) * chunk_size) >= m_rx.size))
+        {
+            return;
+        }
+
+        memset(m_rx.bitmap, 0, sizeof(m_rx.bitmap));
+        m_rx.started    = true;
+        m_rx.done       = false;
+        m_rx.id         = id;
+        m_rx.chunk_size = chunk_size;
+        m_rx.count      = count;
+        m_rx.received   = 0;
+        m_rx.len        = 0;
+    }
+
+    if ((chunk_size != m_rx.chunk_size) || (count != m_rx.count) || (seq >= count) ||
+        (data_len > chunk_size) || (offset + data_len > m_rx.size))
+    {
+        return;
+    }
+
+    if (!bit_get(m_rx.bitmap, seq))
+    {
+        memcpy(&m_rx.p_buffer[offset], &p_message[DATA_HEADER_SIZE], data_len);
+        bit_set(m_rx.bitmap, seq);
+        m_rx.received++;
+        m_rx.nacks = 0;
+    }
+
+    if (seq == count - 1)
+    {
+        m_rx.len = offset + data_len;
+    }
+
+    if (m_rx.received == m_rx.count)
+    {
+        uint32_t err_code = NRF_SUCCESS;
+        uint32_t data_len = m_rx.len;
+
+        m_rx.started  = false;
+        m_rx.done     = true;
+        m_rx.done_at  = app_clock_ms();
+        m_rx.p_buffer = NULL;
+        m_stats.rx_transfers++;
+        rx_done_send();
+
+#if BLOCK_TRANSFER_COMPRESS
+        uint16_t decoded_len = (uint16_t)MIN(m_rx.data_size, UINT16_MAX);
+
+        err_code = payload_codec_decompress(m_rx_encoded, (uint16_t)m_rx.len, m_rx.p_data, &decoded_len);
+        data_len = (err_code == NRF_SUCCESS) ? decoded_len : 0;
+#endif
+
+        if (m_rx.handler != NULL)
+        {
+            m_rx.handler(err_code, data_len);
+        }
+        return;
+    }
+
+    if (seq == count - 1)
+    {
+        rx_nack_send();
+    }
+
+    m_rx.deadline = app_clock_ms() + BLOCK_TRANSFER_RX_TIMEOUT_MS;
+}
+
+
+static uint32_t rx_process(void)
+{
+    if (!m_rx.started || !mqttsn_session_is_ready())
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint32_t now = app_clock_ms();
+
+    if (!app_clock_expired(now, m_rx.deadline))
+    {
+        return app_clock_remaining(now, m_rx.deadline);
+    }
+
+    if (++m_rx.nacks > BLOCK_TRANSFER_TX_RETRIES)
+    {
+        // The sender has given up; wait for a new transfer.
+        NRF_LOG_WARNING("Transfer %d abandoned.\r\n", m_rx.id);
+        m_rx.started  = false;
+        m_rx.p_buffer = NULL;
+
+        if (m_rx.handler != NULL)
+        {
+            m_rx.handler(NRF_ERROR_TIMEOUT, 0);
+        }
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    rx_nack_send();
+    m_rx.deadline = now + BLOCK_TRANSFER_RX_TIMEOUT_MS;
+
+    return BLOCK_TRANSFER_RX_TIMEOUT_MS;
+}
+
+
+uint32_t block_transfer_init(mqttsn_client_t             * p_client,
+                             const mqttsn_topics_entry_t * p_topic,
+                             const mqttsn_topics_entry_t * p_rx_topic)
+{
+    mp_client   = p_client;
+    mp_topic    = NULL;
+    mp_rx_topic = p_rx_topic;
+    memset(&m_tx, 0, sizeof(m_tx));
+    memset(&m_rx, 0, sizeof(m_rx));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    // IDs restarting at the same value after each reset would match transfers the peer still
+    // remembers as complete.
+    m_next_id = (uint8_t)otPlatRandomGet();
+
+    // The client would send the ID of a predefined or short topic as a normal one.
+    if (mqttsn_topics_is_static(p_topic))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    mp_topic = p_topic;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t block_transfer_send(const uint8_t * p_data, uint32_t len, block_transfer_handler_t handler)
+{
+    if (mp_topic == NULL)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (m_tx.active)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    uint32_t data_len = len;
+
+#if BLOCK_TRANSFER_COMPRESS
+    uint16_t encoded_len = sizeof(m_tx_encoded);
+
+    if ((len > BLOCK_TRANSFER_COMPRESS_MAX) ||
+        (payload_codec_compress(p_data, (uint16_t)len, m_tx_encoded, &encoded_len) != NRF_SUCCESS))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    p_data = m_tx_encoded;
+    len    = encoded_len;
+#endif
+
+    uint16_t payload_max = publish_pipeline_payload_max();
+    uint8_t  chunk_size  = (payload_max > DATA_HEADER_SIZE) ? MIN(payload_max - DATA_HEADER_SIZE, BLOCK_TRANSFER_CHUNK_MAX)
+                                                            : 1;
+    uint32_t count       = (len + chunk_size - 1) / chunk_size;
+
+    if ((count == 0) || (count > BLOCK_TRANSFER_CHUNKS_MAX))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    memset(&m_tx, 0, sizeof(m_tx));
+    memset(m_tx.inflight_seq, 0xFF, sizeof(m_tx.inflight_seq));
+
+    m_tx.active     = true;
+    m_tx.p_data     = p_data;
+    m_tx.len        = len;
+    m_tx.data_len   = data_len;
+    m_tx.handler    = handler;
+    m_tx.id         = m_next_id++;
+    m_tx.chunk_size = chunk_size;
+    m_tx.count      = count;
+    m_tx.deadline   = app_clock_ms() + BLOCK_TRANSFER_TX_TIMEOUT_MS;
+
+    m_stats.tx_bytes_in  += data_len;
+    m_stats.tx_bytes_out += len;
+
+    NRF_LOG_INFO("Transfer %d: %d bytes, %d encoded, in %d chunks.\r\n", m_tx.id, data_len, len, count);
+
+    return NRF_SUCCESS;
+}
+
+
+void block_transfer_receive(uint8_t * p_buffer, uint32_t size, block_transfer_handler_t handler)
+{
+    m_rx.p_data    = p_buffer;
+    m_rx.data_size = size;
+
+#if BLOCK_TRANSFER_COMPRESS
+    m_rx.p_buffer  = (p_buffer != NULL) ? m_rx_encoded : NULL;
+    m_rx.size      = sizeof(m_rx_encoded);
+#else
+    m_rx.p_buffer  = p_buffer;
+    m_rx.size      = size;
+#endif
+    m_rx.handler  = handler;
+    m_rx.started  = false;
+}
+
+
+bool block_transfer_evt_handle(const mqttsn_event_t * p_event)
+{
+    int8_t slot;
+
+    if (mp_topic == NULL)
+    {
+        return false;
+    }
+
+    switch (p_event->event_id)
+    {
+        case MQTTSN_EVENT_PUBLISHED:
+            slot = tx_inflight_find(p_event->event_data.published.packet.msg_id);
+            if (slot >= 0)
+            {
+                m_tx.inflight_seq[slot] = NO_CHUNK;
+            }
+            break;
+
+        case MQTTSN_EVENT_TIMEOUT:
+            slot = tx_inflight_find(p_event->event_data.error.msg_id);
+            if (slot >= 0)
+            {
+                bit_set(m_tx.resend, m_tx.inflight_seq[slot]);
+                m_tx.inflight_seq[slot] = NO_CHUNK;
+            }
+            break;
+
+        case MQTTSN_EVENT_RECEIVED:
+        {
+            const uint8_t * p_message = p_event->event_data.published.p_payload;
+            uint16_t        len       = p_event->event_data.published.packet.len;
+
+            if ((p_event->event_data.published.packet.topic.topic_id != mp_rx_topic->topic.topic_id) ||
+                (len < DONE_SIZE) || (p_message[0] != MAGIC))
+            {
+                break;
+            }
+
+            switch (p_message[1])
+            {
+                case MSG_DATA:
+                    rx_chunk_handle(p_message, len);
+                    break;
+
+                case MSG_NACK:
+                    tx_nack_handle(p_message, len);
+                    break;
+
+                case MSG_DONE:
+                    if (m_tx.active && (p_message[2] == m_tx.id))
+                    {
+                        tx_finish(NRF_SUCCESS);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+
+uint32_t block_transfer_process(void)
+{
+    uint32_t timeout_ms = tx_process();
+
+    return MIN(timeout_ms, rx_process());
+}
+
+
+const block_transfer_stats_t * block_transfer_stats_get(void)
+{
+    return &m_stats;
+}
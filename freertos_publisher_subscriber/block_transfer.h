@@ -0,0 +1,157 @@
+/** @file
+ *
+ * @defgroup block_transfer Block transfer
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Transfer of buffers larger than a single PUBLISH over MQTT-SN.
+ *
+ * @details The sender cuts a buffer into chunks which fit into a single frame, see
+ *          @ref publish_pipeline_payload_max, and publishes them with a sequence number. At most
+ *          @ref BLOCK_TRANSFER_WINDOW chunks are unacknowledged by PUBACK at any time.
+ *
+ *          The receiver places the chunks into a buffer provided by the application. When the last
+ *          chunk arrives or no chunk arrives for @ref BLOCK_TRANSFER_RX_TIMEOUT_MS, it requests
+ *          missing chunks with a NACK carrying a bitmap, so only those are sent again. A completed
+ *          transfer is confirmed with DONE. If the sender hears neither, it repeats the last chunk,
+ *          which the receiver confirms again for as long as the sender may retry. Transfer IDs
+ *          start at a random value, so that a peer which has reset does not reuse a recent one.
+ *
+ *          Each node publishes its messages on its transfer topic and receives those of the peer
+ *          on a subscribed topic. All messages start with a magic byte, so that they can be told
+ *          apart from other content of the subscribed topic; content of other topics is left
+ *          alone.
+ *
+ *          With @ref BLOCK_TRANSFER_COMPRESS set, the whole buffer is encoded with the payload
+ *          codec before it is cut into chunks and decoded by the receiver once it is complete.
+ *          Compressing the transfer as a whole lets matches reach across chunk boundaries, which
+ *          single chunks are too short for. The setting must be the same on both nodes.
+ *
+ *          Chunk header: magic, type, transfer ID, chunk size, sequence number (LE16), chunk count (LE16).
+ *          NACK:         magic, type, transfer ID, first sequence number (LE16), bitmap.
+ *          DONE:         magic, type, transfer ID.
+ */
+
+#ifndef BLOCK_TRANSFER_H__
+#define BLOCK_TRANSFER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include "mqttsn_topics.h"
+
+#ifndef BLOCK_TRANSFER_CHUNKS_MAX
+#define BLOCK_TRANSFER_CHUNKS_MAX        256                           /**< Maximum number of chunks of a transfer. */
+#endif
+
+#ifndef BLOCK_TRANSFER_CHUNK_MAX
+#define BLOCK_TRANSFER_CHUNK_MAX         64                            /**< Upper bound of the chunk size in bytes. */
+#endif
+
+#ifndef BLOCK_TRANSFER_WINDOW
+#define BLOCK_TRANSFER_WINDOW            4                             /**< Chunks which may wait for PUBACK at the same time. */
+#endif
+
+#ifndef BLOCK_TRANSFER_TX_TIMEOUT_MS
+#define BLOCK_TRANSFER_TX_TIMEOUT_MS     (10 * 1000)                   /**< Time the sender waits for DONE or NACK after the last chunk in [ms]. */
+#endif
+
+#ifndef BLOCK_TRANSFER_TX_RETRIES
+#define BLOCK_TRANSFER_TX_RETRIES        3                             /**< Repetitions of the last chunk before the transfer fails. */
+#endif
+
+#ifndef BLOCK_TRANSFER_COMPRESS
+#define BLOCK_TRANSFER_COMPRESS          1                             /**< Compress transfers with the payload codec. */
+#endif
+
+#ifndef BLOCK_TRANSFER_COMPRESS_MAX
+#define BLOCK_TRANSFER_COMPRESS_MAX      1024                          /**< Largest compressed transfer in bytes; sets the size of the codec buffers. */
+#endif
+
+#ifndef BLOCK_TRANSFER_RX_TIMEOUT_MS
+#define BLOCK_TRANSFER_RX_TIMEOUT_MS     (5 * 1000)                    /**< Time without chunks after which the receiver sends a NACK in [ms]. */
+#endif
+
+/**@brief Handler of a finished transfer.
+ *
+ * @param[in] err_code  NRF_SUCCESS, or NRF_ERROR_TIMEOUT if the peer did not respond.
+ * @param[in] len       Number of bytes transferred.
+ */
+typedef void (*block_transfer_handler_t)(uint32_t err_code, uint32_t len);
+
+/**@brief Block transfer statistics. */
+typedef struct
+{
+    uint32_t tx_transfers;                                             /**< Transfers completed by the sender. */
+    uint32_t tx_failures;                                              /**< Transfers failed on the sender side. */
+    uint32_t tx_chunks;                                                /**< Chunks published, including repetitions. */
+    uint32_t tx_resent;                                                /**< Chunks published again on request. */
+    uint32_t tx_bytes_in;                                              /**< Bytes of data of started transfers. */
+    uint32_t tx_bytes_out;                                             /**< Bytes of started transfers after encoding. */
+    uint32_t rx_transfers;                                             /**< Transfers completed by the receiver. */
+    uint32_t rx_chunks;                                                /**< Chunks received, including duplicates. */
+    uint32_t rx_nacks;                                                 /**< NACKs sent by the receiver. */
+} block_transfer_stats_t;
+
+/**@brief Initializes the block transfer layer.
+ *
+ * @details The MQTT-SN client publishes with the normal topic ID type only, so the layer stays
+ *          disabled if the topic is predefined or short.
+ *
+ * @param[in] p_client    MQTT-SN client.
+ * @param[in] p_topic     Normal topic on which chunks and control messages are published. The
+ *                        topic ID is read when publishing, after registration.
+ * @param[in] p_rx_topic  Subscribed topic on which the messages of the peer are received.
+ *
+ * @retval NRF_SUCCESS              If the layer has been initialized.
+ * @retval NRF_ERROR_INVALID_PARAM  If the topic is not a normal topic.
+ */
+uint32_t block_transfer_init(mqttsn_client_t             * p_client,
+                             const mqttsn_topics_entry_t * p_topic,
+                             const mqttsn_topics_entry_t * p_rx_topic);
+
+/**@brief Starts sending a buffer.
+ *
+ * @param[in] p_data   Data. Must stay valid until the handler is called.
+ * @param[in] len      Data length.
+ * @param[in] handler  Handler called when the transfer is finished.
+ *
+ * @retval NRF_SUCCESS               If the transfer has been started.
+ * @retval NRF_ERROR_INVALID_STATE   If the layer is disabled.
+ * @retval NRF_ERROR_BUSY            If a transfer is in progress.
+ * @retval NRF_ERROR_INVALID_LENGTH  If the buffer needs more than @ref BLOCK_TRANSFER_CHUNKS_MAX chunks,
+ *                                   or is longer than @ref BLOCK_TRANSFER_COMPRESS_MAX with
+ *                                   compression.
+ */
+uint32_t block_transfer_send(const uint8_t * p_data, uint32_t len, block_transfer_handler_t handler);
+
+/**@brief Provides a buffer for the next incoming transfer.
+ *
+ * @param[in] p_buffer  Buffer. Must stay valid until the handler is called.
+ * @param[in] size      Buffer size. Larger transfers are ignored.
+ * @param[in] handler   Handler called when a transfer has been received, or abandoned with
+ *                      NRF_ERROR_TIMEOUT, or could not be decoded into the buffer. The buffer
+ *                      has to be provided again afterwards.
+ */
+void block_transfer_receive(uint8_t * p_buffer, uint32_t size, block_transfer_handler_t handler);
+
+/**@brief Feeds an MQTT-SN client event to the block transfer layer.
+ *
+ * @return True if the event carried a block transfer message on the subscribed topic and has
+ *         been consumed.
+ */
+bool block_transfer_evt_handle(const mqttsn_event_t * p_event);
+
+/**@brief Sends pending chunks and supervises timeouts.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t block_transfer_process(void);
+
+/**@brief Returns block transfer statistics. */
+const block_transfer_stats_t * block_transfer_stats_get(void);
+
+#endif // BLOCK_TRANSFER_H__
+
+/** @} */
@@ -0,0 +1,346 @@
+/** @file
+ *
+ * @brief Wear-levelled circular log of variable length records in internal flash.
+ */
+
+#include "flash_log.h"
+
+#include <string.h>
+
+#include "nrf_nvmc.h"
+#include "sdk_errors.h"
+
+#define ERASED_WORD          0xFFFFFFFF                                /**< Content of an erased flash word. */
+#define RECORD_MAGIC         0xA55A                                    /**< Marks a record header. */
+#define RECORD_PENDING       0x8000                                    /**< Header flag, cleared when the record is consumed. */
+#define RECORD_LEN_MASK      0x7FFF                                    /**< Record length in the header. */
+#define PAGE_HEADER_SIZE     sizeof(uint32_t)                          /**< Page sequence number. */
+#define RECORD_HEADER_SIZE   sizeof(uint32_t)                          /**< Record magic and length. */
+
+#define WORDS(len)           (((len) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+STATIC_ASSERT(FLASH_LOG_PAGE_COUNT >= 2);
+STATIC_ASSERT((FLASH_LOG_START_ADDR % FLASH_LOG_PAGE_SIZE) == 0);
+
+/**@brief Position in the log. */
+typedef struct
+{
+    uint16_t page;                                                     /**< Page index within the log area. */
+    uint16_t offset;                                                   /**< Byte offset within the page. */
+} position_t;
+
+static flash_log_policy_t m_policy;                                    /**< Behavior when the log is full. */
+static flash_log_stats_t  m_stats;                                     /**< Log statistics. */
+static position_t         m_read;                                      /**< Position of the oldest record. */
+static position_t         m_write;                                     /**< Position of the next record. */
+static uint32_t           m_page_seq;                                  /**< Sequence number of the page being written. */
+
+
+static uint32_t page_addr(uint16_t page)
+{
+    return FLASH_LOG_START_ADDR + ((uint32_t)page * FLASH_LOG_PAGE_SIZE);
+}
+
+
+static uint32_t word_read(position_t pos)
+{
+    return *(volatile const uint32_t *)(page_addr(pos.page) + pos.offset);
+}
+
+
+static uint16_t page_next(uint16_t page)
+{
+    return (page + 1) % FLASH_LOG_PAGE_COUNT;
+}
+
+
+static uint16_t record_len(uint32_t header)
+{
+    return (uint16_t)(header & RECORD_LEN_MASK);
+}
+
+
+static bool record_is_pending(uint32_t header)
+{
+    return (header & RECORD_PENDING) != 0;
+}
+
+
+static bool record_is_valid(uint32_t header)
+{
+    return ((header >> 16) == RECORD_MAGIC) && (record_len(header) > 0) &&
+           (record_len(header) <= FLASH_LOG_RECORD_MAX);
+}
+
+
+/**@brief Erases a page and stamps it with the next sequence number. */
+static void page_open(uint16_t page)
+{
+    nrf_nvmc_page_erase(page_addr(page));
+    nrf_nvmc_write_word(page_addr(page), ++m_page_seq);
+    m_stats.erases++;
+
+    m_write.page   = page;
+    m_write.offset = PAGE_HEADER_SIZE;
+}
+
+
+static uint16_t record_size(uint32_t header)
+{
+    return RECORD_HEADER_SIZE + (WORDS(record_len(header)) * sizeof(uint32_t));
+}
+
+
+/**@brief Checks that a page is erased from the given offset on, so that records can be appended. */
+static bool page_is_blank(position_t pos)
+{
+    for (; pos.offset < FLASH_LOG_PAGE_SIZE; pos.offset += sizeof(uint32_t))
+    {
+        if (word_read(pos) != ERASED_WORD)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**@brief Counts the records stored in a page starting at the given offset. */
+static uint32_t page_record_count(uint16_t page, uint16_t offset)
+{
+    position_t pos   = {.page = page, .offset = offset};
+    uint32_t   count = 0;
+
+    while (pos.offset + RECORD_HEADER_SIZE <= FLASH_LOG_PAGE_SIZE)
+    {
+        uint32_t header = word_read(pos);
+
+        if (!record_is_valid(header))
+        {
+            break;
+        }
+
+        pos.offset += record_size(header);
+        count++;
+    }
+
+    return count;
+}
+
+
+void flash_log_init(flash_log_policy_t policy)
+{
+    uint16_t last_page = 0;
+    bool     found     = false;
+
+    m_policy   = policy;
+    m_page_seq = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    // Find the most recently opened page, so that erases rotate over the whole area across resets.
+    for (uint16_t page = 0; page < FLASH_LOG_PAGE_COUNT; page++)
+    {
+        uint32_t seq = *(volatile const uint32_t *)page_addr(page);
+
+        if ((seq != ERASED_WORD) && (seq >= m_page_seq))
+        {
+            m_page_seq = seq;
+            last_page  = page;
+            found      = true;
+        }
+    }
+
+    // Without an open page, the first record opens page 0.
+    m_write.page   = found ? last_page : (FLASH_LOG_PAGE_COUNT - 1);
+    m_write.offset = FLASH_LOG_PAGE_SIZE;
+
+    // Pages are opened in ring order, so the oldest one follows the most recent one. Records not
+    // consumed before the reset are recovered, starting with the oldest.
+    for (uint16_t i = 1; found && (i <= FLASH_LOG_PAGE_COUNT); i++)
+    {
+        position_t pos = {.page = (last_page + i) % FLASH_LOG_PAGE_COUNT, .offset = PAGE_HEADER_SIZE};
+
+        if (*(volatile const uint32_t *)page_addr(pos.page) == ERASED_WORD)
+        {
+            continue;
+        }
+
+        while (pos.offset + RECORD_HEADER_SIZE <= FLASH_LOG_PAGE_SIZE)
+        {
+            uint32_t header = word_read(pos);
+
+            if (!record_is_valid(header))
+            {
+                break;
+            }
+
+            if (record_is_pending(header))
+            {
+                if (m_stats.count == 0)
+                {
+                    m_read = pos;
+                }
+                m_stats.count++;
+            }
+
+            pos.offset += record_size(header);
+        }
+
+        // Appending continues in the most recent page, unless an interrupted write left data in it.
+        if ((pos.page == last_page) && page_is_blank(pos))
+        {
+            m_write = pos;
+        }
+    }
+
+    m_stats.recovered = m_stats.count;
+
+    if (flash_log_is_empty())
+    {
+        m_read = m_write;
+    }
+}
+
+
+uint32_t flash_log_append(const void * p_data, uint16_t len)
+{
+    if ((len == 0) || (len > FLASH_LOG_RECORD_MAX))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t words = WORDS(len);
+
+    if (m_write.offset + RECORD_HEADER_SIZE + (words * sizeof(uint32_t)) > FLASH_LOG_PAGE_SIZE)
+    {
+        uint16_t next = page_next(m_write.page);
+
+        if ((next == m_read.page) && !flash_log_is_empty())
+        {
+            if (m_policy == FLASH_LOG_DROP_NEWEST)
+            {
+                m_stats.dropped++;
+                return NRF_ERROR_NO_MEM;
+            }
+
+            // Discard the records of the oldest page before it is erased.
+            uint32_t lost = page_record_count(m_read.page, m_read.offset);
+
+            m_stats.dropped += lost;
+            m_stats.count   -= lost;
+            m_read.page      = page_next(next);
+            m_read.offset    = PAGE_HEADER_SIZE;
+        }
+
+        bool was_empty = flash_log_is_empty();
+
+        page_open(next);
+
+        if (was_empty)
+        {
+            m_read = m_write;
+        }
+    }
+
+    uint32_t buf[WORDS(FLASH_LOG_RECORD_MAX)];
+
+    buf[words - 1] = ERASED_WORD;
+    memcpy(buf, p_data, len);
+
+    // The payload is written before the header, so that an interrupted write leaves no valid record.
+    nrf_nvmc_write_words(page_addr(m_write.page) + m_write.offset + RECORD_HEADER_SIZE, buf, words);
+    nrf_nvmc_write_word(page_addr(m_write.page) + m_write.offset,
+                        ((uint32_t)RECORD_MAGIC << 16) | RECORD_PENDING | len);
+
+    m_write.offset += RECORD_HEADER_SIZE + (words * sizeof(uint32_t));
+    m_stats.appended++;
+    m_stats.count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t flash_log_peek(void * p_data, uint16_t * p_len)
+{
+    while (!flash_log_is_empty())
+    {
+        uint32_t header = (m_read.offset + RECORD_HEADER_SIZE <= FLASH_LOG_PAGE_SIZE) ?
+                          word_read(m_read) : ERASED_WORD;
+
+        if (record_is_valid(header) && !record_is_pending(header))
+        {
+            // Consumed before a reset.
+            m_read.offset += record_size(header);
+            continue;
+        }
+
+        if (record_is_valid(header))
+        {
+            if (record_len(header) > *p_len)
+            {
+                return NRF_ERROR_INVALID_LENGTH;
+            }
+
+            *p_len = record_len(header);
+            memcpy(p_data,
+                   (const void *)(page_addr(m_read.page) + m_read.offset + RECORD_HEADER_SIZE),
+                   *p_len);
+
+            return NRF_SUCCESS;
+        }
+
+        if (m_read.page == m_write.page)
+        {
+            // Records have been lost, e.g. due to an interrupted write. Resynchronize.
+            m_stats.count = 0;
+            m_read        = m_write;
+            break;
+        }
+
+        // End of the page reached.
+        m_read.page   = page_next(m_read.page);
+        m_read.offset = PAGE_HEADER_SIZE;
+    }
+
+    return NRF_ERROR_NOT_FOUND;
+}
+
+
+void flash_log_pop(void)
+{
+    uint8_t  record[FLASH_LOG_RECORD_MAX];
+    uint16_t len = sizeof(record);
+
+    // Peek positions the read pointer at the next valid record.
+    if (flash_log_peek(record, &len) != NRF_SUCCESS)
+    {
+        return;
+    }
+
+    uint32_t header = word_read(m_read);
+
+    // Second and last write of the header word before the page is erased.
+    nrf_nvmc_write_word(page_addr(m_read.page) + m_read.offset, header & ~RECORD_PENDING);
+
+    m_read.offset += record_size(header);
+    m_stats.consumed++;
+    m_stats.count--;
+
+    if (flash_log_is_empty())
+    {
+        m_read = m_write;
+    }
+}
+
+
+bool flash_log_is_empty(void)
+{
+    return m_stats.count == 0;
+}
+
+
+const flash_log_stats_t * flash_log_stats_get(void)
+{
+    return &m_stats;
+}
@@ -0,0 +1,95 @@
+/** @file
+ *
+ * @defgroup flash_log Flash record log
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Wear-levelled circular log of variable length records in internal flash.
+ *
+ * @details Records are appended to a ring of flash pages and consumed in FIFO order. Pages are
+ *          erased only when the write position enters them, so every page is erased once per
+ *          pass over the ring. Each page starts with a sequence number, which lets the log find
+ *          the most recently used page after a reset. Consumed records are marked by clearing a
+ *          flag in their header, so records not consumed before a reset are recovered at start-up
+ *          and appending resumes in the most recent page without an erase. A record consumed
+ *          just before a reset may be recovered again.
+ *
+ *          The area is kept out of the application image by flash_log.ld of the armgcc build,
+ *          which takes the start address from the Makefile.
+ *
+ * @note The log must only be used from a single task. Erasing a page halts the CPU for the
+ *       duration of the erase, about 85 ms.
+ */
+
+#ifndef FLASH_LOG_H__
+#define FLASH_LOG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef FLASH_LOG_START_ADDR
+#define FLASH_LOG_START_ADDR     0xF4000                               /**< Start of the log area. Must be outside the application image and the OpenThread settings area. */
+#endif
+
+#ifndef FLASH_LOG_PAGE_COUNT
+#define FLASH_LOG_PAGE_COUNT     8                                     /**< Number of flash pages used by the log. At least 2. */
+#endif
+
+#define FLASH_LOG_PAGE_SIZE      4096                                  /**< Size of a flash page in bytes. */
+#define FLASH_LOG_RECORD_MAX     252                                   /**< Maximum record length in bytes. */
+
+/**@brief Behavior when the log is full. */
+typedef enum
+{
+    FLASH_LOG_DROP_OLDEST,                                             /**< Discard the oldest page to make room. */
+    FLASH_LOG_DROP_NEWEST,                                             /**< Reject the new record. */
+} flash_log_policy_t;
+
+/**@brief Flash log statistics. */
+typedef struct
+{
+    uint32_t appended;                                                 /**< Records written. */
+    uint32_t consumed;                                                 /**< Records removed by the reader. */
+    uint32_t dropped;                                                  /**< Records lost because the log was full. */
+    uint32_t erases;                                                   /**< Page erase operations. */
+    uint32_t count;                                                    /**< Records currently stored. */
+    uint32_t recovered;                                                /**< Records found at start-up. */
+} flash_log_stats_t;
+
+/**@brief Initializes the log and recovers the records not consumed before the reset.
+ *
+ * @param[in] policy  Behavior when the log is full.
+ */
+void flash_log_init(flash_log_policy_t policy);
+
+/**@brief Appends a record.
+ *
+ * @retval NRF_SUCCESS               If the record has been written.
+ * @retval NRF_ERROR_INVALID_LENGTH  If the record is empty or longer than @ref FLASH_LOG_RECORD_MAX.
+ * @retval NRF_ERROR_NO_MEM          If the log is full and the policy is @ref FLASH_LOG_DROP_NEWEST.
+ */
+uint32_t flash_log_append(const void * p_data, uint16_t len);
+
+/**@brief Copies the oldest record.
+ *
+ * @param[out]   p_data  Buffer for the record.
+ * @param[inout] p_len   Buffer size on input, record length on output.
+ *
+ * @retval NRF_SUCCESS               If a record has been copied.
+ * @retval NRF_ERROR_NOT_FOUND       If the log is empty.
+ * @retval NRF_ERROR_INVALID_LENGTH  If the buffer is too small.
+ */
+uint32_t flash_log_peek(void * p_data, uint16_t * p_len);
+
+/**@brief Removes the oldest record. */
+void flash_log_pop(void);
+
+/**@brief Returns true if the log holds no records. */
+bool flash_log_is_empty(void);
+
+/**@brief Returns flash log statistics. */
+const flash_log_stats_t * flash_log_stats_get(void);
+
+#endif // FLASH_LOG_H__
+
+/** @} */
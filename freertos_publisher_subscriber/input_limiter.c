@@ -0,0 +1,92 @@
+/** @file
+ *
+ * @brief Debounce and rate limiting of GPIO events.
+ */
+
+#include "input_limiter.h"
+
+#include <string.h>
+
+#include "app_util_platform.h"
+#include "sdk_errors.h"
+
+static input_limiter_source_t m_sources[INPUT_LIMITER_SOURCE_COUNT];   /**< Input sources. */
+static uint8_t                m_source_count;                          /**< Number of sources in use. */
+
+
+uint32_t input_limiter_add(uint32_t pin, uint32_t now)
+{
+    if (m_source_count == INPUT_LIMITER_SOURCE_COUNT)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    input_limiter_source_t * p_source = &m_sources[m_source_count];
+
+    memset(p_source, 0, sizeof(*p_source));
+    p_source->pin = pin;
+    token_bucket_init(&p_source->bucket, INPUT_LIMITER_RATE, INPUT_LIMITER_BURST, now);
+
+    CRITICAL_REGION_ENTER();
+    m_source_count++;
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+bool input_limiter_accept(uint32_t pin, bool active, uint32_t now)
+{
+    bool accept = true;
+
+    CRITICAL_REGION_ENTER();
+
+    for (uint8_t i = 0; i < m_source_count; i++)
+    {
+        input_limiter_source_t * p_source = &m_sources[i];
+
+        if (p_source->pin != pin)
+        {
+            continue;
+        }
+
+        if (!active)
+        {
+            // The pulse has ended before the handler ran; not an edge worth debouncing.
+            p_source->glitches++;
+            accept = false;
+            break;
+        }
+
+        bool bounce = p_source->primed && ((now - p_source->last_edge_at) < INPUT_LIMITER_DEBOUNCE_MS);
+
+        p_source->primed       = true;
+        p_source->last_edge_at = now;
+
+        if (bounce)
+        {
+            p_source->bounced++;
+            accept = false;
+        }
+        else if (!token_bucket_take(&p_source->bucket, now))
+        {
+            p_source->rate_limited++;
+            accept = false;
+        }
+        else
+        {
+            p_source->accepted++;
+        }
+        break;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return accept;
+}
+
+
+const input_limiter_source_t * input_limiter_source_get(uint8_t index)
+{
+    return (index < m_source_count) ? &m_sources[index] : NULL;
+}
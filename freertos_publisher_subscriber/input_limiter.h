@@ -0,0 +1,83 @@
+/** @file
+ *
+ * @defgroup input_limiter Input limiter
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Debounce and rate limiting of GPIO events.
+ *
+ * @details Every input pin is a source with its own debounce timestamp and token bucket. An
+ *          event is rejected if it follows the previous edge of the same pin within the debounce
+ *          time; rejected edges extend the quiet period, so a burst of bounces counts as a single
+ *          event. Events which pass the debounce take a token, which bounds the rate at which a
+ *          noisy line can produce samples regardless of its edge rate.
+ *
+ *          Inputs sensed with the low-power PORT event are only known to have reached their
+ *          level when the driver ran. The caller qualifies the edge by reading the pin again in
+ *          the handler; events whose pin has already left the active level are counted as
+ *          glitches and rejected.
+ */
+
+#ifndef INPUT_LIMITER_H__
+#define INPUT_LIMITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "token_bucket.h"
+
+#ifndef INPUT_LIMITER_SOURCE_COUNT
+#define INPUT_LIMITER_SOURCE_COUNT    2                                /**< Number of input pins which can be limited. */
+#endif
+
+#ifndef INPUT_LIMITER_DEBOUNCE_MS
+#define INPUT_LIMITER_DEBOUNCE_MS     20                               /**< Quiet time after an edge in [ms]. */
+#endif
+
+#ifndef INPUT_LIMITER_RATE
+#define INPUT_LIMITER_RATE            5                                /**< Sustained events per second of a source. */
+#endif
+
+#ifndef INPUT_LIMITER_BURST
+#define INPUT_LIMITER_BURST           3                                /**< Events of a source accepted back to back. */
+#endif
+
+/**@brief Input source state and statistics. */
+typedef struct
+{
+    uint32_t       pin;                                                /**< Input pin. */
+    uint32_t       last_edge_at;                                       /**< Time of the last edge, accepted or not. */
+    bool           primed;                                             /**< Whether an edge has been seen. */
+    token_bucket_t bucket;                                             /**< Rate limit of accepted events. */
+    uint32_t       accepted;                                           /**< Events accepted. */
+    uint32_t       glitches;                                           /**< Events whose pin was no longer at the active level. */
+    uint32_t       bounced;                                            /**< Events rejected by the debounce. */
+    uint32_t       rate_limited;                                       /**< Events rejected by the token bucket. */
+} input_limiter_source_t;
+
+/**@brief Adds an input pin as source.
+ *
+ * @param[in] pin  Input pin.
+ * @param[in] now  Current time in milliseconds.
+ *
+ * @retval NRF_SUCCESS       If the source has been added.
+ * @retval NRF_ERROR_NO_MEM  If @ref INPUT_LIMITER_SOURCE_COUNT sources have been added already.
+ */
+uint32_t input_limiter_add(uint32_t pin, uint32_t now);
+
+/**@brief Decides whether an input event is processed. To be called from the GPIOTE handler.
+ *
+ * @param[in] pin     Pin which has triggered the event. Events of other pins than sources are accepted.
+ * @param[in] active  Whether the pin is still at the level of the sensed edge.
+ * @param[in] now     Current time in milliseconds.
+ *
+ * @return True if the event has to be processed.
+ */
+bool input_limiter_accept(uint32_t pin, bool active, uint32_t now);
+
+/**@brief Returns a source by index, or NULL if the index is not in use. */
+const input_limiter_source_t * input_limiter_source_get(uint8_t index);
+
+#endif // INPUT_LIMITER_H__
+
+/** @} */
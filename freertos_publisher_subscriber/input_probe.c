@@ -0,0 +1,74 @@
+/** @file
+ *
+ * @brief Measures the time from a GPIOTE event to the start of its handler.
+ */
+
+#include "input_probe.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_util.h"
+#include "nrf_gpio.h"
+#include "nrf_ppi.h"
+#include "nrf_timer.h"
+
+static input_probe_stats_t m_stats;                                    /**< Latency statistics. */
+static bool                m_initialized;                              /**< Whether the probe is running. */
+
+
+void input_probe_init(uint32_t event_address)
+{
+#if INPUT_PROBE_MARKER
+    UNUSED_PARAMETER(event_address);
+
+    nrf_gpio_cfg_output(INPUT_PROBE_MARKER_PIN);
+    nrf_gpio_pin_clear(INPUT_PROBE_MARKER_PIN);
+#else
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.min_us = UINT32_MAX;
+
+    nrf_timer_mode_set(INPUT_PROBE_TIMER, NRF_TIMER_MODE_TIMER);
+    nrf_timer_bit_width_set(INPUT_PROBE_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_frequency_set(INPUT_PROBE_TIMER, NRF_TIMER_FREQ_1MHz);
+
+    nrf_ppi_channel_endpoint_setup(INPUT_PROBE_PPI_CHANNEL,
+                                   event_address,
+                                   nrf_timer_task_address_get(INPUT_PROBE_TIMER, NRF_TIMER_TASK_CAPTURE0));
+    nrf_ppi_channel_enable(INPUT_PROBE_PPI_CHANNEL);
+
+    nrf_timer_task_trigger(INPUT_PROBE_TIMER, NRF_TIMER_TASK_START);
+#endif
+
+    m_initialized = true;
+}
+
+
+void input_probe_handler_entered(void)
+{
+    if (!m_initialized)
+    {
+        return;
+    }
+
+#if INPUT_PROBE_MARKER
+    nrf_gpio_pin_toggle(INPUT_PROBE_MARKER_PIN);
+#else
+    nrf_timer_task_trigger(INPUT_PROBE_TIMER, NRF_TIMER_TASK_CAPTURE1);
+
+    uint32_t latency = nrf_timer_cc_read(INPUT_PROBE_TIMER, NRF_TIMER_CC_CHANNEL1) -
+                       nrf_timer_cc_read(INPUT_PROBE_TIMER, NRF_TIMER_CC_CHANNEL0);
+
+    m_stats.samples++;
+    m_stats.last_us   = latency;
+    m_stats.min_us    = MIN(m_stats.min_us, latency);
+    m_stats.max_us    = MAX(m_stats.max_us, latency);
+    m_stats.total_us += latency;
+#endif
+}
+
+
+const input_probe_stats_t * input_probe_stats_get(void)
+{
+    return (m_initialized && !INPUT_PROBE_MARKER) ? &m_stats : NULL;
+}
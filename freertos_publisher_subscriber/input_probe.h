@@ -0,0 +1,70 @@
+/** @file
+ *
+ * @defgroup input_probe Input latency probe
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Measures the time from a GPIOTE event to the start of its handler.
+ *
+ * @details By default the GPIOTE event captures a free-running timer through PPI, and the
+ *          handler captures it again on entry. The difference covers the interrupt entry and the
+ *          driver processing, which is where the IN event and the low-power PORT event differ
+ *          most, since the driver has to scan the pins after a PORT event. The running timer keeps
+ *          the high-frequency clock requested, so the reported figure is not the wake-up latency:
+ *          it leaves out the HFCLK start-up, and the sleep current is not representative.
+ *
+ *          With @ref INPUT_PROBE_MARKER set, no timer runs and the HFCLK is released as usual.
+ *          The handler toggles @ref INPUT_PROBE_MARKER_PIN on entry instead, and the latency is
+ *          measured externally, from the button edge to the marker edge, e.g. with a logic
+ *          analyzer. This is the figure to compare the input modes by. No statistics are kept.
+ *
+ * @note The probe is a development aid and is disabled by default.
+ */
+
+#ifndef INPUT_PROBE_H__
+#define INPUT_PROBE_H__
+
+#include <stdint.h>
+
+#ifndef INPUT_PROBE_MARKER
+#define INPUT_PROBE_MARKER         0                                   /**< Toggle a marker pin on handler entry instead of running the timer. */
+#endif
+
+#ifndef INPUT_PROBE_MARKER_PIN
+#define INPUT_PROBE_MARKER_PIN     NRF_GPIO_PIN_MAP(1, 15)             /**< Marker pin, a free pin of the PCA10056 header. */
+#endif
+
+#ifndef INPUT_PROBE_TIMER
+#define INPUT_PROBE_TIMER          NRF_TIMER3                          /**< Timer instance, must not be used by the radio driver. */
+#endif
+
+#ifndef INPUT_PROBE_PPI_CHANNEL
+#define INPUT_PROBE_PPI_CHANNEL    NRF_PPI_CHANNEL19                   /**< PPI channel, must not be used by the radio driver. */
+#endif
+
+/**@brief Latency statistics in microseconds. */
+typedef struct
+{
+    uint32_t samples;                                                  /**< Number of measurements. */
+    uint32_t last_us;                                                  /**< Latest latency. */
+    uint32_t min_us;                                                   /**< Lowest latency. */
+    uint32_t max_us;                                                   /**< Highest latency. */
+    uint32_t total_us;                                                 /**< Sum of all latencies. */
+} input_probe_stats_t;
+
+/**@brief Starts the timer and connects it to a GPIOTE event, or configures the marker pin.
+ *
+ * @param[in] event_address  Address of the event, as returned by nrf_drv_gpiote_in_event_addr_get().
+ *                           Unused with @ref INPUT_PROBE_MARKER.
+ */
+void input_probe_init(uint32_t event_address);
+
+/**@brief Records the latency of the latest event, or toggles the marker pin. To be called first thing in the handler. */
+void input_probe_handler_entered(void);
+
+/**@brief Returns latency statistics, or NULL if the probe has not been initialized or uses the marker pin. */
+const input_probe_stats_t * input_probe_stats_get(void);
+
+#endif // INPUT_PROBE_H__
+
+/** @} */
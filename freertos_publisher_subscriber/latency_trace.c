@@ -0,0 +1,151 @@
+/** @file
+ *
+ * @brief Per-stage latency histograms of published samples.
+ */
+
+#include "latency_trace.h"
+
+#include <stdbool.h>
+
+#include "app_clock.h"
+#include "app_util.h"
+
+#define STAMP_WRAP_MS    ((uint32_t)(((uint64_t)APP_CLOCK_STAMP_MASK + 1) * 1000 / APP_CLOCK_STAMP_HZ))  /**< Period of the timestamps in [ms]. */
+
+/**@brief PUBLISH message waiting for its PUBACK. */
+typedef struct
+{
+    bool     used;                                                     /**< Whether the entry is in use. */
+    uint16_t msg_id;                                                   /**< Message ID. */
+    uint32_t queued_us;                                                /**< Time from queuing to the hand-over, or LATENCY_TRACE_NO_STAMP. */
+    uint32_t sent_at;                                                  /**< Timestamp of the hand-over to OpenThread. */
+    uint32_t sent_ms;                                                  /**< Time of the hand-over in [ms], to detect timestamp wrap-around. */
+} inflight_t;
+
+static latency_trace_histogram_t m_histograms[LATENCY_TRACE_STAGE_COUNT];  /**< Histograms by stage. */
+static inflight_t                m_inflight[LATENCY_TRACE_INFLIGHT];       /**< Traced PUBLISH messages. */
+static uint8_t                   m_inflight_next;                          /**< Entry replaced next if all are in use. */
+
+static const char * const        m_stage_names[LATENCY_TRACE_STAGE_COUNT] =
+{
+    "queue",
+    "send",
+    "ack",
+    "total",
+};
+
+
+static void histogram_add(latency_trace_stage_t stage, uint32_t us)
+{
+    latency_trace_histogram_t * p_histogram = &m_histograms[stage];
+    uint8_t                     bucket      = 0;
+
+    while ((bucket < LATENCY_TRACE_BUCKETS - 1) && (us > ((uint32_t)LATENCY_TRACE_BUCKET_MIN_US << bucket)))
+    {
+        bucket++;
+    }
+
+    p_histogram->count++;
+    p_histogram->max_us    = MAX(p_histogram->max_us, us);
+    p_histogram->total_us += us;
+    p_histogram->buckets[bucket]++;
+}
+
+
+void latency_trace_sent(uint16_t msg_id, uint32_t queue_ms, uint32_t started_at, uint32_t sent_at)
+{
+    uint32_t send_us   = app_clock_stamp_us(started_at, sent_at);
+    uint32_t queued_us = LATENCY_TRACE_NO_STAMP;
+
+    if (queue_ms != LATENCY_TRACE_NO_STAMP)
+    {
+        // Saturates after 35 minutes, well into the last bucket, so that adding the timestamp
+        // intervals of less than 512 s each cannot overflow.
+        uint32_t queue_us = MIN(queue_ms, UINT32_MAX / 2 / 1000) * 1000;
+
+        histogram_add(LATENCY_TRACE_STAGE_QUEUE, queue_us);
+        queued_us = queue_us + send_us;
+    }
+
+    histogram_add(LATENCY_TRACE_STAGE_SEND, send_us);
+
+    inflight_t * p_entry = &m_inflight[m_inflight_next];
+
+    for (uint8_t i = 0; i < LATENCY_TRACE_INFLIGHT; i++)
+    {
+        if (!m_inflight[i].used)
+        {
+            p_entry = &m_inflight[i];
+            break;
+        }
+    }
+
+    m_inflight_next = (m_inflight_next + 1) % LATENCY_TRACE_INFLIGHT;
+
+    p_entry->used      = true;
+    p_entry->msg_id    = msg_id;
+    p_entry->queued_us = queued_us;
+    p_entry->sent_at   = sent_at;
+    p_entry->sent_ms   = app_clock_ms();
+}
+
+
+void latency_trace_evt_handle(const mqttsn_event_t * p_event)
+{
+    uint16_t msg_id;
+
+    switch (p_event->event_id)
+    {
+        case MQTTSN_EVENT_PUBLISHED:
+            msg_id = p_event->event_data.published.packet.msg_id;
+            break;
+
+        case MQTTSN_EVENT_TIMEOUT:
+            msg_id = p_event->event_data.error.msg_id;
+            break;
+
+        default:
+            return;
+    }
+
+    uint32_t now    = app_clock_stamp();
+    uint32_t now_ms = app_clock_ms();
+
+    for (uint8_t i = 0; i < LATENCY_TRACE_INFLIGHT; i++)
+    {
+        inflight_t * p_entry = &m_inflight[i];
+
+        if (!p_entry->used || (p_entry->msg_id != msg_id))
+        {
+            continue;
+        }
+
+        p_entry->used = false;
+
+        // A timestamp interval longer than the wrap-around would be measured short.
+        if ((p_event->event_id == MQTTSN_EVENT_PUBLISHED) && ((now_ms - p_entry->sent_ms) < STAMP_WRAP_MS))
+        {
+            uint32_t ack_us = app_clock_stamp_us(p_entry->sent_at, now);
+
+            histogram_add(LATENCY_TRACE_STAGE_ACK, ack_us);
+
+            if (p_entry->queued_us != LATENCY_TRACE_NO_STAMP)
+            {
+                histogram_add(LATENCY_TRACE_STAGE_TOTAL, p_entry->queued_us + ack_us);
+            }
+        }
+        break;
+    }
+}
+
+
+const latency_trace_histogram_t * latency_trace_histogram_get(latency_trace_stage_t stage)
+{
+    return &m_histograms[stage];
+}
+
+
+const char * latency_trace_stage_name(latency_trace_stage_t stage)
+{
+    return m_stage_names[stage];
+}
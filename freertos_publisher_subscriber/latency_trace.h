@@ -0,0 +1,75 @@
+/** @file
+ *
+ * @defgroup latency_trace Publish latency trace
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Per-stage latency histograms of published samples.
+ *
+ * @details Samples are timestamped when they are queued, which for button samples is in the GPIOTE
+ *          handler, when the pipeline starts publishing them, when the MQTT-SN client has
+ *          serialized the PUBLISH and handed it to the OpenThread UDP socket, and when the PUBACK
+ *          arrives. The intervals between these points are collected in histograms with bucket
+ *          bounds doubling from @ref LATENCY_TRACE_BUCKET_MIN_US.
+ *
+ *          Samples may wait in the queue for as long as the session is down, so the queue time is
+ *          measured in milliseconds with @ref app_clock_ms. The other stages are measured with
+ *          RTC timestamps, which wrap after 512 s; acknowledgements arriving later than that are
+ *          not recorded.
+ */
+
+#ifndef LATENCY_TRACE_H__
+#define LATENCY_TRACE_H__
+
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+
+#ifndef LATENCY_TRACE_INFLIGHT
+#define LATENCY_TRACE_INFLIGHT        8                                /**< PUBLISH messages traced while waiting for their PUBACK. */
+#endif
+
+#define LATENCY_TRACE_BUCKETS         16                               /**< Histogram buckets; the last one collects all longer intervals. */
+#define LATENCY_TRACE_BUCKET_MIN_US   250                              /**< Upper bound of the first bucket. */
+#define LATENCY_TRACE_NO_STAMP        UINT32_MAX                       /**< Timestamp which is not known. */
+
+/**@brief Traced intervals. */
+typedef enum
+{
+    LATENCY_TRACE_STAGE_QUEUE,                                         /**< From queuing to the start of the publish. */
+    LATENCY_TRACE_STAGE_SEND,                                          /**< Serialization and hand-over to OpenThread. */
+    LATENCY_TRACE_STAGE_ACK,                                           /**< From the hand-over to the PUBACK. */
+    LATENCY_TRACE_STAGE_TOTAL,                                         /**< From queuing to the PUBACK. */
+    LATENCY_TRACE_STAGE_COUNT,
+} latency_trace_stage_t;
+
+/**@brief Latency histogram. */
+typedef struct
+{
+    uint32_t count;                                                    /**< Recorded intervals. */
+    uint32_t max_us;                                                   /**< Longest interval. */
+    uint64_t total_us;                                                 /**< Sum of all intervals. */
+    uint32_t buckets[LATENCY_TRACE_BUCKETS];                           /**< Intervals up to LATENCY_TRACE_BUCKET_MIN_US << index. */
+} latency_trace_histogram_t;
+
+/**@brief Records the stages up to the hand-over of a PUBLISH and waits for its PUBACK.
+ *
+ * @param[in] msg_id      Message ID of the PUBLISH.
+ * @param[in] queue_ms    Time spent in the queue in [ms], or @ref LATENCY_TRACE_NO_STAMP if it is not known.
+ * @param[in] started_at  Timestamp of the start of the publish.
+ * @param[in] sent_at     Timestamp of the hand-over to OpenThread.
+ */
+void latency_trace_sent(uint16_t msg_id, uint32_t queue_ms, uint32_t started_at, uint32_t sent_at);
+
+/**@brief Records the remaining stages on PUBACK and forgets PUBLISH messages which timed out. */
+void latency_trace_evt_handle(const mqttsn_event_t * p_event);
+
+/**@brief Returns the histogram of a stage. */
+const latency_trace_histogram_t * latency_trace_histogram_get(latency_trace_stage_t stage);
+
+/**@brief Returns the name of a stage. */
+const char * latency_trace_stage_name(latency_trace_stage_t stage);
+
+#endif // LATENCY_TRACE_H__
+
+/** @} */
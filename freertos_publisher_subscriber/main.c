@@ -71,9 +71,9 @@
 #endif
 
 
- #define NRF_LOG_ENABLED 1
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include "app_scheduler.h"
 
@@ -82,12 +82,27 @@
 #include "task.h"
 
 #define NRF_LOG_MODULE_NAME APP
-#include "nrf_log.h"
+#include "app_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 NRF_LOG_MODULE_REGISTER();
 
+#include "block_transfer.h"
+#include "input_limiter.h"
+#include "input_probe.h"
+#include "latency_trace.h"
 #include "mqttsn_client.h"
+#include "mqttsn_fastpath.h"
+#include "mqttsn_keepalive.h"
+#include "mqttsn_session.h"
+#include "payload_codec.h"
+#include "publish_aggregator.h"
+#include "publish_filter.h"
+#include "poll_control.h"
+#include "publish_pipeline.h"
+#include "sampler.h"
+#include "app_clock.h"
+#include "app_metrics.h"
 
 #include "app_timer.h"
 #include "bsp_thread.h"
@@ -108,7 +123,6 @@ NRF_LOG_MODULE_REGISTER();
 #define LED2_TASK_PRIORITY               1
 #define LED1_BLINK_INTERVAL              427
 #define LED2_BLINK_INTERVAL              472
-#define SEARCH_GATEWAY_TIMEOUT 5                                            /**< MQTT-SN Gateway discovery procedure timeout in [s]. */
 
 
 typedef struct
@@ -139,58 +153,190 @@ TaskHandle_t  led_toggle_task_handle;   /**< Reference to LED0 toggling FreeRTOS
 
 #define MQTT_SUB "v1/sub"
 #define MQTT_PUB "v1/pub"
+#define MQTT_SAMPLES "v1/samples"
 #define MQTT_ID MQTT_SUB "-id"
 
 
 static mqttsn_client_t      m_client;                          /**< An MQTT-SN client instance. */
-static mqttsn_remote_t      m_gateway_addr;                    /**< A gateway address. */
-static uint8_t              m_gateway_id;                      /**< A gateway ID. */
 static mqttsn_connect_opt_t m_connect_opt;                     /**< Connect options for the MQTT-SN client. */
-static uint16_t             m_msg_id_sub           = 0;        /**< Message ID thrown with MQTTSN_EVENT_TIMEOUT. */
-static uint16_t             m_msg_id_pub           = 0;        /**< Message ID thrown with MQTTSN_EVENT_TIMEOUT. */
 
-static bool                 m_subscribed       = 0;            /**< Current subscription state. */
 static char                 m_client_id[]    =  MQTT_ID;      /**< The MQTT-SN Client's ID. */
 
 
 #define MQTT_SUB "v1/sub"
 #define MQTT_PUB "v1/pub"
-#define MESSAGE_LENGTH 12                                      /**< Length of message. Max 255>*/
+#define MESSAGE_LENGTH 19                                      /**< Largest length of a button message. Keep within publish_pipeline_payload_max() to avoid fragmentation. */
 
-static char                 m_topic_pub_name[]   =  MQTT_PUB;  /**< Name of the topic to publish to. */
-static mqttsn_topic_t       m_topic_pub            =           /**< Topic corresponding to publisher>*/
+#ifndef APP_SLEEPY_END_DEVICE
+#define APP_SLEEPY_END_DEVICE 0                                /**< Run as a Sleepy End Device with an adaptive poll period. */
+#endif
+
+#ifndef APP_PUBLISH_QOS_M1
+#define APP_PUBLISH_QOS_M1 0                                   /**< Publish button samples over the QoS -1 fast path instead of the session. */
+#endif
+
+/* Topic table. MQTTSN_TOPICS_PREDEFINED(id) and MQTTSN_TOPICS_SHORT(c0, c1) topics need no registration.
+   Add ", .compressed = true" to the arguments to encode the payloads with the payload codec, which only pays off for
+   payloads of about 96 bytes or more, up to PUBLISH_PIPELINE_PAYLOAD_MAX. */
+#ifndef APP_TOPIC_PUB
+#if APP_PUBLISH_QOS_M1
+#define APP_TOPIC_PUB MQTTSN_TOPICS_PREDEFINED(1)              /**< Topic to publish to. */
+#else
+#define APP_TOPIC_PUB MQTTSN_TOPICS_NORMAL(MQTT_PUB)           /**< Topic to publish to. */
+#endif
+#endif
+
+#ifndef APP_SAMPLER
+#define APP_SAMPLER 0                                          /**< Publish blocks of periodic samples of the simulated source. */
+#endif
+
+#ifndef APP_SAMPLER_PERIOD_MS
+#define APP_SAMPLER_PERIOD_MS 100                              /**< Sampling period in [ms]. */
+#endif
+
+#ifndef APP_SAMPLER_WINDOW
+#define APP_SAMPLER_WINDOW 50                                  /**< Samples summarized per published record, 0 to publish every block. */
+#endif
+
+#ifndef APP_TOPIC_SAMPLES
+#define APP_TOPIC_SAMPLES MQTTSN_TOPICS_NORMAL(MQTT_SAMPLES)   /**< Topic to publish sample blocks to. */
+#endif
+
+#ifndef APP_TOPIC_SUB
+#define APP_TOPIC_SUB MQTTSN_TOPICS_NORMAL(MQTT_SUB)           /**< Topic to subscribe to. */
+#endif
+
+static mqttsn_topics_entry_t m_pub_topics[] =                  /**< Topics corresponding to publisher. */
 {
-    .p_topic_name = (unsigned char *)m_topic_pub_name,
-    .topic_id     = 0,
+    APP_TOPIC_PUB,
+#if APP_SAMPLER
+    APP_TOPIC_SAMPLES,
+#endif
 };
 
-static char                 m_topic_sub_name[] = MQTT_SUB;     /**< Name of the topic to subscribe to. */
-static mqttsn_topic_t       m_topic_sub        =               
+static mqttsn_topics_entry_t m_sub_topics[] =                  /**< Topics corresponding to subscriber. */
 {
-    .p_topic_name = (unsigned char *)m_topic_sub_name,
-    .topic_id     = 0,
+    APP_TOPIC_SUB,
 };
 
+#ifndef APP_LOCAL_CONTROL
+#define APP_LOCAL_CONTROL 0                                    /**< Multicast button presses to nearby nodes as local commands and act on received ones. */
+#endif
+
+#ifndef APP_TOPIC_LOCAL
+#define APP_TOPIC_LOCAL MQTTSN_TOPICS_SHORT('l', 'c')          /**< Topic of local commands. */
+#endif
+
+#if APP_LOCAL_CONTROL
+static const mqttsn_topics_entry_t m_local_topic = APP_TOPIC_LOCAL;   /**< Topic of local commands. */
+#endif
+
+#ifndef APP_INPUT_HI_ACCURACY
+#define APP_INPUT_HI_ACCURACY 1                                /**< Sense the button with a GPIOTE IN event (1), or with the PORT event (0), which lowers the sleep current at the cost of latency. */
+#endif
+
+#ifndef APP_INPUT_LATENCY_PROBE
+#define APP_INPUT_LATENCY_PROBE 0                              /**< Measure the latency from the GPIOTE event to the button handler. */
+#endif
+
+#ifndef APP_PUBLISH_DEADBAND
+#define APP_PUBLISH_DEADBAND 0                                 /**< Button presses which are not published before the next one is. */
+#endif
+
+#ifndef APP_PUBLISH_HEARTBEAT_MS
+#define APP_PUBLISH_HEARTBEAT_MS 60000                         /**< Interval in [ms] at which the last button sample is republished while the button is idle. */
+#endif
+
+#ifndef APP_BLOCK_BUFFER_SIZE
+#define APP_BLOCK_BUFFER_SIZE 1024                             /**< Size of the buffer for block transfers received from the subscribed topic. */
+#endif
+
+#ifndef APP_BLOCK_ECHO
+#define APP_BLOCK_ECHO 1                                       /**< Send each received block transfer back to the peer on the publish topic. */
+#endif
+
+static uint8_t m_block_buffer[APP_BLOCK_BUFFER_SIZE];          /**< Buffer for block transfers. */
+
+
+static int32_t m_press_count;                                  /**< Button presses accepted by the input limiter. */
+
 
 /*
     Button interrupt
 */
 
  
-uint8_t tx_message[MESSAGE_LENGTH] = "publish msg"; 
+uint8_t tx_message[] = "publish msg";
+
+
+/**@brief Queues a button sample carrying the press count on the publish path. */
+static uint32_t button_sample_post(const mqttsn_topics_entry_t * p_topic, int32_t count)
+{
+    char     message[MESSAGE_LENGTH + 1];
+    uint16_t len = (uint16_t)snprintf(message, sizeof(message), "presses=%ld", (long)count);
+
+#if APP_PUBLISH_QOS_M1
+    return mqttsn_fastpath_post(p_topic, (const uint8_t *)message, len);
+#else
+    return publish_pipeline_put(p_topic, (const uint8_t *)message, len);
+#endif
+}
+
+
+/**@brief Republishes the last button sample while the button is idle. Runs in the Thread stack task. */
+static void button_heartbeat_handler(const mqttsn_topics_entry_t * p_topic, int32_t value)
+{
+    uint32_t ec = button_sample_post(p_topic, value);
+    if (ec != NRF_SUCCESS)
+    {
+        APP_LOG_ERROR_LIMITED("Heartbeat could not be queued. Error code: 0x%x\r\n", ec);
+    }
+}
+
+
 void in_pin_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
 {
 
+#if APP_INPUT_LATENCY_PROBE
+    input_probe_handler_entered();
+#endif
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    uint32_t   now                        = app_clock_ms_from_isr();
+    bool       active                     = APP_INPUT_HI_ACCURACY || !nrf_drv_gpiote_in_is_set(pin);
+
+    // Bounces and bursts of a noisy line are dropped before they cost anything else.
+    if (!input_limiter_accept(pin, active, now))
+    {
+        return;
+    }
+
     nrf_drv_gpiote_out_toggle(PIN_OUT);
-    uint32_t ec = mqttsn_client_publish(&m_client, m_topic_pub.topic_id, tx_message, MESSAGE_LENGTH, &m_msg_id_pub);
-    if (ec != NRF_SUCCESS)
+
+    // The pin only senses the falling edge, so presses are counted rather than read back as a level.
+    m_press_count++;
+
+    if (publish_filter_pass(&m_pub_topics[0], m_press_count, now))
     {
-        NRF_LOG_ERROR("PUBLISH message could not be sent. Error code: 0x%x\r\n", ec)
+        uint32_t ec = button_sample_post(&m_pub_topics[0], m_press_count);
+        if (ec != NRF_SUCCESS)
+        {
+            APP_LOG_ERROR_LIMITED("PUBLISH message could not be queued. Error code: 0x%x\r\n", ec);
+        }
     }
+
+#if APP_LOCAL_CONTROL
+    // Nearby actuators are switched directly, without the round trip through the gateway.
+    UNUSED_RETURN_VALUE(mqttsn_fastpath_local_post(&m_local_topic, tx_message, sizeof(tx_message)));
+#endif
+
+    // The sample is published from the Thread stack task.
+    vTaskNotifyGiveFromISR(m_app.thread_stack_task, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 /**
  * @brief Function for configuring: PIN_IN pin for input, PIN_OUT pin for output,
- * and configures GPIOTE to give an interrupt on pin change.
+ * and configures GPIOTE to give an interrupt on pin change once enabled by the Thread stack task.
  */
 static void gpio_init(void)
 {
@@ -204,13 +350,19 @@ static void gpio_init(void)
     err_code = nrf_drv_gpiote_out_init(PIN_OUT, &out_config);
     APP_ERROR_CHECK(err_code);
 
-    nrf_drv_gpiote_in_config_t in_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
+    nrf_drv_gpiote_in_config_t in_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(APP_INPUT_HI_ACCURACY);
     in_config.pull = NRF_GPIO_PIN_PULLUP;
 
+    err_code = input_limiter_add(PIN_IN, app_clock_ms());
+    APP_ERROR_CHECK(err_code);
+
     err_code = nrf_drv_gpiote_in_init(PIN_IN, &in_config, in_pin_handler);
     APP_ERROR_CHECK(err_code);
 
-    nrf_drv_gpiote_in_event_enable(PIN_IN, true);
+#if APP_INPUT_LATENCY_PROBE
+    // The IN event of the pin, or the PORT event in low-power mode.
+    input_probe_init(nrf_drv_gpiote_in_event_addr_get(PIN_IN));
+#endif
 }
 
 
@@ -220,16 +372,30 @@ static void gpio_init(void)
 
 static inline void light_on(void)
 {
-    vTaskResume(m_app.led1_task);
-    vTaskResume(m_app.led2_task);
+    if (m_app.led1_task != NULL)
+    {
+        vTaskResume(m_app.led1_task);
+    }
+
+    if (m_app.led2_task != NULL)
+    {
+        vTaskResume(m_app.led2_task);
+    }
 }
 
 static inline void light_off(void)
 {
-    vTaskSuspend(m_app.led1_task);
+    // vTaskSuspend(NULL) would suspend the calling Thread stack task.
+    if (m_app.led1_task != NULL)
+    {
+        vTaskSuspend(m_app.led1_task);
+    }
     LEDS_OFF(BSP_LED_2_MASK);
 
-    vTaskSuspend(m_app.led2_task);
+    if (m_app.led2_task != NULL)
+    {
+        vTaskSuspend(m_app.led2_task);
+    }
     LEDS_OFF(BSP_LED_3_MASK);
 }
 
@@ -259,8 +425,15 @@ void otSysEventSignalPending(void)
 
 static void state_changed_callback(uint32_t flags, void * p_context)
 {
-    NRF_LOG_INFO("State changed! Flags: 0x%08x Current role: %d\r\n",
-                 flags, otThreadGetDeviceRole(p_context));
+    otDeviceRole role = otThreadGetDeviceRole(p_context);
+
+    NRF_LOG_INFO("State changed! Flags: 0x%08x Current role: %d\r\n", flags, role);
+
+    if (flags & OT_CHANGED_THREAD_ROLE)
+    {
+        publish_pipeline_role_set(role);
+        mqttsn_keepalive_role_set(role);
+    }
 }
 
 
@@ -276,104 +449,154 @@ static void connect_opt_init(void)
 }
 
 
-/**@brief Processes GWINFO message from a gateway.
+/**@brief Processes MQTT-SN session state changes.
  *
- * @details This function updates MQTT-SN Gateway information.
+ * @details The LEDs indicate whether the session is ready for publishing.
  *
- * @param[in]    p_event  Pointer to MQTT-SN event.
+ * @param[in] state  New session state.
  */
-static void gateway_info_callback(mqttsn_event_t * p_event)
+static void session_state_handler(mqttsn_session_state_t state)
 {
-    m_gateway_addr  = *(p_event->event_data.connected.p_gateway_addr);
-    m_gateway_id    = p_event->event_data.connected.gateway_id;
-}
-
-
-static void subscribe(void)
-{
-    uint8_t  topic_sub_name_len = strlen(m_topic_sub_name);
-    uint32_t err_code       = NRF_SUCCESS;
-
-    if (m_subscribed)
+    if (state == MQTTSN_SESSION_STATE_READY)
     {
-        err_code = mqttsn_client_unsubscribe(&m_client, m_topic_sub.p_topic_name, topic_sub_name_len, &m_msg_id_sub);
-        if (err_code != NRF_SUCCESS)
-        {
-            NRF_LOG_ERROR("UNSUBSCRIBE message could not be sent.\r\n");
-        }
-        else
-        {
-            m_subscribed = false;
-        }
+        light_on();
     }
-    else
+    else if (state == MQTTSN_SESSION_STATE_BACKING_OFF)
     {
-        err_code = mqttsn_client_subscribe(&m_client, m_topic_sub.p_topic_name, topic_sub_name_len, &m_msg_id_sub);
-        if (err_code != NRF_SUCCESS)
-        {
-            NRF_LOG_ERROR("SUBSCRIBE message could not be sent.\r\n");
-        }
-        else
-        {
-            m_subscribed = true;
-        }
+        light_off();
     }
 }
 
-/**@brief Processes CONNACK message from a gateway.
+
+/**@brief Processes REGACK message from a gateway.
  *
- * @details This function launches the topic registration procedure if necessary.
+ * @param[in] p_event Pointer to MQTT-SN event.
  */
-static void connected_callback(void)
+static void regack_callback(mqttsn_event_t * p_event)
+{
+    NRF_LOG_INFO("MQTT-SN event: Topic has been registered with ID: %d.\r\n",
+                 p_event->event_data.registered.packet.topic.topic_id);
+}
+
+
+static void received_callback(mqttsn_event_t * p_event)
 {
-    light_on();
+        char       line[sizeof("message: ") + PUBLISH_PIPELINE_PAYLOAD_MAX];
+        uint8_t    decoded[PUBLISH_PIPELINE_PAYLOAD_MAX];
+        uint8_t  * p_payload = p_event->event_data.published.p_payload;
+        uint16_t   len       = p_event->event_data.published.packet.len;
 
-    uint32_t err_code = mqttsn_client_topic_register(&m_client,
-                                                     m_topic_pub.p_topic_name,
-                                                     strlen(m_topic_pub_name),
-                                                     &m_msg_id_pub);
-    if (err_code != NRF_SUCCESS)
-    {
-        NRF_LOG_ERROR("REGISTER message could not be sent. Error code: 0x%x\r\n", err_code);
-    }
+        APP_LOG_INFO_LIMITED("MQTT-SN event: Content to subscribed topic received.\r\n");
 
-    subscribe();
+        // A command may be followed by further ones, so poll the parent quickly.
+        poll_control_activity();
+
+        for (uint8_t i = 0; i < ARRAY_SIZE(m_sub_topics); i++)
+        {
+            if (m_sub_topics[i].compressed &&
+                (m_sub_topics[i].topic.topic_id == p_event->event_data.published.packet.topic.topic_id))
+            {
+                uint16_t decoded_len = sizeof(decoded);
+                uint32_t err_code    = payload_codec_decompress(p_payload, len, decoded, &decoded_len);
+
+                if (err_code != NRF_SUCCESS)
+                {
+                    NRF_LOG_ERROR("Payload could not be decoded. Error: 0x%x\r\n", err_code);
+                    return;
+                }
+
+                p_payload = decoded;
+                len       = decoded_len;
+                break;
+            }
+        }
+
+        len = MIN(len, PUBLISH_PIPELINE_PAYLOAD_MAX);
+
+        // The payload is in RAM, so it is logged as text rather than by reference.
+        snprintf(line, sizeof(line), "message: %.*s", len, (const char *)p_payload);
+        APP_LOG_INFO_STRING_LIMITED(line);
 }
 
 
-/**@brief Processes DISCONNECT message from a gateway. */
-static void disconnected_callback(void)
+#if APP_LOCAL_CONTROL
+/**@brief Processes local commands received from the realm-local multicast group. */
+static void local_command_handler(mqttsn_topics_type_t type,
+                                  uint16_t             topic_id,
+                                  const uint8_t      * p_payload,
+                                  uint16_t             len)
 {
-    light_off();
+    if ((type != m_local_topic.type) || (topic_id != m_local_topic.topic.topic_id))
+    {
+        return;
+    }
+
+    NRF_LOG_INFO("Local command received, %d bytes.\r\n", len);
+
+    nrf_drv_gpiote_out_toggle(PIN_OUT);
+    poll_control_activity();
 }
+#endif
 
 
-/**@brief Processes REGACK message from a gateway.
- *
- * @param[in] p_event Pointer to MQTT-SN event.
- */
-static void regack_callback(mqttsn_event_t * p_event)
+/**@brief Processes a complete block transfer and waits for the next one. */
+#if APP_BLOCK_ECHO
+static void block_received_handler(uint32_t err_code, uint32_t len);
+
+
+/**@brief Provides the buffer for the next block once an echoed one has been sent. */
+static void block_sent_handler(uint32_t err_code, uint32_t len)
 {
-    m_topic_pub.topic_id = p_event->event_data.registered.packet.topic.topic_id;
-    NRF_LOG_INFO("MQTT-SN event: Topic has been registered with ID: %d.\r\n",
-                 p_event->event_data.registered.packet.topic.topic_id);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Block echo failed. Error: 0x%x\r\n", err_code);
+    }
+    else
+    {
+        NRF_LOG_INFO("Block of %d bytes echoed.\r\n", len);
+    }
+
+    block_transfer_receive(m_block_buffer, sizeof(m_block_buffer), block_received_handler);
 }
+#endif
 
 
-static void received_callback(mqttsn_event_t * p_event)
+static void block_received_handler(uint32_t err_code, uint32_t len)
 {
-        char my_string[MESSAGE_LENGTH+1];
-        NRF_LOG_INFO("MQTT-SN event: Content to subscribed topic received.\r\n");
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Block transfer failed. Error: 0x%x\r\n", err_code);
+    }
+    else
+    {
+        NRF_LOG_INFO("Block of %d bytes received.\r\n", len);
 
-        for(int i = 0; i < MESSAGE_LENGTH; i++)
+#if APP_BLOCK_ECHO
+        // The buffer is sent from; it is provided for receiving again when the echo has finished.
+        err_code = block_transfer_send(m_block_buffer, len, block_sent_handler);
+        if (err_code == NRF_SUCCESS)
         {
-            my_string[i] = p_event->event_data.published.p_payload[i];
+            return;
         }
-        my_string[MESSAGE_LENGTH] = 0; 
-        NRF_LOG_INFO("message: %s", my_string);
+
+        NRF_LOG_WARNING("Block could not be echoed. Error: 0x%x\r\n", err_code);
+#endif
+    }
+
+    block_transfer_receive(m_block_buffer, sizeof(m_block_buffer), block_received_handler);
 }
 
 
+#if APP_SAMPLER
+/**@brief Wakes up the Thread stack task to queue a block of samples. */
+static void sampler_ready_handler(void)
+{
+    BaseType_t var = xTaskNotifyGive(m_app.thread_stack_task);
+    UNUSED_VARIABLE(var);
+}
+#endif
+
+
 /**@brief Processes retransmission limit reached event. */
 static void timeout_callback(mqttsn_event_t * p_event)
 {
@@ -393,21 +616,22 @@ static void searchgw_timeout_callback(mqttsn_event_t * p_event)
 /**@brief Function for handling MQTT-SN events. */
 void mqttsn_evt_handler(mqttsn_client_t * p_client, mqttsn_event_t * p_event)
 {
+    latency_trace_evt_handle(p_event);
+
+    bool consumed = block_transfer_evt_handle(p_event);
+
     switch(p_event->event_id)
     {
         case MQTTSN_EVENT_GATEWAY_FOUND:
             NRF_LOG_INFO("MQTT-SN event: Client has found an active gateway.\r\n");
-            gateway_info_callback(p_event);
             break;
 
         case MQTTSN_EVENT_CONNECTED:
             NRF_LOG_INFO("MQTT-SN event: Client connected.\r\n");
-            connected_callback();
             break;
 
         case MQTTSN_EVENT_DISCONNECT_PERMIT:
             NRF_LOG_INFO("MQTT-SN event: Client disconnected.\r\n");
-            disconnected_callback();
             break;
 
         case MQTTSN_EVENT_REGISTERED:
@@ -416,7 +640,7 @@ void mqttsn_evt_handler(mqttsn_client_t * p_client, mqttsn_event_t * p_event)
             break;
 
         case MQTTSN_EVENT_PUBLISHED:
-            NRF_LOG_INFO("MQTT-SN event: Client has successfully published content.\r\n");
+            APP_LOG_INFO_LIMITED("MQTT-SN event: Client has successfully published content.\r\n");
             break;
 
         case MQTTSN_EVENT_SUBSCRIBED:
@@ -429,8 +653,11 @@ void mqttsn_evt_handler(mqttsn_client_t * p_client, mqttsn_event_t * p_event)
             break;
 
         case MQTTSN_EVENT_RECEIVED:
-            NRF_LOG_INFO("MQTT-SN event: Client received content.\r\n");
-            received_callback(p_event);
+            APP_LOG_INFO_LIMITED("MQTT-SN event: Client received content.\r\n");
+            if (!consumed)
+            {
+                received_callback(p_event);
+            }
             break;
 
         case MQTTSN_EVENT_TIMEOUT:
@@ -441,33 +668,13 @@ void mqttsn_evt_handler(mqttsn_client_t * p_client, mqttsn_event_t * p_event)
         case MQTTSN_EVENT_SEARCHGW_TIMEOUT:
             NRF_LOG_INFO("MQTT-SN event: Gateway discovery procedure has finished.\r\n");
             searchgw_timeout_callback(p_event);
-
-            // topic registered
-
-                uint32_t err_code;
-
-            if (mqttsn_client_state_get(&m_client) == MQTTSN_CLIENT_CONNECTED)
-            {
-                err_code = mqttsn_client_disconnect(&m_client);
-                if (err_code != NRF_SUCCESS)
-                {
-                    NRF_LOG_INFO("DISCONNECT message could not be sent. Error: 0x%x\r\n", err_code);
-                }
-            }
-            else
-            {
-                err_code = mqttsn_client_connect(&m_client, &m_gateway_addr, m_gateway_id, &m_connect_opt);
-                if (err_code != NRF_SUCCESS)
-                {
-                    NRF_LOG_ERROR("CONNECT message could not be sent. Error: 0x%x\r\n", err_code);
-                }
-            }
-
             break;
 
         default:
             break;
     }
+
+    mqttsn_session_evt_handle(p_event);
 }
 
 
@@ -494,8 +701,15 @@ static void thread_instance_init(void)
 {
     thread_configuration_t thread_configuration =
     {
-        .role              = RX_ON_WHEN_IDLE,
-        .autocommissioning = true,
+#if APP_SLEEPY_END_DEVICE
+        .role                  = RX_OFF_WHEN_IDLE,
+        .autocommissioning     = true,
+        .poll_period           = POLL_CONTROL_FAST_MS,
+        .default_child_timeout = POLL_CONTROL_CHILD_TIMEOUT,
+#else
+        .role                  = RX_ON_WHEN_IDLE,
+        .autocommissioning     = true,
+#endif
     };
 
     thread_init(&thread_configuration);
@@ -513,6 +727,8 @@ static void log_init(void)
     APP_ERROR_CHECK(err_code);
 
     NRF_LOG_DEFAULT_BACKENDS_INIT();
+
+    app_log_init();
 }
 
 
@@ -531,7 +747,9 @@ static void clock_init(void)
 /**@brief Task for handling the logger.
  *
  * @details This task is responsible for processing log entries if logs are deferred.
- *          Task flushes all log entries and suspends. It is resumed by idle task hook.
+ *          Task processes all log entries and waits until the idle task hook notifies it of new ones.
+ *          Entries of SDK modules and, in binary mode, all NRF_LOG entries are not reported by the
+ *          hook, so the wait is bounded.
  *
  * @param[in]   arg   Pointer used for passing some arbitrary information (context) from the
  *                    osThreadCreate() call to the task.
@@ -542,10 +760,9 @@ static void logger_task(void * arg)
 
     while (1)
     {
-        NRF_LOG_FLUSH();
+        app_log_drain();
 
-        // Suspend logger task.
-        vTaskSuspend(NULL);
+        UNUSED_VARIABLE(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_LOG_DRAIN_INTERVAL_MS)));
     }
 }
 #endif //NRF_LOG_ENABLED
@@ -559,7 +776,11 @@ static void logger_task(void * arg)
 
 void vApplicationIdleHook(void) {
 #if NRF_LOG_ENABLED
-    // vTaskResume(m_logger_thread);
+    // Entries are processed only when no other task has work to do.
+    if ((m_app.logger_task != NULL) && app_log_pending_take())
+    {
+        UNUSED_VARIABLE(xTaskNotifyGive(m_app.logger_task));
+    }
 #endif
 }
 
@@ -574,15 +795,102 @@ void vApplicationIdleHook(void) {
 
 static void mqttsn_init(void)
 {
-    uint32_t err_code = mqttsn_client_init(&m_client,
-                                           MQTTSN_DEFAULT_CLIENT_PORT,
-                                           mqttsn_evt_handler,
-                                           thread_ot_instance_get());
+    connect_opt_init();
+
+    mqttsn_session_init_t session_init =
+    {
+        .p_client        = &m_client,
+        .p_instance      = thread_ot_instance_get(),
+        .evt_handler     = mqttsn_evt_handler,
+        .p_connect_opt   = &m_connect_opt,
+        .p_pub_topics    = m_pub_topics,
+        .pub_topic_count = ARRAY_SIZE(m_pub_topics),
+        .p_sub_topics    = m_sub_topics,
+        .sub_topic_count = ARRAY_SIZE(m_sub_topics),
+        .state_handler   = session_state_handler,
+        .idle_handler    = publish_pipeline_is_empty,
+    };
+
+    mqttsn_keepalive_init(&m_client);
+
+    uint32_t err_code = mqttsn_session_init(&session_init);
+    APP_ERROR_CHECK(err_code);
+
+    publish_pipeline_init(&m_client, m_pub_topics, ARRAY_SIZE(m_pub_topics));
+
+    err_code = publish_filter_add(&m_pub_topics[0],
+                                  APP_PUBLISH_DEADBAND,
+                                  APP_PUBLISH_HEARTBEAT_MS,
+                                  button_heartbeat_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // With the fast path, the topic is predefined and the client cannot publish chunks to it.
+    err_code = block_transfer_init(&m_client, &m_pub_topics[0], &m_sub_topics[0]);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Block transfer disabled. Error: 0x%x\r\n", err_code);
+    }
+    block_transfer_receive(m_block_buffer, sizeof(m_block_buffer), block_received_handler);
+
+    err_code = mqttsn_fastpath_init(thread_ot_instance_get());
     APP_ERROR_CHECK(err_code);
 
+#if APP_LOCAL_CONTROL
+    err_code = mqttsn_fastpath_local_listen(local_command_handler);
+    APP_ERROR_CHECK(err_code);
+#endif
+
+#if APP_SAMPLER
+    sampler_init_t sampler_config =
+    {
+        .p_topic       = &m_pub_topics[1],
+        .period_ms     = APP_SAMPLER_PERIOD_MS,
+        .source        = sampler_source_simulated,
+        .ready_handler = sampler_ready_handler,
+    };
+
+#if APP_SAMPLER_WINDOW
+    err_code = publish_aggregator_add(&m_pub_topics[1], APP_SAMPLER_WINDOW, PUBLISH_AGGREGATOR_STAT_ALL);
+    APP_ERROR_CHECK(err_code);
+#endif
+
+    err_code = sampler_init(&sampler_config);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = sampler_start();
+    APP_ERROR_CHECK(err_code);
+#endif
+
     NRF_LOG_INFO("MQTTS inited, error code: %d", err_code);
+}
 
-    connect_opt_init();
+
+/**@brief Runs the timers of the application modules.
+ *
+ * @return FreeRTOS ticks until the earliest pending deadline.
+ */
+static TickType_t app_process(void)
+{
+    uint32_t timeout_ms = mqttsn_session_process();
+
+    timeout_ms = MIN(timeout_ms, mqttsn_keepalive_process());
+
+    timeout_ms = MIN(timeout_ms, sampler_process());
+
+    // Heartbeats are queued before the backlog is published.
+    timeout_ms = MIN(timeout_ms, publish_filter_process());
+
+    timeout_ms = MIN(timeout_ms, publish_pipeline_process());
+
+    timeout_ms = MIN(timeout_ms, mqttsn_fastpath_process());
+
+    timeout_ms = MIN(timeout_ms, block_transfer_process());
+
+    timeout_ms = MIN(timeout_ms, poll_control_process());
+
+    timeout_ms = MIN(timeout_ms, app_metrics_process());
+
+    return (timeout_ms == APP_CLOCK_NO_DEADLINE) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
 }
 
 static void scheduler_init(void)
@@ -602,27 +910,26 @@ static void thread_stack_task(void * arg)
 
     
     mqttsn_init();
+    app_metrics_init();
+#if APP_SLEEPY_END_DEVICE
+    poll_control_init(thread_ot_instance_get());
+#endif
+    mqttsn_session_start();
 
-    uint32_t err_code = mqttsn_client_search_gateway(&m_client, SEARCH_GATEWAY_TIMEOUT);
-    if (err_code != NRF_SUCCESS)
-    {
-        NRF_LOG_INFO("SEARCH GATEWAY message could not be sent. Error: 0x%x\r\n", err_code);
-    }else{
-        NRF_LOG_INFO("Search gateway message sendt");
-    }
+    // The pin handler notifies this task and posts to the modules above, so presses are only
+    // sensed once both exist.
+    nrf_drv_gpiote_in_event_enable(PIN_IN, true);
 
     while (1)
     {   
 
         thread_process();
         app_sched_execute();
-        if (NRF_LOG_PROCESS() == false)
-        {
-            thread_sleep();
-        }
+        TickType_t timeout = app_process();
 
-        
-        UNUSED_VARIABLE(ulTaskNotifyTake(pdTRUE, portMAX_DELAY));
+        // Log entries are processed by the logger task.
+        // Low power mode is entered by the FreeRTOS tickless idle while the task is blocked.
+        UNUSED_VARIABLE(ulTaskNotifyTake(pdTRUE, timeout));
     }
 }
 
@@ -651,7 +958,7 @@ int main(void)
       
 
     // Start execution.
-    if (pdPASS != xTaskCreate(logger_task, "LOG", LOG_TASK_STACK_SIZE, NULL, 1, &m_app.logger_task))
+    if (pdPASS != xTaskCreate(logger_task, "LOG", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY, &m_app.logger_task))
     {
         APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
     }
@@ -70,23 +70,24 @@
 #endif
 
 
- #define NRF_LOG_ENABLED 1
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include "app_scheduler.h"
+#include "app_util_platform.h"
 
 #include "FreeRTOS.h"
 #include "nrf_drv_clock.h"
 #include "task.h"
 
 #define NRF_LOG_MODULE_NAME APP
-#include "nrf_log.h"
+#include "app_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 NRF_LOG_MODULE_REGISTER();
 
 #include "mqttsn_client.h"
+#include "telemetry_codec.h"
 
 #include "app_timer.h"
 #include "bsp_thread.h"
@@ -171,22 +172,39 @@ static mqttsn_topic_t       m_topic_sub        =
 };
 
 
+#define TELEMETRY_CHANNELS 1                                   /**< Channels of the published sample: the button counter. */
+
+static telemetry_codec_encoder_t m_telemetry_encoder;          /**< Encoder of published samples. */
+static telemetry_codec_decoder_t m_telemetry_decoder;          /**< Decoder of received samples. */
+
+
 /*
     Button interrupt
 */
 int i= 0;
-uint8_t tx = 41;
+uint32_t tx = 41;
 void in_pin_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
 {
+    int32_t  values[TELEMETRY_CHANNELS];
+    uint8_t  message[TELEMETRY_CODEC_SIZE_MAX(TELEMETRY_CHANNELS)];
+    uint16_t len = sizeof(message);
 
     nrf_drv_gpiote_out_toggle(PIN_OUT);
     NRF_LOG_INFO("interrupt flag high %d", i++);
     tx++;
-    uint32_t ec = mqttsn_client_publish(&m_client, m_topic_pub.topic_id, &tx, 1, &m_msg_id_pub);
+
+    values[0] = (int32_t)tx;
+    UNUSED_RETURN_VALUE(telemetry_codec_encode(&m_telemetry_encoder, values, message, &len));
+
+    uint32_t ec = mqttsn_client_publish(&m_client, m_topic_pub.topic_id, message, len, &m_msg_id_pub);
     if (ec != NRF_SUCCESS)
     {
         NRF_LOG_ERROR("PUBLISH message could not be sent. Error code: 0x%x\r\n", ec)
     }
+    else
+    {
+        telemetry_codec_sent(&m_telemetry_encoder, m_msg_id_pub);
+    }
 }
 /**
  * @brief Function for configuring: PIN_IN pin for input, PIN_OUT pin for output,
@@ -334,6 +352,11 @@ static void connected_callback(void)
 {
     light_on();
 
+    // The subscriber may have missed samples while the session was down.
+    CRITICAL_REGION_ENTER();
+    telemetry_codec_keyframe_request(&m_telemetry_encoder);
+    CRITICAL_REGION_EXIT();
+
     uint32_t err_code = mqttsn_client_topic_register(&m_client,
                                                      m_topic_pub.p_topic_name,
                                                      strlen(m_topic_pub_name),
@@ -368,15 +391,21 @@ static void regack_callback(mqttsn_event_t * p_event)
 
 static void received_callback(mqttsn_event_t * p_event)
 {
-        char my_string[MESSAGE_LENGTH+1];
+        int32_t  values[TELEMETRY_CHANNELS];
+        uint32_t err_code = telemetry_codec_decode(&m_telemetry_decoder,
+                                                   p_event->event_data.published.p_payload,
+                                                   p_event->event_data.published.packet.len,
+                                                   values);
+
         NRF_LOG_INFO("MQTT-SN event: Content to subscribed topic received.\r\n");
 
-        for(int i = 0; i < MESSAGE_LENGTH; i++)
+        if (err_code != NRF_SUCCESS)
         {
-            my_string[i] = p_event->event_data.published.p_payload[i];
+            NRF_LOG_WARNING("Sample could not be decoded. Error code: 0x%x\r\n", err_code);
+            return;
         }
-        my_string[MESSAGE_LENGTH] = 0; 
-        NRF_LOG_INFO("message: %s", my_string);
+
+        NRF_LOG_INFO("counter: %d", values[0]);
 }
 
 
@@ -423,6 +452,9 @@ void mqttsn_evt_handler(mqttsn_client_t * p_client, mqttsn_event_t * p_event)
 
         case MQTTSN_EVENT_PUBLISHED:
             NRF_LOG_INFO("MQTT-SN event: Client has successfully published content.\r\n");
+            CRITICAL_REGION_ENTER();
+            telemetry_codec_acked(&m_telemetry_encoder, p_event->event_data.published.packet.msg_id);
+            CRITICAL_REGION_EXIT();
             break;
 
         case MQTTSN_EVENT_SUBSCRIBED:
@@ -519,6 +551,8 @@ static void log_init(void)
     APP_ERROR_CHECK(err_code);
 
     NRF_LOG_DEFAULT_BACKENDS_INIT();
+
+    app_log_init();
 }
 
 
@@ -604,6 +638,9 @@ static void mqttsn_init(void)
     NRF_LOG_INFO("MQTTS inited, error code: %d", err_code);
 
     connect_opt_init();
+
+    telemetry_codec_encoder_init(&m_telemetry_encoder, TELEMETRY_CHANNELS);
+    telemetry_codec_decoder_init(&m_telemetry_decoder, TELEMETRY_CHANNELS);
 }
 
 static void scheduler_init(void)
@@ -0,0 +1,434 @@
+/** @file
+ *
+ * @brief Connectionless QoS -1 publishing to the gateway and to a realm-local multicast group.
+ */
+
+#include "mqttsn_fastpath.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util_platform.h"
+#include "MQTTSNPacket.h"
+#include "mqttsn_gateways.h"
+#include "mqttsn_mtu.h"
+#include "mqttsn_session.h"
+#include "token_bucket.h"
+
+#include <openthread/ip6.h>
+#include <openthread/message.h>
+#include <openthread/thread.h>
+#include <openthread/udp.h>
+
+#define NRF_LOG_MODULE_NAME FASTPATH
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define QOS_M1                  3                                      /**< QoS -1 as encoded in the PUBLISH flags. */
+#define PUBLISH_HEADER_MAX      7                                      /**< PUBLISH header length with a one byte length field. */
+
+/**@brief Latest unsent sample of a topic, or a queued local command. */
+typedef struct
+{
+    bool                 pending;                                      /**< Whether the slot holds an unsent sample. */
+    bool                 local;                                        /**< Whether the sample goes to the realm-local multicast group. */
+    mqttsn_topics_type_t type;                                         /**< Topic type. */
+    uint16_t             topic_id;                                     /**< Predefined topic ID or short topic name. */
+    uint16_t             len;                                          /**< Payload length. */
+    uint8_t              payload[MQTTSN_FASTPATH_PAYLOAD_MAX];         /**< Payload. */
+} slot_t;
+
+static otInstance            * mp_instance;                            /**< OpenThread instance. */
+static otUdpSocket             m_socket;                               /**< Socket used for sending. */
+static otIp6Address            m_gateway_addr;                         /**< Configured gateway address. */
+static bool                    m_gateway_configured;                   /**< Whether a gateway address has been configured. */
+static otIp6Address            m_group_addr;                           /**< Realm-local multicast group. */
+static mqttsn_fastpath_local_handler_t m_local_handler;                /**< Handler of received realm-local publishes. */
+static slot_t                  m_slots[MQTTSN_FASTPATH_SLOT_COUNT];    /**< Mailbox. */
+static slot_t                  m_local_queue[MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE]; /**< Local commands in order of posting. */
+static uint8_t                 m_local_head;                           /**< Index of the oldest local command. */
+static uint8_t                 m_local_count;                          /**< Number of queued local commands. */
+static token_bucket_t          m_bucket;                               /**< Send rate limiter. */
+static mqttsn_fastpath_stats_t m_stats;                                /**< Fast path statistics. */
+static bool                    m_deferred;                             /**< Whether samples are held back for lack of a route. */
+
+
+static void udp_receive_handler(void * p_context, otMessage * p_message, const otMessageInfo * p_message_info)
+{
+    uint8_t          buf[PUBLISH_HEADER_MAX + MQTTSN_FASTPATH_PAYLOAD_MAX];
+    uint16_t         len = otMessageGetLength(p_message) - otMessageGetOffset(p_message);
+    unsigned char    dup;
+    unsigned char    retained;
+    unsigned short   msg_id;
+    int              qos;
+    int              payload_len;
+    unsigned char  * p_payload;
+    MQTTSN_topicid   topic;
+
+    UNUSED_PARAMETER(p_context);
+    UNUSED_PARAMETER(p_message_info);
+
+    // Only QoS -1 publishes of listeners arrive here; gateway traffic uses the client socket.
+    if ((m_local_handler == NULL) || (len > sizeof(buf)) ||
+        (otMessageRead(p_message, otMessageGetOffset(p_message), buf, len) != len) ||
+        (MQTTSNDeserialize_publish(&dup, &qos, &retained, &msg_id, &topic,
+                                   &p_payload, &payload_len, buf, len) != 1) ||
+        (topic.type == MQTTSN_TOPIC_TYPE_NORMAL))
+    {
+        m_stats.local_dropped++;
+        return;
+    }
+
+    m_stats.local_received++;
+
+    if (topic.type == MQTTSN_TOPIC_TYPE_SHORT)
+    {
+        m_local_handler(MQTTSN_TOPICS_TYPE_SHORT,
+                        ((uint16_t)(uint8_t)topic.data.short_name[0] << 8) | (uint8_t)topic.data.short_name[1],
+                        p_payload,
+                        payload_len);
+    }
+    else
+    {
+        m_local_handler(MQTTSN_TOPICS_TYPE_PREDEFINED, topic.data.id, p_payload, payload_len);
+    }
+}
+
+
+static void group_get(otMessageInfo * p_message_info)
+{
+    p_message_info->mPeerAddr = m_group_addr;
+    p_message_info->mPeerPort = MQTTSN_FASTPATH_LOCAL_PORT;
+}
+
+
+/**@brief Fills in the gateway address. Returns false if no gateway is known. */
+static bool gateway_get(otMessageInfo * p_message_info)
+{
+    if (m_gateway_configured)
+    {
+        p_message_info->mPeerAddr = m_gateway_addr;
+        p_message_info->mPeerPort = MQTTSN_FASTPATH_GATEWAY_PORT;
+        return true;
+    }
+
+    const mqttsn_remote_t * p_gateway = mqttsn_session_gateway_get();
+
+    if (p_gateway == NULL)
+    {
+        return false;
+    }
+
+    memcpy(p_message_info->mPeerAddr.mFields.m8, p_gateway->addr, sizeof(p_gateway->addr));
+    p_message_info->mPeerPort = (p_gateway->port_number != 0) ? p_gateway->port_number
+                                                              : MQTTSN_FASTPATH_GATEWAY_PORT;
+    return true;
+}
+
+
+static void slot_send(const slot_t * p_slot, const otMessageInfo * p_message_info)
+{
+    uint8_t        buf[PUBLISH_HEADER_MAX + MQTTSN_FASTPATH_PAYLOAD_MAX];
+    MQTTSN_topicid topic;
+
+    if (p_slot->type == MQTTSN_TOPICS_TYPE_SHORT)
+    {
+        topic.type               = MQTTSN_TOPIC_TYPE_SHORT;
+        topic.data.short_name[0] = (char)(p_slot->topic_id >> 8);
+        topic.data.short_name[1] = (char)(p_slot->topic_id);
+    }
+    else
+    {
+        topic.type    = MQTTSN_TOPIC_TYPE_PREDEFINED;
+        topic.data.id = p_slot->topic_id;
+    }
+
+    int len = MQTTSNSerialize_publish(buf, sizeof(buf), 0, QOS_M1, 0, 0, topic,
+                                      (unsigned char *)p_slot->payload, p_slot->len);
+    if (len <= 0)
+    {
+        m_stats.errors++;
+        return;
+    }
+
+    mqttsn_remote_t     peer;
+    mqttsn_mtu_budget_t budget;
+
+    memcpy(peer.addr, p_message_info->mPeerAddr.mFields.m8, sizeof(peer.addr));
+    mqttsn_mtu_budget_get(mp_instance, peer.addr, mqttsn_gateways_hops_get(&peer), &budget);
+
+    if (p_slot->len > budget.payload_max)
+    {
+        m_stats.fragmented++;
+    }
+
+    otMessage * p_message = otUdpNewMessage(mp_instance, NULL);
+
+    if (p_message == NULL)
+    {
+        m_stats.errors++;
+        return;
+    }
+
+    if ((otMessageAppend(p_message, buf, len) != OT_ERROR_NONE) ||
+        (otUdpSend(&m_socket, p_message, p_message_info) != OT_ERROR_NONE))
+    {
+        otMessageFree(p_message);
+        m_stats.errors++;
+        return;
+    }
+
+    if (p_slot->local)
+    {
+        m_stats.local_sent++;
+    }
+    else
+    {
+        m_stats.sent++;
+    }
+
+    m_stats.sent_bytes += len;
+}
+
+
+uint32_t mqttsn_fastpath_init(otInstance * p_instance)
+{
+    otSockAddr sock_addr;
+
+    mp_instance = p_instance;
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(m_slots, 0, sizeof(m_slots));
+    m_local_head  = 0;
+    m_local_count = 0;
+    m_deferred = false;
+    token_bucket_init(&m_bucket, MQTTSN_FASTPATH_RATE, MQTTSN_FASTPATH_BURST, app_clock_ms());
+
+    m_gateway_configured = (strlen(MQTTSN_FASTPATH_GATEWAY_ADDR) != 0) &&
+                           (otIp6AddressFromString(MQTTSN_FASTPATH_GATEWAY_ADDR, &m_gateway_addr) == OT_ERROR_NONE);
+    m_local_handler      = NULL;
+
+    if (otIp6AddressFromString(MQTTSN_FASTPATH_LOCAL_GROUP, &m_group_addr) != OT_ERROR_NONE)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    memset(&sock_addr, 0, sizeof(sock_addr));
+    sock_addr.mPort = MQTTSN_FASTPATH_LOCAL_PORT;
+
+    if ((otUdpOpen(mp_instance, &m_socket, udp_receive_handler, NULL) != OT_ERROR_NONE) ||
+        (otUdpBind(&m_socket, &sock_addr) != OT_ERROR_NONE))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Checks a topic and payload length of a sample to be posted. */
+static uint32_t post_check(const mqttsn_topics_entry_t * p_topic, uint16_t len)
+{
+    if (!mqttsn_topics_is_static(p_topic))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (len > MQTTSN_FASTPATH_PAYLOAD_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+static void slot_fill(slot_t                      * p_slot,
+                      const mqttsn_topics_entry_t * p_topic,
+                      bool                          local,
+                      const uint8_t               * p_payload,
+                      uint16_t                      len)
+{
+    p_slot->pending  = true;
+    p_slot->local    = local;
+    p_slot->type     = p_topic->type;
+    p_slot->topic_id = p_topic->topic.topic_id;
+    p_slot->len      = len;
+    memcpy(p_slot->payload, p_payload, len);
+}
+
+
+uint32_t mqttsn_fastpath_post(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len)
+{
+    uint32_t err_code = post_check(p_topic, len);
+    slot_t * p_slot   = NULL;
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    m_stats.posted++;
+
+    for (uint8_t i = 0; i < MQTTSN_FASTPATH_SLOT_COUNT; i++)
+    {
+        if (m_slots[i].pending && (m_slots[i].type == p_topic->type) &&
+            (m_slots[i].topic_id == p_topic->topic.topic_id))
+        {
+            p_slot = &m_slots[i];
+            m_stats.superseded++;
+            break;
+        }
+
+        if (!m_slots[i].pending && (p_slot == NULL))
+        {
+            p_slot = &m_slots[i];
+        }
+    }
+
+    if (p_slot != NULL)
+    {
+        slot_fill(p_slot, p_topic, false, p_payload, len);
+    }
+    else
+    {
+        m_stats.overflows++;
+        err_code = NRF_ERROR_NO_MEM;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+uint32_t mqttsn_fastpath_local_post(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len)
+{
+    uint32_t err_code = post_check(p_topic, len);
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    m_stats.posted++;
+
+    // Commands may change state, e.g. toggle an actuator, so none of them is superseded.
+    if (m_local_count < MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE)
+    {
+        slot_fill(&m_local_queue[(m_local_head + m_local_count) % MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE],
+                  p_topic, true, p_payload, len);
+        m_local_count++;
+    }
+    else
+    {
+        m_stats.overflows++;
+        err_code = NRF_ERROR_NO_MEM;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+uint32_t mqttsn_fastpath_local_listen(mqttsn_fastpath_local_handler_t handler)
+{
+    if (otIp6SubscribeMulticastAddress(mp_instance, &m_group_addr) != OT_ERROR_NONE)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    m_local_handler = handler;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t mqttsn_fastpath_process(void)
+{
+    otMessageInfo gateway_info;
+    otMessageInfo group_info;
+    slot_t        slot;
+    bool          deferred = false;
+
+    memset(&gateway_info, 0, sizeof(gateway_info));
+    memset(&group_info, 0, sizeof(group_info));
+    group_get(&group_info);
+
+    bool attached = (otThreadGetDeviceRole(mp_instance) >= OT_DEVICE_ROLE_CHILD);
+    bool gateway  = gateway_get(&gateway_info);
+
+    // Local commands are sent in order of posting; they need no gateway.
+    while (m_local_count > 0)
+    {
+        if (!attached)
+        {
+            deferred = true;
+            break;
+        }
+
+        if (!token_bucket_take(&m_bucket, app_clock_ms()))
+        {
+            m_stats.rate_limited++;
+            return token_bucket_wait_ms(&m_bucket);
+        }
+
+        CRITICAL_REGION_ENTER();
+        slot           = m_local_queue[m_local_head];
+        m_local_head   = (m_local_head + 1) % MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE;
+        m_local_count--;
+        CRITICAL_REGION_EXIT();
+
+        slot_send(&slot, &group_info);
+    }
+
+    for (uint8_t i = 0; i < MQTTSN_FASTPATH_SLOT_COUNT; i++)
+    {
+        if (!m_slots[i].pending)
+        {
+            continue;
+        }
+
+        if (!attached || !gateway)
+        {
+            // Keep the latest samples until a route to the destination exists.
+            deferred = true;
+            continue;
+        }
+
+        if (!token_bucket_take(&m_bucket, app_clock_ms()))
+        {
+            m_stats.rate_limited++;
+            return token_bucket_wait_ms(&m_bucket);
+        }
+
+        CRITICAL_REGION_ENTER();
+        slot                = m_slots[i];
+        m_slots[i].pending  = false;
+        CRITICAL_REGION_EXIT();
+
+        slot_send(&slot, &gateway_info);
+    }
+
+    if (deferred && !m_deferred)
+    {
+        m_stats.no_route++;
+    }
+
+    m_deferred = deferred;
+
+    // Held back samples need no polling: role and gateway changes are handled by the Thread stack
+    // task, which runs this function again afterwards.
+    return APP_CLOCK_NO_DEADLINE;
+}
+
+
+const mqttsn_fastpath_stats_t * mqttsn_fastpath_stats_get(void)
+{
+    return &m_stats;
+}
@@ -0,0 +1,147 @@
+/** @file
+ *
+ * @defgroup mqttsn_fastpath MQTT-SN QoS -1 fast path
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Connectionless QoS -1 publishing to the gateway and to a realm-local multicast group.
+ *
+ * @details QoS -1 PUBLISH messages with predefined or short topic IDs are sent directly over UDP
+ *          to a known gateway, without SEARCHGW, CONNECT or REGISTER, without PUBACK and without an
+ *          entry in the retransmission queue of the MQTT-SN client.
+ *
+ *          Samples are posted to a mailbox holding the latest value per topic; a newer sample
+ *          replaces an unsent older one, because freshness matters more than completeness for
+ *          these streams. The mailbox is flushed from the Thread stack task at a rate limited by
+ *          a token bucket.
+ *
+ *          Topics posted with @ref mqttsn_fastpath_local_post are sent to the realm-local
+ *          multicast group @ref MQTTSN_FASTPATH_LOCAL_GROUP instead. Nodes which listen to the
+ *          group receive them directly over the mesh, without the round trip through the gateway.
+ *          This suits local control traffic, e.g. one node switching a group of actuators. As
+ *          commands may change state, local publishes are queued in order of posting instead of
+ *          superseding each other, and sent before the mailbox.
+ */
+
+#ifndef MQTTSN_FASTPATH_H__
+#define MQTTSN_FASTPATH_H__
+
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include "mqttsn_topics.h"
+#include <openthread/instance.h>
+
+#ifndef MQTTSN_FASTPATH_GATEWAY_ADDR
+#define MQTTSN_FASTPATH_GATEWAY_ADDR    ""                             /**< Gateway IPv6 address. If empty, the gateway discovered by the session is used. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_GATEWAY_PORT
+#define MQTTSN_FASTPATH_GATEWAY_PORT    47193                          /**< Gateway UDP port. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_LOCAL_GROUP
+#define MQTTSN_FASTPATH_LOCAL_GROUP     "ff03::4d51"                   /**< Realm-local multicast group of local publishes. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_LOCAL_PORT
+#define MQTTSN_FASTPATH_LOCAL_PORT      47194                          /**< UDP port of the fast path socket, also the destination port of local publishes. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_SLOT_COUNT
+#define MQTTSN_FASTPATH_SLOT_COUNT      4                              /**< Number of topics with a pending sample. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE
+#define MQTTSN_FASTPATH_LOCAL_QUEUE_SIZE 4                             /**< Number of queued local publishes. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_PAYLOAD_MAX
+#define MQTTSN_FASTPATH_PAYLOAD_MAX     32                             /**< Maximum payload length of a sample. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_RATE
+#define MQTTSN_FASTPATH_RATE            20                             /**< Sustained send rate in messages per second. */
+#endif
+
+#ifndef MQTTSN_FASTPATH_BURST
+#define MQTTSN_FASTPATH_BURST           4                              /**< Messages which may be sent back to back. */
+#endif
+
+/**@brief Fast path statistics. */
+typedef struct
+{
+    uint32_t posted;                                                   /**< Samples posted to the mailbox. */
+    uint32_t superseded;                                               /**< Unsent samples replaced by a newer one. */
+    uint32_t overflows;                                                /**< Samples dropped because all slots or the local queue were taken. */
+    uint32_t sent;                                                     /**< Messages sent to the gateway. */
+    uint32_t sent_bytes;                                               /**< Bytes handed over to the UDP socket. */
+    uint32_t rate_limited;                                             /**< Flushes deferred by the rate limiter. */
+    uint32_t no_route;                                                 /**< Times samples were held back because the device was detached or the gateway unknown. */
+    uint32_t errors;                                                   /**< Messages lost due to buffer or send errors. */
+    uint32_t fragmented;                                               /**< Messages sent which did not fit into a single frame. */
+    uint32_t local_sent;                                               /**< Messages sent to the realm-local multicast group. */
+    uint32_t local_received;                                           /**< Local publishes received. */
+    uint32_t local_dropped;                                            /**< Received datagrams which were not valid local publishes. */
+} mqttsn_fastpath_stats_t;
+
+/**@brief Handler of received local publishes.
+ *
+ * @param[in] type       Topic type, predefined or short.
+ * @param[in] topic_id   Predefined topic ID or short topic name.
+ * @param[in] p_payload  Payload.
+ * @param[in] len        Payload length.
+ */
+typedef void (*mqttsn_fastpath_local_handler_t)(mqttsn_topics_type_t type,
+                                                uint16_t             topic_id,
+                                                const uint8_t      * p_payload,
+                                                uint16_t             len);
+
+/**@brief Opens the UDP socket of the fast path.
+ *
+ * @param[in] p_instance  OpenThread instance.
+ *
+ * @retval NRF_SUCCESS  If the fast path is ready.
+ */
+uint32_t mqttsn_fastpath_init(otInstance * p_instance);
+
+/**@brief Posts a sample for a predefined or short topic. May be called from interrupt context.
+ *
+ * @param[in] p_topic    Topic table entry.
+ * @param[in] p_payload  Sample payload.
+ * @param[in] len        Payload length.
+ *
+ * @retval NRF_SUCCESS               If the sample has been posted.
+ * @retval NRF_ERROR_INVALID_PARAM   If the topic has to be registered.
+ * @retval NRF_ERROR_INVALID_LENGTH  If the payload is too long.
+ * @retval NRF_ERROR_NO_MEM          If all slots hold samples of other topics.
+ */
+uint32_t mqttsn_fastpath_post(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len);
+
+/**@brief Posts a sample to the realm-local multicast group. May be called from interrupt context.
+ *
+ * @details Parameters and return values are the same as of @ref mqttsn_fastpath_post, except that
+ *          NRF_ERROR_NO_MEM is returned if the local queue is full.
+ */
+uint32_t mqttsn_fastpath_local_post(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len);
+
+/**@brief Joins the realm-local multicast group and passes received local publishes to a handler.
+ *
+ * @param[in] handler  Handler of received local publishes.
+ *
+ * @retval NRF_SUCCESS  If the group has been joined.
+ */
+uint32_t mqttsn_fastpath_local_listen(mqttsn_fastpath_local_handler_t handler);
+
+/**@brief Sends pending samples.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t mqttsn_fastpath_process(void);
+
+/**@brief Returns fast path statistics. */
+const mqttsn_fastpath_stats_t * mqttsn_fastpath_stats_get(void);
+
+#endif // MQTTSN_FASTPATH_H__
+
+/** @} */
@@ -0,0 +1,206 @@
+/** @file
+ *
+ * @brief Table of known MQTT-SN gateways ranked by round-trip time and hop count.
+ */
+
+#include "mqttsn_gateways.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "mqttsn_rtt.h"
+
+#include <openthread/thread.h>
+#include <openthread/thread_ftd.h>
+
+#define NRF_LOG_MODULE_NAME GATEWAYS
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RLOC_IID_PREFIX_LEN     6                                      /**< Length of the fixed part of a routing locator interface identifier. */
+#define RLOC16_ROUTER_ID_SHIFT  10                                     /**< Position of the router ID within an RLOC16. */
+#define RLOC16_CHILD_ID_MASK    0x01FF                                 /**< Child ID bits of an RLOC16. */
+
+static const uint8_t m_rloc_iid_prefix[RLOC_IID_PREFIX_LEN] = {0x00, 0x00, 0x00, 0xFF, 0xFE, 0x00};
+
+static otInstance            * mp_instance;                            /**< OpenThread instance. */
+static mqttsn_gateways_entry_t m_entries[MQTTSN_GATEWAYS_COUNT];       /**< Gateway table. */
+static bool                    m_in_use[MQTTSN_GATEWAYS_COUNT];        /**< Whether a table entry is in use. */
+
+
+uint8_t mqttsn_gateways_hops_get(const mqttsn_remote_t * p_addr)
+{
+    otRouterInfo info;
+
+    if (memcmp(&p_addr->addr[8], m_rloc_iid_prefix, RLOC_IID_PREFIX_LEN) != 0)
+    {
+        return MQTTSN_GATEWAYS_DEFAULT_HOPS;
+    }
+
+    uint16_t gateway_rloc16 = ((uint16_t)p_addr->addr[14] << 8) | p_addr->addr[15];
+    uint16_t own_rloc16     = otThreadGetRloc16(mp_instance);
+    uint8_t  router_id      = gateway_rloc16 >> RLOC16_ROUTER_ID_SHIFT;
+
+    if (gateway_rloc16 == own_rloc16)
+    {
+        return 0;
+    }
+
+    switch (otThreadGetDeviceRole(mp_instance))
+    {
+        case OT_DEVICE_ROLE_CHILD:
+            if ((otThreadGetParentInfo(mp_instance, &info) == OT_ERROR_NONE) &&
+                (info.mRloc16 == (gateway_rloc16 & ~RLOC16_CHILD_ID_MASK)))
+            {
+                return (gateway_rloc16 & RLOC16_CHILD_ID_MASK) ? 2 : 1;
+            }
+            break;
+
+        case OT_DEVICE_ROLE_ROUTER:
+        case OT_DEVICE_ROLE_LEADER:
+            if ((otThreadGetRouterInfo(mp_instance, router_id, &info) == OT_ERROR_NONE) &&
+                info.mAllocated)
+            {
+                // The path cost adds up link costs of 1 to 4, so it bounds the hop count from above.
+                return info.mPathCost + ((gateway_rloc16 & RLOC16_CHILD_ID_MASK) ? 1 : 0);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return MQTTSN_GATEWAYS_DEFAULT_HOPS;
+}
+
+
+static void cost_update(mqttsn_gateways_entry_t * p_entry)
+{
+    const mqttsn_rtt_stats_t * p_rtt = mqttsn_rtt_gateway_stats_get(p_entry->gateway_id);
+
+    // Gateways without samples are ranked by the initial timeout, i.e. after measured ones.
+    uint32_t rtt_ms = ((p_rtt != NULL) && (p_rtt->samples != 0)) ? p_rtt->srtt_ms
+                                                                 : MQTTSN_RTT_INITIAL_RTO_MS;
+
+    p_entry->hops    = mqttsn_gateways_hops_get(&p_entry->addr);
+    p_entry->cost_ms = rtt_ms + ((uint32_t)p_entry->hops * MQTTSN_GATEWAYS_HOP_COST_MS);
+}
+
+
+static mqttsn_gateways_entry_t * entry_find(uint8_t gateway_id)
+{
+    for (uint8_t i = 0; i < MQTTSN_GATEWAYS_COUNT; i++)
+    {
+        if (m_in_use[i] && (m_entries[i].gateway_id == gateway_id))
+        {
+            return &m_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+void mqttsn_gateways_init(otInstance * p_instance)
+{
+    mp_instance = p_instance;
+    memset(m_entries, 0, sizeof(m_entries));
+    memset(m_in_use, 0, sizeof(m_in_use));
+}
+
+
+void mqttsn_gateways_found(const mqttsn_remote_t * p_addr, uint8_t gateway_id)
+{
+    mqttsn_gateways_entry_t * p_entry = entry_find(gateway_id);
+
+    if (p_entry == NULL)
+    {
+        uint8_t worst = 0;
+
+        for (uint8_t i = 0; i < MQTTSN_GATEWAYS_COUNT; i++)
+        {
+            if (!m_in_use[i])
+            {
+                worst = i;
+                break;
+            }
+
+            if (m_entries[i].cost_ms > m_entries[worst].cost_ms)
+            {
+                worst = i;
+            }
+        }
+
+        // A full table gives up its most expensive gateway.
+        p_entry           = &m_entries[worst];
+        m_in_use[worst]   = true;
+        p_entry->failures = 0;
+
+        NRF_LOG_INFO("Gateway %d added.\r\n", gateway_id);
+    }
+
+    p_entry->addr       = *p_addr;
+    p_entry->gateway_id = gateway_id;
+    cost_update(p_entry);
+}
+
+
+void mqttsn_gateways_connected(uint8_t gateway_id)
+{
+    mqttsn_gateways_entry_t * p_entry = entry_find(gateway_id);
+
+    if (p_entry != NULL)
+    {
+        p_entry->failures = 0;
+    }
+}
+
+
+void mqttsn_gateways_failed(uint8_t gateway_id)
+{
+    mqttsn_gateways_entry_t * p_entry = entry_find(gateway_id);
+
+    if ((p_entry != NULL) && (++p_entry->failures >= MQTTSN_GATEWAYS_MAX_FAILURES))
+    {
+        m_in_use[p_entry - m_entries] = false;
+
+        NRF_LOG_INFO("Gateway %d removed.\r\n", gateway_id);
+    }
+}
+
+
+const mqttsn_gateways_entry_t * mqttsn_gateways_best_get(void)
+{
+    mqttsn_gateways_entry_t * p_best = NULL;
+
+    for (uint8_t i = 0; i < MQTTSN_GATEWAYS_COUNT; i++)
+    {
+        if (!m_in_use[i])
+        {
+            continue;
+        }
+
+        cost_update(&m_entries[i]);
+
+        // A gateway which has just failed is tried again only if nothing else is known.
+        if ((p_best == NULL) ||
+            (m_entries[i].failures < p_best->failures) ||
+            ((m_entries[i].failures == p_best->failures) && (m_entries[i].cost_ms < p_best->cost_ms)))
+        {
+            p_best = &m_entries[i];
+        }
+    }
+
+    return p_best;
+}
+
+
+const mqttsn_gateways_entry_t * mqttsn_gateways_entry_get(uint8_t index)
+{
+    if ((index >= MQTTSN_GATEWAYS_COUNT) || !m_in_use[index])
+    {
+        return NULL;
+    }
+
+    return &m_entries[index];
+}
@@ -0,0 +1,84 @@
+/** @file
+ *
+ * @defgroup mqttsn_gateways MQTT-SN gateway table
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Table of known MQTT-SN gateways ranked by round-trip time and hop count.
+ *
+ * @details Every GWINFO and ADVERTISE message adds or refreshes an entry. Gateways are ranked by
+ *          a cost made of the smoothed round-trip time measured by @ref mqttsn_rtt and of the
+ *          number of mesh hops to the gateway, so that the session can fail over to the
+ *          next-best gateway without a new discovery procedure.
+ *
+ *          The hop count is known only for gateways addressed by their routing locator. It is the
+ *          path cost from the routing table on routers and one hop to the parent on children.
+ *          Other gateways are assumed to be @ref MQTTSN_GATEWAYS_DEFAULT_HOPS away.
+ */
+
+#ifndef MQTTSN_GATEWAYS_H__
+#define MQTTSN_GATEWAYS_H__
+
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include <openthread/instance.h>
+
+#ifndef MQTTSN_GATEWAYS_COUNT
+#define MQTTSN_GATEWAYS_COUNT            4                             /**< Number of gateways in the table. */
+#endif
+
+#ifndef MQTTSN_GATEWAYS_HOP_COST_MS
+#define MQTTSN_GATEWAYS_HOP_COST_MS      30                            /**< Cost of a mesh hop expressed as round-trip time in [ms]. */
+#endif
+
+#ifndef MQTTSN_GATEWAYS_DEFAULT_HOPS
+#define MQTTSN_GATEWAYS_DEFAULT_HOPS     3                             /**< Hop count assumed when it cannot be determined. */
+#endif
+
+#ifndef MQTTSN_GATEWAYS_MAX_FAILURES
+#define MQTTSN_GATEWAYS_MAX_FAILURES     2                             /**< Consecutive failures after which a gateway is removed from the table. */
+#endif
+
+/**@brief Gateway table entry. */
+typedef struct
+{
+    mqttsn_remote_t addr;                                              /**< Gateway address. */
+    uint8_t         gateway_id;                                        /**< Gateway ID. */
+    uint8_t         hops;                                              /**< Mesh hops to the gateway. */
+    uint8_t         failures;                                          /**< Consecutive connection failures. */
+    uint32_t        cost_ms;                                           /**< Ranking cost, lower is better. */
+} mqttsn_gateways_entry_t;
+
+/**@brief Initializes the gateway table.
+ *
+ * @param[in] p_instance  OpenThread instance used to look up hop counts.
+ */
+void mqttsn_gateways_init(otInstance * p_instance);
+
+/**@brief Adds or refreshes a gateway announced by GWINFO or ADVERTISE. */
+void mqttsn_gateways_found(const mqttsn_remote_t * p_addr, uint8_t gateway_id);
+
+/**@brief Records a successful connection to a gateway. */
+void mqttsn_gateways_connected(uint8_t gateway_id);
+
+/**@brief Records a connection failure or the loss of a gateway. */
+void mqttsn_gateways_failed(uint8_t gateway_id);
+
+/**@brief Returns the gateway with the lowest cost, or NULL if the table is empty. */
+const mqttsn_gateways_entry_t * mqttsn_gateways_best_get(void);
+
+/**@brief Returns the number of mesh hops to a gateway, or @ref MQTTSN_GATEWAYS_DEFAULT_HOPS if unknown. */
+uint8_t mqttsn_gateways_hops_get(const mqttsn_remote_t * p_addr);
+
+/**@brief Returns a table entry for printing.
+ *
+ * @param[in] index  Table index.
+ *
+ * @return Pointer to the entry, or NULL if the entry is not in use.
+ */
+const mqttsn_gateways_entry_t * mqttsn_gateways_entry_get(uint8_t index);
+
+#endif // MQTTSN_GATEWAYS_H__
+
+/** @} */
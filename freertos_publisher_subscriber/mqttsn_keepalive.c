@@ -0,0 +1,206 @@
+/** @file
+ *
+ * @brief Keep-alive duration negotiation and traffic-aware liveness probing.
+ */
+
+#include "mqttsn_keepalive.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "mqttsn_rtt.h"
+#include "mqttsn_session.h"
+
+#define NRF_LOG_MODULE_NAME KEEPALIVE
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+/**@brief Interval of idleness after which a probe is sent in [ms]. */
+#define PROBE_INTERVAL_MS   MAX((MQTTSN_KEEPALIVE_SLA_S * 1000) - MQTTSN_KEEPALIVE_LOSS_MS, \
+                                MQTTSN_DEFAULT_RETRANSMISSION_TIME_IN_MS)
+
+static mqttsn_client_t        * mp_client;                             /**< MQTT-SN client used for probing. */
+static mqttsn_keepalive_stats_t m_stats;                               /**< Keep-alive statistics. */
+static bool                     m_active;                              /**< Whether an established session is supervised. */
+static bool                     m_probe_now;                           /**< Whether a probe has to be sent without waiting. */
+static bool                     m_survived;                            /**< Whether the session lasted a full keep-alive period. */
+static uint8_t                  m_stable;                              /**< Consecutive sessions that lasted a full keep-alive period. */
+static uint32_t                 m_started_at;                          /**< Time at which supervision started. */
+static uint32_t                 m_last_traffic;                        /**< Time of the last proof of liveness. */
+static uint32_t                 m_fixed_due;                           /**< Time of the next probe of a fixed-rate keep-alive. */
+static bool                     m_detached;                            /**< Whether the device detached from the Thread partition during the session. */
+
+
+static void step_down(void)
+{
+    m_stable = 0;
+
+    if (m_stats.duration_s > MQTTSN_KEEPALIVE_MIN_S)
+    {
+        m_stats.duration_s = MAX(m_stats.duration_s / 2, MQTTSN_KEEPALIVE_MIN_S);
+        m_stats.step_downs++;
+
+        NRF_LOG_INFO("Keep-alive duration decreased to %d s.\r\n", m_stats.duration_s);
+    }
+}
+
+
+static void step_up(void)
+{
+    m_stable = 0;
+
+    if (m_stats.duration_s < MQTTSN_KEEPALIVE_MAX_S)
+    {
+        m_stats.duration_s = MIN(m_stats.duration_s * 2, MQTTSN_KEEPALIVE_MAX_S);
+        m_stats.step_ups++;
+
+        NRF_LOG_INFO("Keep-alive duration increased to %d s.\r\n", m_stats.duration_s);
+    }
+}
+
+
+void mqttsn_keepalive_init(mqttsn_client_t * p_client)
+{
+    mp_client = p_client;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    m_stats.duration_s = MQTTSN_KEEPALIVE_MAX_S;
+    m_active           = false;
+    m_stable           = 0;
+}
+
+
+uint16_t mqttsn_keepalive_duration_get(void)
+{
+    return m_stats.duration_s;
+}
+
+
+void mqttsn_keepalive_connect_failed(void)
+{
+    step_down();
+}
+
+
+void mqttsn_keepalive_start(void)
+{
+    m_active       = true;
+    m_probe_now    = false;
+    m_survived     = false;
+    m_detached     = false;
+    m_started_at   = app_clock_ms();
+    m_last_traffic = m_started_at;
+    m_fixed_due    = m_started_at + PROBE_INTERVAL_MS;
+}
+
+
+void mqttsn_keepalive_stop(void)
+{
+    m_active = false;
+}
+
+
+void mqttsn_keepalive_lost(void)
+{
+    // The gateway may enforce a shorter keep-alive duration than the one announced. A session lost
+    // along with the Thread link says nothing about that.
+    if (m_active && !m_survived && !m_detached)
+    {
+        step_down();
+    }
+
+    m_active = false;
+}
+
+
+void mqttsn_keepalive_role_set(otDeviceRole role)
+{
+    if (m_active && (role < OT_DEVICE_ROLE_CHILD))
+    {
+        m_detached = true;
+    }
+}
+
+
+void mqttsn_keepalive_traffic(void)
+{
+    m_last_traffic = app_clock_ms();
+    m_probe_now    = false;
+}
+
+
+void mqttsn_keepalive_timeout(void)
+{
+    m_probe_now = m_active;
+}
+
+
+uint32_t mqttsn_keepalive_process(void)
+{
+    if (!m_active)
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint32_t now = app_clock_ms();
+    uint32_t survival_deadline = m_started_at + (m_stats.duration_s * 1000UL);
+
+    if (!m_survived && app_clock_expired(now, survival_deadline))
+    {
+        m_survived = true;
+
+        if (++m_stable >= MQTTSN_KEEPALIVE_STABLE_COUNT)
+        {
+            step_up();
+        }
+    }
+
+    if (!m_probe_now && !app_clock_expired(now, m_last_traffic + PROBE_INTERVAL_MS))
+    {
+        // A fixed-rate keep-alive would have probed by now, but traffic proved liveness.
+        while (app_clock_expired(now, m_fixed_due))
+        {
+            m_stats.suppressed++;
+            m_fixed_due += PROBE_INTERVAL_MS;
+        }
+    }
+    else
+    {
+        uint16_t msg_id;
+        uint32_t err_code = mqttsn_client_topic_register(mp_client,
+                                                         (const uint8_t *)MQTTSN_KEEPALIVE_PROBE_TOPIC,
+                                                         strlen(MQTTSN_KEEPALIVE_PROBE_TOPIC),
+                                                         &msg_id);
+        if (err_code == NRF_SUCCESS)
+        {
+            mqttsn_rtt_request_sent(MQTTSN_RTT_REQUEST_REGISTER, msg_id);
+            m_stats.probes++;
+        }
+        else
+        {
+            NRF_LOG_ERROR("Keep-alive probe could not be sent. Error: 0x%x\r\n", err_code);
+        }
+
+        // The next probe is due one interval later unless the gateway stays silent.
+        m_probe_now    = false;
+        m_last_traffic = now;
+        m_fixed_due    = now + PROBE_INTERVAL_MS;
+    }
+
+    uint32_t timeout_ms = app_clock_remaining(now, m_last_traffic + PROBE_INTERVAL_MS);
+
+    if (!m_survived)
+    {
+        timeout_ms = MIN(timeout_ms, app_clock_remaining(now, survival_deadline));
+    }
+
+    return timeout_ms;
+}
+
+
+const mqttsn_keepalive_stats_t * mqttsn_keepalive_stats_get(void)
+{
+    return &m_stats;
+}
@@ -0,0 +1,109 @@
+/** @file
+ *
+ * @defgroup mqttsn_keepalive MQTT-SN adaptive keep-alive
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Keep-alive duration negotiation and traffic-aware liveness probing.
+ *
+ * @details The keep-alive duration announced in CONNECT starts at @ref MQTTSN_KEEPALIVE_MAX_S,
+ *          the longest duration worth asking for. It is halved, down to
+ *          @ref MQTTSN_KEEPALIVE_MIN_S, whenever CONNECT fails or the gateway drops a session
+ *          that was idle for longer than the keep-alive duration. It is doubled again after
+ *          @ref MQTTSN_KEEPALIVE_STABLE_COUNT consecutive sessions that lasted through a full
+ *          keep-alive period.
+ *
+ *          A long keep-alive duration makes the client library ping rarely, so loss of the gateway
+ *          is detected by probes instead. A probe is a REGISTER of @ref MQTTSN_KEEPALIVE_PROBE_TOPIC,
+ *          which the gateway acknowledges idempotently. Any acknowledged PUBLISH, received message
+ *          or other acknowledgment proves liveness as well and postpones the probe, so probes are
+ *          only sent on otherwise idle sessions, as rarely as @ref MQTTSN_KEEPALIVE_SLA_S allows.
+ */
+
+#ifndef MQTTSN_KEEPALIVE_H__
+#define MQTTSN_KEEPALIVE_H__
+
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include <openthread/thread.h>
+
+#ifndef MQTTSN_KEEPALIVE_MIN_S
+#define MQTTSN_KEEPALIVE_MIN_S            MQTTSN_DEFAULT_ALIVE_DURATION /**< Shortest keep-alive duration in [s]. */
+#endif
+
+#ifndef MQTTSN_KEEPALIVE_MAX_S
+#define MQTTSN_KEEPALIVE_MAX_S            3840                         /**< Longest keep-alive duration in [s]. */
+#endif
+
+#ifndef MQTTSN_KEEPALIVE_STABLE_COUNT
+#define MQTTSN_KEEPALIVE_STABLE_COUNT     4                            /**< Sessions lasting a full keep-alive period before the duration is doubled. */
+#endif
+
+#ifndef MQTTSN_KEEPALIVE_SLA_S
+#define MQTTSN_KEEPALIVE_SLA_S            300                          /**< Maximum time to detect the loss of the gateway in [s]. */
+#endif
+
+#ifndef MQTTSN_KEEPALIVE_PROBE_TOPIC
+#define MQTTSN_KEEPALIVE_PROBE_TOPIC      "ka"                         /**< Topic name registered as a liveness probe. */
+#endif
+
+#ifndef MQTTSN_KEEPALIVE_LOSS_MS
+#define MQTTSN_KEEPALIVE_LOSS_MS          (MQTTSN_SESSION_TIMEOUT_THRESHOLD *                     \
+                                           MQTTSN_DEFAULT_RETRANSMISSION_TIME_IN_MS *              \
+                                           (MQTTSN_DEFAULT_RETRANSMISSION_CNT + 1))              /**< Time from the first unanswered probe until the session is considered lost in [ms]. */
+#endif
+
+/**@brief Keep-alive statistics. */
+typedef struct
+{
+    uint16_t duration_s;                                               /**< Keep-alive duration used for the next CONNECT. */
+    uint32_t step_downs;                                               /**< Number of times the duration was shortened. */
+    uint32_t step_ups;                                                 /**< Number of times the duration was lengthened. */
+    uint32_t probes;                                                   /**< Probes sent. */
+    uint32_t suppressed;                                               /**< Probes of a fixed-rate keep-alive made unnecessary by traffic. */
+} mqttsn_keepalive_stats_t;
+
+/**@brief Initializes the keep-alive module.
+ *
+ * @param[in] p_client  MQTT-SN client used for probing.
+ */
+void mqttsn_keepalive_init(mqttsn_client_t * p_client);
+
+/**@brief Returns the keep-alive duration to announce in the next CONNECT in [s]. */
+uint16_t mqttsn_keepalive_duration_get(void);
+
+/**@brief Notifies that CONNECT has not been accepted. */
+void mqttsn_keepalive_connect_failed(void);
+
+/**@brief Starts probing of an established session. */
+void mqttsn_keepalive_start(void);
+
+/**@brief Stops probing, e.g. when the client goes asleep. */
+void mqttsn_keepalive_stop(void);
+
+/**@brief Stops probing of a session that has been lost and adapts the keep-alive duration, unless
+ *        the device detached from the Thread partition during the session. */
+void mqttsn_keepalive_lost(void);
+
+/**@brief Updates the Thread device role, so that losses caused by the Thread link are told apart. */
+void mqttsn_keepalive_role_set(otDeviceRole role);
+
+/**@brief Notifies traffic which proves that the gateway is alive. */
+void mqttsn_keepalive_traffic(void);
+
+/**@brief Notifies a retransmission timeout. A new probe is sent immediately. */
+void mqttsn_keepalive_timeout(void);
+
+/**@brief Sends a probe if the session has been idle for too long.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t mqttsn_keepalive_process(void);
+
+/**@brief Returns keep-alive statistics. */
+const mqttsn_keepalive_stats_t * mqttsn_keepalive_stats_get(void);
+
+#endif // MQTTSN_KEEPALIVE_H__
+
+/** @} */
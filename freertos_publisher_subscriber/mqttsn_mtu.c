@@ -0,0 +1,84 @@
+/** @file
+ *
+ * @brief Largest MQTT-SN payload which fits into a single IEEE 802.15.4 frame.
+ */
+
+#include "mqttsn_mtu.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <openthread/ip6.h>
+
+#define FRAME_SIZE              127                                    /**< Maximum PHY payload, aMaxPHYPacketSize. */
+#define MAC_HEADER_SIZE         9                                      /**< Frame control, sequence, PAN ID and two short addresses. */
+#define MAC_SECURITY_SIZE       10                                     /**< Auxiliary security header with key ID mode 1 and a 32-bit MIC. */
+#define MAC_FCS_SIZE            2                                      /**< Frame check sequence. */
+#define MESH_HEADER_SIZE        5                                      /**< 6LoWPAN mesh header with short originator and final addresses. */
+#define IPHC_BASE_SIZE          2                                      /**< IPHC dispatch with elided traffic class, flow label and hop limit. */
+#define IPHC_NH_MPL_SIZE        8                                      /**< Compressed hop-by-hop header carrying the MPL option. */
+#define IID_SIZE                8                                      /**< Inline interface identifier. */
+#define ADDR_SIZE               16                                     /**< Inline IPv6 address. */
+#define MCAST_32_SIZE           4                                      /**< Multicast address in the ffXX::00XX:XXXX form. */
+#define UDP_NHC_SIZE            7                                      /**< UDP NHC dispatch, both ports inline and checksum. */
+#define PUBLISH_HEADER_SIZE     7                                      /**< Length, type, flags, topic ID and message ID. */
+
+static const uint8_t m_rloc_iid_prefix[] = {0x00, 0x00, 0x00, 0xFF, 0xFE, 0x00};
+
+
+/**@brief Returns the inline size of a destination address after IPHC compression. */
+static uint16_t dst_addr_size(otInstance * p_instance, const uint8_t * p_addr)
+{
+    if (p_addr[0] == 0xFF)
+    {
+        // Only the scope byte and the last three bytes are carried if the others are zero.
+        for (uint8_t i = 2; i < ADDR_SIZE - 3; i++)
+        {
+            if (p_addr[i] != 0)
+            {
+                return ADDR_SIZE;
+            }
+        }
+
+        return MCAST_32_SIZE;
+    }
+
+    const otIp6Address * p_ml_eid = otThreadGetMeshLocalEid(p_instance);
+
+    if ((p_ml_eid == NULL) || (memcmp(p_addr, p_ml_eid->mFields.m8, IID_SIZE) != 0))
+    {
+        return ADDR_SIZE;
+    }
+
+    // Routing locators are derived from the link-layer or mesh header address.
+    return (memcmp(&p_addr[IID_SIZE], m_rloc_iid_prefix, sizeof(m_rloc_iid_prefix)) == 0) ? 0 : IID_SIZE;
+}
+
+
+void mqttsn_mtu_budget_get(otInstance          * p_instance,
+                           const uint8_t       * p_addr,
+                           uint8_t               hops,
+                           mqttsn_mtu_budget_t * p_budget)
+{
+    bool     multicast = (p_addr[0] == 0xFF);
+    uint16_t overhead  = MAC_HEADER_SIZE + MAC_SECURITY_SIZE + MAC_FCS_SIZE;
+
+    if (!multicast && (hops > 1))
+    {
+        overhead += MESH_HEADER_SIZE;
+    }
+
+    // The source is an address with a compression context and a random interface identifier.
+    overhead += IPHC_BASE_SIZE + IID_SIZE + dst_addr_size(p_instance, p_addr);
+
+    if (multicast)
+    {
+        overhead += IPHC_NH_MPL_SIZE;
+    }
+
+    // MQTT-SN ports are outside of the compressible range.
+    overhead += UDP_NHC_SIZE + PUBLISH_HEADER_SIZE;
+
+    p_budget->overhead    = overhead;
+    p_budget->payload_max = FRAME_SIZE - overhead;
+}
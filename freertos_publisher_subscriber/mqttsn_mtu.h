@@ -0,0 +1,50 @@
+/** @file
+ *
+ * @defgroup mqttsn_mtu MQTT-SN frame budget
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Largest MQTT-SN payload which fits into a single IEEE 802.15.4 frame.
+ *
+ * @details A PUBLISH that does not fit into one 127-byte frame is split into 6LoWPAN fragments,
+ *          and the loss of any fragment loses the whole message. The budget of a frame is
+ *          reduced by the secured MAC header, the 6LoWPAN mesh header on multi-hop paths, the
+ *          IPHC compressed IPv6 header, the compressed UDP header and the PUBLISH header.
+ *
+ *          The IPv6 header size depends on the destination address. Addresses within the
+ *          mesh-local prefix are compressed against context 0; routing locators are derived
+ *          from the link-layer address. Other unicast destinations are assumed to be carried
+ *          inline, which may underestimate the budget for prefixes with a compression context.
+ *          Realm-local multicast adds the MPL option used by Thread to forward it.
+ */
+
+#ifndef MQTTSN_MTU_H__
+#define MQTTSN_MTU_H__
+
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include <openthread/instance.h>
+
+/**@brief Frame budget of a destination. */
+typedef struct
+{
+    uint16_t overhead;                                                 /**< Header bytes in front of the payload. */
+    uint16_t payload_max;                                              /**< Largest payload which fits into a single frame. */
+} mqttsn_mtu_budget_t;
+
+/**@brief Computes the frame budget of a PUBLISH message.
+ *
+ * @param[in]  p_instance  OpenThread instance.
+ * @param[in]  p_addr      Destination IPv6 address, 16 bytes.
+ * @param[in]  hops        Mesh hops to the destination.
+ * @param[out] p_budget    Frame budget.
+ */
+void mqttsn_mtu_budget_get(otInstance          * p_instance,
+                           const uint8_t       * p_addr,
+                           uint8_t               hops,
+                           mqttsn_mtu_budget_t * p_budget);
+
+#endif // MQTTSN_MTU_H__
+
+/** @} */
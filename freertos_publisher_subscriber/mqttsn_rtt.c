@@ -0,0 +1,281 @@
+/** @file
+ *
+ * @brief Per-gateway round-trip time estimation and adaptive retransmission timeout.
+ */
+
+#include "mqttsn_rtt.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util_platform.h"
+
+/**@brief Estimator state of a gateway. */
+typedef struct
+{
+    bool               in_use;                                         /**< Whether the entry is in use. */
+    uint32_t           srtt_x8;                                        /**< Smoothed round-trip time scaled by 8. */
+    uint32_t           rttvar_x4;                                      /**< Round-trip time variance scaled by 4. */
+    mqttsn_rtt_stats_t stats;                                          /**< Exported statistics. */
+} gateway_entry_t;
+
+/**@brief A request being timed. */
+typedef struct
+{
+    bool                 in_use;                                       /**< Whether the slot is in use. */
+    mqttsn_rtt_request_t request;                                      /**< Request type. */
+    uint16_t             msg_id;                                       /**< Message ID of the request. */
+    uint32_t             sent_at;                                      /**< Time at which the request has been sent. */
+} pending_entry_t;
+
+static gateway_entry_t   m_gateways[MQTTSN_RTT_GATEWAY_COUNT];         /**< Per-gateway estimator state. */
+static gateway_entry_t * mp_gateway;                                   /**< Selected gateway. */
+static pending_entry_t   m_pending[MQTTSN_RTT_PENDING_COUNT];          /**< Requests being timed. */
+
+
+static uint32_t rto_clamp(uint32_t rto_ms)
+{
+    if (rto_ms < MQTTSN_RTT_MIN_RTO_MS)
+    {
+        return MQTTSN_RTT_MIN_RTO_MS;
+    }
+
+    if (rto_ms > MQTTSN_RTT_MAX_RTO_MS)
+    {
+        return MQTTSN_RTT_MAX_RTO_MS;
+    }
+
+    return rto_ms;
+}
+
+
+/**@brief Updates the estimate with a valid sample (RFC 6298, section 2). */
+static void sample_add(gateway_entry_t * p_entry, uint32_t rtt_ms)
+{
+    mqttsn_rtt_stats_t * p_stats = &p_entry->stats;
+
+    if (p_stats->samples == 0)
+    {
+        p_entry->srtt_x8    = rtt_ms << 3;
+        p_entry->rttvar_x4  = rtt_ms << 1;
+        p_stats->min_rtt_ms = rtt_ms;
+        p_stats->max_rtt_ms = rtt_ms;
+    }
+    else
+    {
+        int32_t delta = (int32_t)rtt_ms - (int32_t)(p_entry->srtt_x8 >> 3);
+
+        // RTTVAR = 3/4 RTTVAR + 1/4 |delta|, with the decay taken from the previous value.
+        p_entry->srtt_x8   += delta;
+        p_entry->rttvar_x4  = p_entry->rttvar_x4 - (p_entry->rttvar_x4 >> 2)
+                            + (uint32_t)((delta < 0) ? -delta : delta);
+
+        p_stats->min_rtt_ms = MIN(p_stats->min_rtt_ms, rtt_ms);
+        p_stats->max_rtt_ms = MAX(p_stats->max_rtt_ms, rtt_ms);
+    }
+
+    p_stats->samples++;
+    p_stats->srtt_ms   = p_entry->srtt_x8 >> 3;
+    p_stats->rttvar_ms = p_entry->rttvar_x4 >> 2;
+    p_stats->rto_ms    = rto_clamp(p_stats->srtt_ms + MAX(MQTTSN_RTT_CLOCK_GRANULARITY_MS,
+                                                          p_entry->rttvar_x4));
+}
+
+
+void mqttsn_rtt_gateway_select(uint8_t gateway_id)
+{
+    gateway_entry_t * p_free   = NULL;
+    gateway_entry_t * p_oldest = &m_gateways[0];
+
+    for (uint8_t i = 0; i < MQTTSN_RTT_GATEWAY_COUNT; i++)
+    {
+        gateway_entry_t * p_entry = &m_gateways[i];
+
+        if (p_entry->in_use && (p_entry->stats.gateway_id == gateway_id))
+        {
+            mp_gateway = p_entry;
+            return;
+        }
+
+        if (!p_entry->in_use && (p_free == NULL))
+        {
+            p_free = p_entry;
+        }
+        else if (p_entry->stats.samples < p_oldest->stats.samples)
+        {
+            p_oldest = p_entry;
+        }
+    }
+
+    // Replace the entry with the least information if the table is full.
+    mp_gateway = (p_free != NULL) ? p_free : p_oldest;
+
+    memset(mp_gateway, 0, sizeof(*mp_gateway));
+    mp_gateway->in_use           = true;
+    mp_gateway->stats.gateway_id = gateway_id;
+    mp_gateway->stats.rto_ms     = MQTTSN_RTT_INITIAL_RTO_MS;
+
+    // Requests sent to the previous gateway cannot be matched anymore.
+    memset(m_pending, 0, sizeof(m_pending));
+}
+
+
+/**@brief Returns the slot for a request: its stale entry if the request is sent again, else a
+ *        free slot, or the oldest one if all requests are still outstanding.
+ *
+ * @details Must be called from a critical region.
+ */
+static pending_entry_t * pending_slot_get(mqttsn_rtt_request_t request, uint16_t msg_id)
+{
+    pending_entry_t * p_free   = NULL;
+    pending_entry_t * p_oldest = &m_pending[0];
+
+    for (uint8_t i = 0; i < MQTTSN_RTT_PENDING_COUNT; i++)
+    {
+        pending_entry_t * p_entry = &m_pending[i];
+
+        if (!p_entry->in_use)
+        {
+            p_free = (p_free != NULL) ? p_free : p_entry;
+            continue;
+        }
+
+        // Timing a retransmission from the first attempt would break Karn's rule.
+        if ((p_entry->request == request) && (p_entry->msg_id == msg_id))
+        {
+            return p_entry;
+        }
+
+        if ((int32_t)(p_entry->sent_at - p_oldest->sent_at) < 0)
+        {
+            p_oldest = p_entry;
+        }
+    }
+
+    return (p_free != NULL) ? p_free : p_oldest;
+}
+
+
+void mqttsn_rtt_request_sent(mqttsn_rtt_request_t request, uint16_t msg_id)
+{
+    uint32_t          now = app_clock_ms();
+    pending_entry_t * p_slot;
+
+    CRITICAL_REGION_ENTER();
+
+    p_slot = pending_slot_get(request, msg_id);
+
+    p_slot->in_use  = true;
+    p_slot->request = request;
+    p_slot->msg_id  = msg_id;
+    p_slot->sent_at = now;
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+void mqttsn_rtt_ack_received(mqttsn_rtt_request_t request, uint16_t msg_id)
+{
+    uint32_t          now    = app_clock_ms();
+    pending_entry_t * p_slot = NULL;
+    uint32_t          sent_at = 0;
+
+    CRITICAL_REGION_ENTER();
+
+    for (uint8_t i = 0; i < MQTTSN_RTT_PENDING_COUNT; i++)
+    {
+        pending_entry_t * p_entry = &m_pending[i];
+
+        if (!p_entry->in_use || (p_entry->request != request))
+        {
+            continue;
+        }
+
+        if ((msg_id != 0) && (p_entry->msg_id == msg_id))
+        {
+            p_slot = p_entry;
+            break;
+        }
+
+        // Acknowledgements without a message ID answer the latest request of their type.
+        if ((msg_id == 0) &&
+            ((p_slot == NULL) || ((int32_t)(p_entry->sent_at - p_slot->sent_at) > 0)))
+        {
+            p_slot = p_entry;
+        }
+    }
+
+    if (p_slot != NULL)
+    {
+        sent_at        = p_slot->sent_at;
+        p_slot->in_use = false;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    if ((p_slot == NULL) || (mp_gateway == NULL))
+    {
+        return;
+    }
+
+    uint32_t rtt_ms = now - sent_at;
+
+    if (rtt_ms >= MQTTSN_RTT_CLIENT_RETRANSMISSION_MS)
+    {
+        // Karn's rule: the acknowledgement may belong to a retransmission.
+        mp_gateway->stats.ambiguous++;
+        return;
+    }
+
+    sample_add(mp_gateway, rtt_ms);
+}
+
+
+void mqttsn_rtt_timeout(void)
+{
+    if (mp_gateway == NULL)
+    {
+        return;
+    }
+
+    mp_gateway->stats.timeouts++;
+    mp_gateway->stats.rto_ms = rto_clamp(mp_gateway->stats.rto_ms * 2);
+
+    // Acknowledgements of the failed requests may still arrive and would be timed from the
+    // first attempt.
+    CRITICAL_REGION_ENTER();
+    memset(m_pending, 0, sizeof(m_pending));
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint32_t mqttsn_rtt_rto_get(void)
+{
+    return (mp_gateway != NULL) ? mp_gateway->stats.rto_ms : MQTTSN_RTT_INITIAL_RTO_MS;
+}
+
+
+const mqttsn_rtt_stats_t * mqttsn_rtt_stats_get(uint8_t index)
+{
+    if ((index >= MQTTSN_RTT_GATEWAY_COUNT) || !m_gateways[index].in_use)
+    {
+        return NULL;
+    }
+
+    return &m_gateways[index].stats;
+}
+
+
+const mqttsn_rtt_stats_t * mqttsn_rtt_gateway_stats_get(uint8_t gateway_id)
+{
+    for (uint8_t i = 0; i < MQTTSN_RTT_GATEWAY_COUNT; i++)
+    {
+        if (m_gateways[i].in_use && (m_gateways[i].stats.gateway_id == gateway_id))
+        {
+            return &m_gateways[i].stats;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,119 @@
+/** @file
+ *
+ * @defgroup mqttsn_rtt MQTT-SN round-trip time estimator
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Per-gateway round-trip time estimation and adaptive retransmission timeout.
+ *
+ * @details Round-trip times are measured between sending CONNECT, REGISTER, SUBSCRIBE or
+ *          PUBLISH and receiving the matching acknowledgement. Smoothed RTT and RTT variance are
+ *          maintained as described in RFC 6298. Following Karn's rule, samples which may belong to
+ *          a retransmitted message are not used for estimation, and the timeout is doubled on
+ *          every retransmission failure until a valid sample has been taken.
+ *
+ * @note The MQTT-SN client retransmits with a fixed period of @ref MQTTSN_RTT_CLIENT_RETRANSMISSION_MS.
+ *       The adaptive timeout bounds the application-level supervision of session steps.
+ */
+
+#ifndef MQTTSN_RTT_H__
+#define MQTTSN_RTT_H__
+
+#include <stdint.h>
+
+#ifndef MQTTSN_RTT_GATEWAY_COUNT
+#define MQTTSN_RTT_GATEWAY_COUNT             4                         /**< Number of gateways for which estimates are kept. */
+#endif
+
+#ifndef MQTTSN_RTT_PENDING_COUNT
+#define MQTTSN_RTT_PENDING_COUNT             4                         /**< Number of requests timed concurrently. */
+#endif
+
+#ifndef MQTTSN_RTT_INITIAL_RTO_MS
+#define MQTTSN_RTT_INITIAL_RTO_MS            3000                      /**< Timeout used before the first sample has been taken in [ms]. */
+#endif
+
+#ifndef MQTTSN_RTT_MIN_RTO_MS
+#define MQTTSN_RTT_MIN_RTO_MS                500                       /**< Lower bound of the retransmission timeout in [ms]. */
+#endif
+
+#ifndef MQTTSN_RTT_MAX_RTO_MS
+#define MQTTSN_RTT_MAX_RTO_MS                (60 * 1000)               /**< Upper bound of the retransmission timeout in [ms]. */
+#endif
+
+#ifndef MQTTSN_RTT_CLOCK_GRANULARITY_MS
+#define MQTTSN_RTT_CLOCK_GRANULARITY_MS      10                        /**< Clock granularity term of the timeout calculation in [ms]. */
+#endif
+
+#ifndef MQTTSN_RTT_CLIENT_RETRANSMISSION_MS
+#define MQTTSN_RTT_CLIENT_RETRANSMISSION_MS  8000                      /**< Retransmission period of the MQTT-SN client in [ms]. Acknowledgements received later are ambiguous. */
+#endif
+
+/**@brief Types of timed requests. */
+typedef enum
+{
+    MQTTSN_RTT_REQUEST_CONNECT,
+    MQTTSN_RTT_REQUEST_REGISTER,
+    MQTTSN_RTT_REQUEST_SUBSCRIBE,
+    MQTTSN_RTT_REQUEST_PUBLISH,
+} mqttsn_rtt_request_t;
+
+/**@brief Round-trip time statistics of a gateway. */
+typedef struct
+{
+    uint8_t  gateway_id;                                               /**< Gateway ID. */
+    uint32_t srtt_ms;                                                  /**< Smoothed round-trip time. */
+    uint32_t rttvar_ms;                                                /**< Round-trip time variance. */
+    uint32_t rto_ms;                                                   /**< Current retransmission timeout. */
+    uint32_t min_rtt_ms;                                               /**< Shortest measured round-trip time. */
+    uint32_t max_rtt_ms;                                               /**< Longest measured round-trip time. */
+    uint32_t samples;                                                  /**< Samples used for estimation. */
+    uint32_t ambiguous;                                                /**< Samples discarded according to Karn's rule. */
+    uint32_t timeouts;                                                 /**< Retransmission failures. */
+} mqttsn_rtt_stats_t;
+
+/**@brief Selects the gateway to which following samples are attributed. */
+void mqttsn_rtt_gateway_select(uint8_t gateway_id);
+
+/**@brief Starts timing a request. Must be called from task context.
+ *
+ * @param[in] request  Request type.
+ * @param[in] msg_id   Message ID of the request, 0 for CONNECT. A request sent again with the same
+ *                     type and message ID restarts its timing.
+ */
+void mqttsn_rtt_request_sent(mqttsn_rtt_request_t request, uint16_t msg_id);
+
+/**@brief Stops timing a request and updates the estimate of the selected gateway.
+ *
+ * @param[in] request  Request type.
+ * @param[in] msg_id   Message ID of the acknowledgement, or 0 to match the newest request of the type.
+ */
+void mqttsn_rtt_ack_received(mqttsn_rtt_request_t request, uint16_t msg_id);
+
+/**@brief Reports a retransmission failure of the selected gateway, backs the timeout off and stops
+ *        timing all outstanding requests.
+ */
+void mqttsn_rtt_timeout(void);
+
+/**@brief Returns the retransmission timeout of the selected gateway in milliseconds. */
+uint32_t mqttsn_rtt_rto_get(void);
+
+/**@brief Returns statistics of a gateway table entry.
+ *
+ * @param[in] index  Table index.
+ *
+ * @return Pointer to statistics, or NULL if the entry is not in use.
+ */
+const mqttsn_rtt_stats_t * mqttsn_rtt_stats_get(uint8_t index);
+
+/**@brief Returns statistics of a gateway.
+ *
+ * @param[in] gateway_id  Gateway ID.
+ *
+ * @return Pointer to statistics, or NULL if the gateway has no estimator state.
+ */
+const mqttsn_rtt_stats_t * mqttsn_rtt_gateway_stats_get(uint8_t gateway_id);
+
+#endif // MQTTSN_RTT_H__
+
+/** @} */
@@ -0,0 +1,712 @@
+/** @file
+ *
+ * @brief MQTT-SN session state machine with reconnection backoff.
+ */
+
+#include "mqttsn_session.h"
+
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_error.h"
+#include "mqttsn_gateways.h"
+#include "mqttsn_keepalive.h"
+#include "mqttsn_rtt.h"
+
+#include <openthread/platform/random.h>
+
+#define NRF_LOG_MODULE_NAME SESSION
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+static mqttsn_session_init_t  m_init;                                  /**< Session configuration. */
+static mqttsn_session_state_t m_state = MQTTSN_SESSION_STATE_IDLE;     /**< Current session state. */
+static mqttsn_session_stats_t m_stats;                                 /**< Session statistics. */
+
+static mqttsn_remote_t        m_gateway_addr;                          /**< Address of the selected gateway. */
+static uint8_t                m_gateway_id;                            /**< ID of the selected gateway. */
+static bool                   m_gateway_selected;                      /**< Whether a gateway is selected. */
+static bool                   m_failover;                              /**< Whether the next attempt connects to a known gateway without searching. */
+
+static uint8_t                m_step;                                  /**< Index of the current REGISTER/SUBSCRIBE step. */
+static uint16_t               m_msg_id;                                /**< Message ID of the last session control message. */
+static uint8_t                m_timeouts;                              /**< Consecutive retransmission timeouts in ready state. */
+static uint8_t                m_backoff_exp;                           /**< Backoff exponent, reset when the session becomes ready. */
+
+static uint32_t               m_deadline;                              /**< Backoff expiry or step supervision deadline. */
+static bool                   m_deadline_armed;                        /**< Whether @ref m_deadline is valid. */
+
+static bool                   m_sleep_requested;                       /**< Whether the client has asked the gateway for sleep. */
+static uint32_t               m_asleep_at;                             /**< Time at which the client went asleep. */
+static mqttsn_connect_opt_t   m_wake_connect_opt;                      /**< Connect options used to return from the asleep state. */
+
+static uint32_t               m_lost_at;                               /**< Time at which the ready session was lost. */
+static bool                   m_recovering;                            /**< Whether the session is recovering from a loss. */
+
+
+static void deadline_arm(uint32_t delay_ms)
+{
+    m_deadline       = app_clock_ms() + delay_ms;
+    m_deadline_armed = true;
+}
+
+
+/**@brief Returns the supervision timeout of a CONNECT/REGISTER/SUBSCRIBE step.
+ *
+ * @details The timeout follows the measured round-trip time of the gateway, so that long mesh
+ *          paths are not cut off. It lasts at least until the client has retransmitted once and
+ *          the retransmission has had one timeout to be answered, so a single lost message does
+ *          not tear the client down.
+ */
+static uint32_t step_timeout_get(void)
+{
+    uint32_t rto_ms = mqttsn_rtt_rto_get();
+
+    return MIN(MQTTSN_SESSION_STEP_TIMEOUT_MS,
+               MAX(rto_ms * MQTTSN_SESSION_STEP_RTO_COUNT, MQTTSN_RTT_CLIENT_RETRANSMISSION_MS + rto_ms));
+}
+
+
+static void state_set(mqttsn_session_state_t state)
+{
+    if (m_state == state)
+    {
+        return;
+    }
+
+    m_state = state;
+    NRF_LOG_INFO("Session state: %s\r\n", mqttsn_session_state_name(state));
+
+    if (m_init.state_handler != NULL)
+    {
+        m_init.state_handler(state);
+    }
+}
+
+
+/**@brief Reinitializes the MQTT-SN client to drop any stale connection state. */
+static void client_reset(void)
+{
+    UNUSED_RETURN_VALUE(mqttsn_client_uninit(m_init.p_client));
+
+    uint32_t err_code = mqttsn_client_init(m_init.p_client,
+                                           MQTTSN_DEFAULT_CLIENT_PORT,
+                                           m_init.evt_handler,
+                                           m_init.p_instance);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Schedules the next connection attempt.
+ *
+ * @details The delay doubles with every failed attempt up to @ref MQTTSN_SESSION_BACKOFF_MAX_MS.
+ *          Half of the delay is fixed, the other half is random, so that nodes which lost the
+ *          same gateway at the same moment spread their reconnection attempts.
+ */
+static void backoff_start(void)
+{
+    if ((m_state == MQTTSN_SESSION_STATE_CONNECTING)  ||
+        (m_state == MQTTSN_SESSION_STATE_REGISTERING) ||
+        (m_state == MQTTSN_SESSION_STATE_READY)       ||
+        (m_state == MQTTSN_SESSION_STATE_ASLEEP)      ||
+        (m_state == MQTTSN_SESSION_STATE_WAKING))
+    {
+        mqttsn_gateways_failed(m_gateway_id);
+    }
+
+    // Another known gateway is tried after the shortest delay, without a new search.
+    m_failover = (mqttsn_gateways_best_get() != NULL);
+
+    uint32_t delay = MQTTSN_SESSION_BACKOFF_MIN_MS;
+
+    for (uint8_t i = 0; !m_failover && (i < m_backoff_exp) && (delay < MQTTSN_SESSION_BACKOFF_MAX_MS); i++)
+    {
+        delay *= 2;
+    }
+
+    if (delay >= MQTTSN_SESSION_BACKOFF_MAX_MS)
+    {
+        delay = MQTTSN_SESSION_BACKOFF_MAX_MS;
+    }
+    else if (!m_failover)
+    {
+        m_backoff_exp++;
+    }
+
+    delay = (delay / 2) + (otPlatRandomGet() % ((delay / 2) + 1));
+
+    m_stats.backoff_ms = delay;
+    deadline_arm(delay);
+    state_set(MQTTSN_SESSION_STATE_BACKING_OFF);
+
+    NRF_LOG_INFO("Next connection attempt in %d ms.\r\n", delay);
+}
+
+
+/**@brief Ends time accounting of the asleep state. */
+static void asleep_leave(void)
+{
+    if ((m_state == MQTTSN_SESSION_STATE_ASLEEP) || (m_state == MQTTSN_SESSION_STATE_WAKING))
+    {
+        m_stats.asleep_ms += app_clock_ms() - m_asleep_at;
+    }
+}
+
+
+static void session_lost(void)
+{
+    asleep_leave();
+    m_sleep_requested = false;
+
+    if (m_state == MQTTSN_SESSION_STATE_READY)
+    {
+        mqttsn_keepalive_lost();
+    }
+    else
+    {
+        mqttsn_keepalive_stop();
+    }
+
+    if ((m_state == MQTTSN_SESSION_STATE_READY)  ||
+        (m_state == MQTTSN_SESSION_STATE_ASLEEP) ||
+        (m_state == MQTTSN_SESSION_STATE_WAKING))
+    {
+        m_stats.losses++;
+        m_lost_at    = app_clock_ms();
+        m_recovering = true;
+    }
+
+    backoff_start();
+}
+
+
+/**@brief Restarts the idle period after which the session falls asleep. */
+static void idle_arm(void)
+{
+#if MQTTSN_SESSION_SLEEP_DURATION_S
+    if (!m_sleep_requested)
+    {
+        deadline_arm(MQTTSN_SESSION_SLEEP_IDLE_MS);
+    }
+#endif
+}
+
+
+static bool app_is_idle(void)
+{
+    return (m_init.idle_handler == NULL) || m_init.idle_handler();
+}
+
+
+/**@brief Asks the gateway to buffer messages while the client sleeps. */
+static void sleep_start(void)
+{
+    uint32_t err_code = mqttsn_client_sleep(m_init.p_client, MQTTSN_SESSION_SLEEP_DURATION_S);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("SLEEP message could not be sent. Error: 0x%x\r\n", err_code);
+        idle_arm();
+        return;
+    }
+
+    m_sleep_requested = true;
+    deadline_arm(step_timeout_get());
+}
+
+
+/**@brief Returns from the asleep state to publish queued samples.
+ *
+ * @details The session is not cleaned, so registrations and subscriptions remain valid and the
+ *          gateway delivers buffered messages in the same wake-up.
+ */
+static void wake_start(void)
+{
+    m_wake_connect_opt               = *m_init.p_connect_opt;
+    m_wake_connect_opt.clean_session = 0;
+
+    uint32_t err_code = mqttsn_client_connect(m_init.p_client,
+                                              &m_gateway_addr,
+                                              m_gateway_id,
+                                              &m_wake_connect_opt);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("CONNECT message could not be sent. Error: 0x%x\r\n", err_code);
+        session_lost();
+        return;
+    }
+
+    mqttsn_rtt_request_sent(MQTTSN_RTT_REQUEST_CONNECT, 0);
+    deadline_arm(step_timeout_get());
+    state_set(MQTTSN_SESSION_STATE_WAKING);
+}
+
+
+static void session_ready(void)
+{
+    mqttsn_gateways_connected(m_gateway_id);
+
+    m_deadline_armed = false;
+    m_backoff_exp    = 0;
+    m_timeouts       = 0;
+    m_stats.attempts = 0;
+
+    if (m_recovering)
+    {
+        uint32_t recovery_ms = app_clock_ms() - m_lost_at;
+
+        m_stats.recoveries++;
+        m_stats.last_recovery_ms   = recovery_ms;
+        m_stats.total_recovery_ms += recovery_ms;
+
+        if (recovery_ms > m_stats.max_recovery_ms)
+        {
+            m_stats.max_recovery_ms = recovery_ms;
+        }
+
+        m_recovering = false;
+    }
+
+    state_set(MQTTSN_SESSION_STATE_READY);
+    mqttsn_keepalive_start();
+    idle_arm();
+}
+
+
+static void search_start(void)
+{
+    m_stats.attempts++;
+    m_stats.attempts_total++;
+    m_gateway_selected = false;
+
+    uint32_t err_code = mqttsn_client_search_gateway(m_init.p_client, MQTTSN_SESSION_SEARCH_TIMEOUT);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("SEARCH GATEWAY message could not be sent. Error: 0x%x\r\n", err_code);
+        backoff_start();
+        return;
+    }
+
+    deadline_arm((MQTTSN_SESSION_SEARCH_TIMEOUT * 1000) + MQTTSN_SESSION_STEP_TIMEOUT_MS);
+    state_set(MQTTSN_SESSION_STATE_SEARCHING);
+}
+
+
+/**@brief Selects the best known gateway. Returns false if no gateway is known. */
+static bool gateway_pick(void)
+{
+    const mqttsn_gateways_entry_t * p_best = mqttsn_gateways_best_get();
+
+    if (p_best == NULL)
+    {
+        return false;
+    }
+
+    m_gateway_addr     = p_best->addr;
+    m_gateway_id       = p_best->gateway_id;
+    m_gateway_selected = true;
+
+    return true;
+}
+
+
+static void connect_start(void)
+{
+    mqttsn_rtt_gateway_select(m_gateway_id);
+    m_init.p_connect_opt->alive_duration = mqttsn_keepalive_duration_get();
+
+    uint32_t err_code = mqttsn_client_connect(m_init.p_client,
+                                              &m_gateway_addr,
+                                              m_gateway_id,
+                                              m_init.p_connect_opt);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("CONNECT message could not be sent. Error: 0x%x\r\n", err_code);
+        backoff_start();
+        return;
+    }
+
+    mqttsn_rtt_request_sent(MQTTSN_RTT_REQUEST_CONNECT, 0);
+    deadline_arm(step_timeout_get());
+    state_set(MQTTSN_SESSION_STATE_CONNECTING);
+}
+
+
+/**@brief Returns true if the current REGISTER/SUBSCRIBE step needs no message. */
+static bool step_is_static(void)
+{
+    if (m_step < m_init.pub_topic_count)
+    {
+        return mqttsn_topics_is_static(&m_init.p_pub_topics[m_step]);
+    }
+
+    if (m_step < m_init.pub_topic_count + m_init.sub_topic_count)
+    {
+        return m_init.p_sub_topics[m_step - m_init.pub_topic_count].type ==
+               MQTTSN_TOPICS_TYPE_PREDEFINED;
+    }
+
+    return false;
+}
+
+
+/**@brief Sends the next REGISTER or SUBSCRIBE message, one at a time. */
+static void registration_next(void)
+{
+    uint32_t                      err_code;
+    const mqttsn_topics_entry_t * p_entry;
+    mqttsn_rtt_request_t          request;
+    uint8_t                       short_name[2];
+
+    while (step_is_static())
+    {
+        m_step++;
+    }
+
+    if (m_step < m_init.pub_topic_count)
+    {
+        request  = MQTTSN_RTT_REQUEST_REGISTER;
+        p_entry  = &m_init.p_pub_topics[m_step];
+        err_code = mqttsn_client_topic_register(m_init.p_client,
+                                                p_entry->topic.p_topic_name,
+                                                strlen((const char *)p_entry->topic.p_topic_name),
+                                                &m_msg_id);
+    }
+    else if (m_step < m_init.pub_topic_count + m_init.sub_topic_count)
+    {
+        request = MQTTSN_RTT_REQUEST_SUBSCRIBE;
+        p_entry = &m_init.p_sub_topics[m_step - m_init.pub_topic_count];
+
+        if (p_entry->type == MQTTSN_TOPICS_TYPE_SHORT)
+        {
+            mqttsn_topics_short_name_get(p_entry, short_name);
+            err_code = mqttsn_client_subscribe(m_init.p_client, short_name, sizeof(short_name), &m_msg_id);
+        }
+        else
+        {
+            err_code = mqttsn_client_subscribe(m_init.p_client,
+                                               p_entry->topic.p_topic_name,
+                                               strlen((const char *)p_entry->topic.p_topic_name),
+                                               &m_msg_id);
+        }
+    }
+    else
+    {
+        session_ready();
+        return;
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("REGISTER/SUBSCRIBE message could not be sent. Error: 0x%x\r\n", err_code);
+        backoff_start();
+        return;
+    }
+
+    mqttsn_rtt_request_sent(request, m_msg_id);
+    deadline_arm(step_timeout_get());
+}
+
+
+uint32_t mqttsn_session_init(const mqttsn_session_init_t * p_init)
+{
+    m_init             = *p_init;
+    m_state            = MQTTSN_SESSION_STATE_IDLE;
+    m_sleep_requested  = false;
+    m_gateway_selected = false;
+    m_failover         = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    mqttsn_gateways_init(m_init.p_instance);
+
+    return mqttsn_client_init(m_init.p_client,
+                              MQTTSN_DEFAULT_CLIENT_PORT,
+                              m_init.evt_handler,
+                              m_init.p_instance);
+}
+
+
+void mqttsn_session_start(void)
+{
+    search_start();
+}
+
+
+void mqttsn_session_evt_handle(const mqttsn_event_t * p_event)
+{
+    switch (p_event->event_id)
+    {
+        case MQTTSN_EVENT_GATEWAY_FOUND:
+            mqttsn_gateways_found(p_event->event_data.connected.p_gateway_addr,
+                                  p_event->event_data.connected.gateway_id);
+            break;
+
+        case MQTTSN_EVENT_SEARCHGW_TIMEOUT:
+            if (m_state == MQTTSN_SESSION_STATE_SEARCHING)
+            {
+                if (gateway_pick())
+                {
+                    connect_start();
+                }
+                else
+                {
+                    backoff_start();
+                }
+            }
+            break;
+
+        case MQTTSN_EVENT_CONNECTED:
+            mqttsn_rtt_ack_received(MQTTSN_RTT_REQUEST_CONNECT, 0);
+
+            if (m_state == MQTTSN_SESSION_STATE_CONNECTING)
+            {
+                m_step = 0;
+                state_set(MQTTSN_SESSION_STATE_REGISTERING);
+                registration_next();
+            }
+            else if (m_state == MQTTSN_SESSION_STATE_WAKING)
+            {
+                asleep_leave();
+                m_stats.wakeups++;
+                m_timeouts = 0;
+                state_set(MQTTSN_SESSION_STATE_READY);
+                mqttsn_keepalive_start();
+                idle_arm();
+            }
+            break;
+
+        case MQTTSN_EVENT_REGISTERED:
+            mqttsn_rtt_ack_received(MQTTSN_RTT_REQUEST_REGISTER,
+                                    p_event->event_data.registered.packet.msg_id);
+            mqttsn_keepalive_traffic();
+
+            if ((m_state == MQTTSN_SESSION_STATE_REGISTERING) && (m_step < m_init.pub_topic_count))
+            {
+                m_init.p_pub_topics[m_step].topic.topic_id =
+                    p_event->event_data.registered.packet.topic.topic_id;
+                m_step++;
+                registration_next();
+            }
+            break;
+
+        case MQTTSN_EVENT_SUBSCRIBED:
+            mqttsn_rtt_ack_received(MQTTSN_RTT_REQUEST_SUBSCRIBE, 0);
+            mqttsn_keepalive_traffic();
+
+            if ((m_state == MQTTSN_SESSION_STATE_REGISTERING) && (m_step >= m_init.pub_topic_count))
+            {
+                m_step++;
+                registration_next();
+            }
+            break;
+
+        case MQTTSN_EVENT_PUBLISHED:
+            mqttsn_rtt_ack_received(MQTTSN_RTT_REQUEST_PUBLISH,
+                                    p_event->event_data.published.packet.msg_id);
+            m_timeouts = 0;
+            mqttsn_keepalive_traffic();
+
+            if (m_state == MQTTSN_SESSION_STATE_READY)
+            {
+                idle_arm();
+            }
+            break;
+
+        case MQTTSN_EVENT_RECEIVED:
+            mqttsn_keepalive_traffic();
+
+            if (m_state == MQTTSN_SESSION_STATE_READY)
+            {
+                idle_arm();
+            }
+            break;
+
+        case MQTTSN_EVENT_SLEEP_PERMIT:
+            if ((m_state == MQTTSN_SESSION_STATE_READY) && m_sleep_requested)
+            {
+                m_sleep_requested = false;
+                m_asleep_at       = app_clock_ms();
+                m_stats.sleeps++;
+                mqttsn_keepalive_stop();
+                deadline_arm(MQTTSN_SESSION_SLEEP_DURATION_S * 1000);
+                state_set(MQTTSN_SESSION_STATE_ASLEEP);
+            }
+            break;
+
+        case MQTTSN_EVENT_TIMEOUT:
+            mqttsn_rtt_timeout();
+
+            if ((m_state == MQTTSN_SESSION_STATE_CONNECTING) ||
+                (m_state == MQTTSN_SESSION_STATE_REGISTERING))
+            {
+                backoff_start();
+            }
+            else if (m_state == MQTTSN_SESSION_STATE_WAKING)
+            {
+                session_lost();
+            }
+            else if (((m_state == MQTTSN_SESSION_STATE_READY) || (m_state == MQTTSN_SESSION_STATE_ASLEEP)) &&
+                     (++m_timeouts >= MQTTSN_SESSION_TIMEOUT_THRESHOLD))
+            {
+                NRF_LOG_WARNING("Gateway lost after %d retransmission timeouts.\r\n", m_timeouts);
+                session_lost();
+            }
+            else if (m_state == MQTTSN_SESSION_STATE_READY)
+            {
+                // Verify the gateway right away instead of waiting for the next probe interval.
+                mqttsn_keepalive_timeout();
+            }
+            break;
+
+        case MQTTSN_EVENT_DISCONNECT_PERMIT:
+            if (m_state == MQTTSN_SESSION_STATE_CONNECTING)
+            {
+                // CONNECT rejected, possibly because of the announced keep-alive duration.
+                mqttsn_keepalive_connect_failed();
+            }
+
+            if ((m_state == MQTTSN_SESSION_STATE_CONNECTING)  ||
+                (m_state == MQTTSN_SESSION_STATE_REGISTERING) ||
+                (m_state == MQTTSN_SESSION_STATE_READY)       ||
+                (m_state == MQTTSN_SESSION_STATE_ASLEEP)      ||
+                (m_state == MQTTSN_SESSION_STATE_WAKING))
+            {
+                session_lost();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+uint32_t mqttsn_session_process(void)
+{
+    if (!m_deadline_armed)
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint32_t now = app_clock_ms();
+
+    if (!app_clock_expired(now, m_deadline))
+    {
+        return app_clock_remaining(now, m_deadline);
+    }
+
+    m_deadline_armed = false;
+
+    switch (m_state)
+    {
+        case MQTTSN_SESSION_STATE_BACKING_OFF:
+            client_reset();
+
+            if (m_failover && gateway_pick())
+            {
+                NRF_LOG_INFO("Failing over to gateway %d.\r\n", m_gateway_id);
+                m_stats.attempts++;
+                m_stats.attempts_total++;
+                m_stats.failovers++;
+                connect_start();
+            }
+            else
+            {
+                search_start();
+            }
+            break;
+
+        case MQTTSN_SESSION_STATE_SEARCHING:
+        case MQTTSN_SESSION_STATE_CONNECTING:
+        case MQTTSN_SESSION_STATE_REGISTERING:
+            NRF_LOG_WARNING("Session step timed out in state %s.\r\n",
+                            mqttsn_session_state_name(m_state));
+            if (m_state != MQTTSN_SESSION_STATE_SEARCHING)
+            {
+                mqttsn_rtt_timeout();
+            }
+            backoff_start();
+            break;
+
+        case MQTTSN_SESSION_STATE_READY:
+            if (m_sleep_requested)
+            {
+                NRF_LOG_WARNING("Sleep request timed out.\r\n");
+                mqttsn_rtt_timeout();
+                session_lost();
+            }
+            else if (app_is_idle())
+            {
+                sleep_start();
+            }
+            else
+            {
+                idle_arm();
+            }
+            break;
+
+        case MQTTSN_SESSION_STATE_ASLEEP:
+            // The client library sends its PINGREQ at this moment. Reconnect only if there is
+            // something to publish.
+            if (app_is_idle())
+            {
+                deadline_arm(MQTTSN_SESSION_SLEEP_DURATION_S * 1000);
+            }
+            else
+            {
+                wake_start();
+            }
+            break;
+
+        case MQTTSN_SESSION_STATE_WAKING:
+            NRF_LOG_WARNING("Wake-up timed out.\r\n");
+            mqttsn_rtt_timeout();
+            session_lost();
+            break;
+
+        default:
+            break;
+    }
+
+    return m_deadline_armed ? app_clock_remaining(app_clock_ms(), m_deadline) : APP_CLOCK_NO_DEADLINE;
+}
+
+
+mqttsn_session_state_t mqttsn_session_state_get(void)
+{
+    return m_state;
+}
+
+
+bool mqttsn_session_is_ready(void)
+{
+    return (m_state == MQTTSN_SESSION_STATE_READY) && !m_sleep_requested;
+}
+
+
+const mqttsn_remote_t * mqttsn_session_gateway_get(void)
+{
+    return m_gateway_selected ? &m_gateway_addr : NULL;
+}
+
+
+const mqttsn_session_stats_t * mqttsn_session_stats_get(void)
+{
+    return &m_stats;
+}
+
+
+const char * mqttsn_session_state_name(mqttsn_session_state_t state)
+{
+    switch (state)
+    {
+        case MQTTSN_SESSION_STATE_IDLE:        return "idle";
+        case MQTTSN_SESSION_STATE_SEARCHING:   return "searching";
+        case MQTTSN_SESSION_STATE_CONNECTING:  return "connecting";
+        case MQTTSN_SESSION_STATE_REGISTERING: return "registering";
+        case MQTTSN_SESSION_STATE_READY:       return "ready";
+        case MQTTSN_SESSION_STATE_ASLEEP:      return "asleep";
+        case MQTTSN_SESSION_STATE_WAKING:      return "waking";
+        case MQTTSN_SESSION_STATE_BACKING_OFF: return "backing-off";
+        default:                               return "unknown";
+    }
+}
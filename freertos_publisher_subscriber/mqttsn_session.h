@@ -0,0 +1,166 @@
+/** @file
+ *
+ * @defgroup mqttsn_session MQTT-SN session manager
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief MQTT-SN session state machine with reconnection backoff.
+ *
+ * @details The session manager owns the MQTT-SN client life cycle. It searches for a gateway,
+ *          connects, registers and subscribes the configured topics and keeps track of the
+ *          session health. Whenever the gateway is lost the client is reset and a new attempt is
+ *          scheduled after a capped, exponentially growing delay with random jitter, so that a
+ *          fleet of nodes does not reconnect in lockstep after a gateway restart. All gateways
+ *          announced by GWINFO or ADVERTISE are kept in @ref mqttsn_gateways; the best one is
+ *          connected, and when it fails the next-best one is tried after the shortest delay
+ *          without a new search.
+ *
+ *          Predefined and short topics are not registered. Short topics are subscribed to by their
+ *          two-character name. The client library subscribes by name only, so subscriptions to
+ *          predefined topics have to be provisioned on the gateway.
+ *
+ *          If @ref MQTTSN_SESSION_SLEEP_DURATION_S is set, an idle session goes to the MQTT-SN
+ *          asleep state and the gateway buffers messages for the client. The client library wakes
+ *          up once per sleep duration with a PINGREQ to collect them. If the application has
+ *          samples queued at that moment, the session reconnects instead, so that the buffered
+ *          messages and the samples are exchanged within a single wake-up. Nothing else is
+ *          scheduled while asleep, so the FreeRTOS tickless idle can cover the whole interval.
+ *
+ *          States: SEARCHING -> CONNECTING -> REGISTERING -> READY, and BACKING_OFF on failure.
+ *          READY -> ASLEEP -> WAKING -> READY when sleeping is enabled.
+ */
+
+#ifndef MQTTSN_SESSION_H__
+#define MQTTSN_SESSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mqttsn_client.h"
+#include "mqttsn_topics.h"
+#include <openthread/instance.h>
+
+#ifndef MQTTSN_SESSION_SEARCH_TIMEOUT
+#define MQTTSN_SESSION_SEARCH_TIMEOUT     5                            /**< MQTT-SN Gateway discovery procedure timeout in [s]. */
+#endif
+
+#ifndef MQTTSN_SESSION_BACKOFF_MIN_MS
+#define MQTTSN_SESSION_BACKOFF_MIN_MS     1000                         /**< Delay before the first reconnection attempt in [ms]. */
+#endif
+
+#ifndef MQTTSN_SESSION_BACKOFF_MAX_MS
+#define MQTTSN_SESSION_BACKOFF_MAX_MS     (120 * 1000)                 /**< Upper bound of the reconnection delay in [ms]. */
+#endif
+
+#ifndef MQTTSN_SESSION_STEP_TIMEOUT_MS
+#define MQTTSN_SESSION_STEP_TIMEOUT_MS    (30 * 1000)                  /**< Upper bound of the supervision timeout of CONNECT/REGISTER/SUBSCRIBE steps in [ms]. */
+#endif
+
+#ifndef MQTTSN_SESSION_STEP_RTO_COUNT
+#define MQTTSN_SESSION_STEP_RTO_COUNT     4                            /**< Supervision timeout of a session step in multiples of the gateway retransmission timeout, at least MQTTSN_RTT_CLIENT_RETRANSMISSION_MS plus one timeout. */
+#endif
+
+#ifndef MQTTSN_SESSION_TIMEOUT_THRESHOLD
+#define MQTTSN_SESSION_TIMEOUT_THRESHOLD  2                            /**< Consecutive retransmission timeouts after which a ready session is considered lost. */
+#endif
+
+#ifndef MQTTSN_SESSION_SLEEP_DURATION_S
+#define MQTTSN_SESSION_SLEEP_DURATION_S   0                            /**< Sleep duration, i.e. the reporting interval, in [s]. 0 keeps the session active. */
+#endif
+
+#ifndef MQTTSN_SESSION_SLEEP_IDLE_MS
+#define MQTTSN_SESSION_SLEEP_IDLE_MS      1000                         /**< Time without session traffic before falling asleep in [ms]. */
+#endif
+
+/**@brief Session states. */
+typedef enum
+{
+    MQTTSN_SESSION_STATE_IDLE,                                         /**< Session not started. */
+    MQTTSN_SESSION_STATE_SEARCHING,                                    /**< Gateway discovery in progress. */
+    MQTTSN_SESSION_STATE_CONNECTING,                                   /**< CONNECT sent, waiting for CONNACK. */
+    MQTTSN_SESSION_STATE_REGISTERING,                                  /**< Registering publish topics and subscribing. */
+    MQTTSN_SESSION_STATE_READY,                                        /**< Session established, publishing allowed. */
+    MQTTSN_SESSION_STATE_ASLEEP,                                       /**< Client asleep, the gateway buffers messages. */
+    MQTTSN_SESSION_STATE_WAKING,                                       /**< CONNECT sent to return from the asleep state. */
+    MQTTSN_SESSION_STATE_BACKING_OFF,                                  /**< Waiting before the next connection attempt. */
+} mqttsn_session_state_t;
+
+/**@brief Session state change handler. */
+typedef void (*mqttsn_session_state_handler_t)(mqttsn_session_state_t state);
+
+/**@brief Handler returning true if the application has nothing to publish. */
+typedef bool (*mqttsn_session_idle_handler_t)(void);
+
+/**@brief Session initialization structure. */
+typedef struct
+{
+    mqttsn_client_t                * p_client;                         /**< MQTT-SN client instance managed by the session. */
+    otInstance                     * p_instance;                       /**< OpenThread instance used by the client. */
+    mqttsn_client_evt_handler_t      evt_handler;                      /**< Application MQTT-SN event handler. */
+    mqttsn_connect_opt_t           * p_connect_opt;                    /**< Connect options. */
+    mqttsn_topics_entry_t          * p_pub_topics;                     /**< Topics to publish to. Normal topics are registered after connecting. */
+    uint8_t                          pub_topic_count;                  /**< Number of topics to publish to. */
+    mqttsn_topics_entry_t          * p_sub_topics;                     /**< Topics to subscribe to after connecting. */
+    uint8_t                          sub_topic_count;                  /**< Number of topics to subscribe to. */
+    mqttsn_session_state_handler_t   state_handler;                    /**< Optional state change handler. */
+    mqttsn_session_idle_handler_t    idle_handler;                     /**< Optional handler consulted before sleeping and on wake-up. Sleep is entered only if it is NULL or returns true. */
+} mqttsn_session_init_t;
+
+/**@brief Session statistics. */
+typedef struct
+{
+    uint32_t attempts;                                                 /**< Connection attempts since the session was last ready. */
+    uint32_t attempts_total;                                           /**< Connection attempts since boot. */
+    uint32_t losses;                                                   /**< Number of times a ready session was lost. */
+    uint32_t recoveries;                                               /**< Number of times the session became ready after a loss. */
+    uint32_t last_recovery_ms;                                         /**< Time from loss to ready for the last recovery. */
+    uint32_t max_recovery_ms;                                          /**< Longest observed recovery time. */
+    uint32_t total_recovery_ms;                                        /**< Sum of all recovery times. */
+    uint32_t backoff_ms;                                               /**< Currently applied backoff delay. */
+    uint32_t failovers;                                                /**< Connection attempts to a known gateway without a search. */
+    uint32_t sleeps;                                                   /**< Number of times the client went asleep. */
+    uint32_t wakeups;                                                  /**< Number of reconnections from the asleep state. */
+    uint32_t asleep_ms;                                                /**< Total time spent asleep. */
+} mqttsn_session_stats_t;
+
+/**@brief Initializes the MQTT-SN client and the session manager.
+ *
+ * @param[in] p_init  Session configuration. Referenced data must stay valid.
+ *
+ * @retval NRF_SUCCESS  If the client has been initialized.
+ */
+uint32_t mqttsn_session_init(const mqttsn_session_init_t * p_init);
+
+/**@brief Starts the session by searching for a gateway. */
+void mqttsn_session_start(void);
+
+/**@brief Feeds an MQTT-SN client event to the session state machine.
+ *
+ * @details Shall be called from the application MQTT-SN event handler for every event.
+ */
+void mqttsn_session_evt_handle(const mqttsn_event_t * p_event);
+
+/**@brief Runs pending session timers.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t mqttsn_session_process(void);
+
+/**@brief Returns current session state. */
+mqttsn_session_state_t mqttsn_session_state_get(void);
+
+/**@brief Returns true if the session is ready for publishing. */
+bool mqttsn_session_is_ready(void);
+
+/**@brief Returns the address of the selected gateway, or NULL if none is selected. */
+const mqttsn_remote_t * mqttsn_session_gateway_get(void);
+
+/**@brief Returns session statistics. */
+const mqttsn_session_stats_t * mqttsn_session_stats_get(void);
+
+/**@brief Returns a printable name of a session state. */
+const char * mqttsn_session_state_name(mqttsn_session_state_t state);
+
+#endif // MQTTSN_SESSION_H__
+
+/** @} */
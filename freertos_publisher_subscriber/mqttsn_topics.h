@@ -0,0 +1,93 @@
+/** @file
+ *
+ * @defgroup mqttsn_topics MQTT-SN topic table
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief MQTT-SN topic descriptors with normal, predefined and short topic types.
+ *
+ * @details Topics are described in a compile-time table. Normal topics are registered by name
+ *          after connecting. Predefined topic IDs and two-character short topic names are known to
+ *          both the client and the gateway in advance, so they need no REGISTER round trip and
+ *          carry two bytes instead of the topic string over the air.
+ *
+ *          Further entry fields, such as @c compressed, may be given as designated initializers
+ *          after the arguments of the initializer macros, for example
+ *          @c MQTTSN_TOPICS_NORMAL("sensors/log", .compressed = true). Each payload is
+ *          compressed on its own, which pays off from about 96 bytes, so it suits the larger samples
+ *          of the publish pipeline (up to @c PUBLISH_PIPELINE_PAYLOAD_MAX bytes); short ones mostly
+ *          grow by the one byte header. Large data is sent with the block transfer layer, which
+ *          compresses whole transfers.
+ */
+
+#ifndef MQTTSN_TOPICS_H__
+#define MQTTSN_TOPICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mqttsn_client.h"
+
+/**@brief Topic types as defined by the MQTT-SN specification. */
+typedef enum
+{
+    MQTTSN_TOPICS_TYPE_NORMAL,                                         /**< Topic name, registered at run time. */
+    MQTTSN_TOPICS_TYPE_PREDEFINED,                                     /**< Topic ID provisioned on the gateway. */
+    MQTTSN_TOPICS_TYPE_SHORT,                                          /**< Two-character topic name used as the topic ID. */
+} mqttsn_topics_type_t;
+
+/**@brief Topic table entry. */
+typedef struct
+{
+    mqttsn_topic_t       topic;                                        /**< Topic as used by the MQTT-SN client. */
+    mqttsn_topics_type_t type;                                         /**< Topic type. */
+    bool                 compressed;                                   /**< Whether payloads are encoded with the payload codec. */
+} mqttsn_topics_entry_t;
+
+/**@brief Initializer of a normal topic entry. */
+#define MQTTSN_TOPICS_NORMAL(NAME, ...)                                         \
+    {                                                                           \
+        .topic = { .p_topic_name = (unsigned char *)(NAME), .topic_id = 0 },    \
+        .type  = MQTTSN_TOPICS_TYPE_NORMAL,                                     \
+        __VA_ARGS__                                                             \
+    }
+
+/**@brief Initializer of a predefined topic entry. */
+#define MQTTSN_TOPICS_PREDEFINED(ID, ...)                                       \
+    {                                                                           \
+        .topic = { .p_topic_name = NULL, .topic_id = (ID) },                    \
+        .type  = MQTTSN_TOPICS_TYPE_PREDEFINED,                                 \
+        __VA_ARGS__                                                             \
+    }
+
+/**@brief Initializer of a short topic entry, given the two characters of its name. */
+#define MQTTSN_TOPICS_SHORT(C0, C1, ...)                                        \
+    {                                                                           \
+        .topic = { .p_topic_name = NULL,                                        \
+                   .topic_id     = (uint16_t)(((C0) << 8) | (C1)) },            \
+        .type  = MQTTSN_TOPICS_TYPE_SHORT,                                      \
+        __VA_ARGS__                                                             \
+    }
+
+/**@brief Returns true if the topic ID of an entry is known without registration. */
+static inline bool mqttsn_topics_is_static(const mqttsn_topics_entry_t * p_entry)
+{
+    return p_entry->type != MQTTSN_TOPICS_TYPE_NORMAL;
+}
+
+
+/**@brief Writes the two-character name of a short topic entry.
+ *
+ * @param[in]  p_entry  Short topic entry.
+ * @param[out] p_name   Buffer for the two characters of the name.
+ */
+static inline void mqttsn_topics_short_name_get(const mqttsn_topics_entry_t * p_entry, uint8_t * p_name)
+{
+    p_name[0] = (uint8_t)(p_entry->topic.topic_id >> 8);
+    p_name[1] = (uint8_t)(p_entry->topic.topic_id);
+}
+
+#endif // MQTTSN_TOPICS_H__
+
+/** @} */
@@ -0,0 +1,225 @@
+/** @file
+ *
+ * @brief Small-window LZSS codec for MQTT-SN payloads.
+ */
+
+#include "payload_codec.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf_error.h"
+
+#if (PAYLOAD_CODEC_WINDOW < 1) || (PAYLOAD_CODEC_WINDOW > 4096)
+#error "PAYLOAD_CODEC_WINDOW must be within 1 and 4096."
+#endif
+
+#define METHOD_STORED    0                                             /**< Payload is stored as is. */
+#define METHOD_LZSS      1                                             /**< Payload is LZSS encoded. */
+
+#define GROUP_SIZE       8                                             /**< Items following a flag byte. */
+
+
+/**@brief Finds the longest match of the data at @p pos within the window.
+ *
+ * @param[out] p_distance  Distance of the match.
+ *
+ * @return Match length, 0 if no match has been found.
+ */
+static uint16_t match_find(const uint8_t * p_in, uint16_t in_len, uint16_t pos, uint16_t * p_distance)
+{
+    uint16_t start   = (pos > PAYLOAD_CODEC_WINDOW) ? (pos - PAYLOAD_CODEC_WINDOW) : 0;
+    uint16_t len_max = in_len - pos;
+    uint16_t best    = 0;
+
+    if (len_max > PAYLOAD_CODEC_MATCH_MAX)
+    {
+        len_max = PAYLOAD_CODEC_MATCH_MAX;
+    }
+
+    // Search backwards, so that equal matches are encoded with the shortest distance.
+    for (uint16_t candidate = pos; candidate-- > start; )
+    {
+        uint16_t len = 0;
+
+        while ((len < len_max) && (p_in[candidate + len] == p_in[pos + len]))
+        {
+            len++;
+        }
+
+        if (len > best)
+        {
+            best        = len;
+            *p_distance = pos - candidate;
+
+            if (len == len_max)
+            {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+
+/**@brief Encodes a payload as LZSS stream.
+ *
+ * @return Encoded length, or 0 if the stream would not be shorter than the stored payload.
+ */
+static uint16_t lzss_encode(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out)
+{
+    uint16_t out      = 1;
+    uint16_t flag_pos = 0;
+    uint8_t  item     = GROUP_SIZE;
+    uint16_t pos      = 0;
+
+    p_out[0] = METHOD_LZSS;
+
+    while (pos < in_len)
+    {
+        uint16_t distance = 0;
+        uint16_t len      = match_find(p_in, in_len, pos, &distance);
+        bool     match    = (len >= PAYLOAD_CODEC_MATCH_MIN);
+
+        // Give up as soon as the stream reaches the size of the stored payload.
+        if (out + (item == GROUP_SIZE) + (match ? 2 : 1) > in_len)
+        {
+            return 0;
+        }
+
+        if (item == GROUP_SIZE)
+        {
+            flag_pos        = out++;
+            p_out[flag_pos] = 0;
+            item            = 0;
+        }
+
+        if (match)
+        {
+            uint16_t token = ((distance - 1) << 4) | (len - PAYLOAD_CODEC_MATCH_MIN);
+
+            p_out[flag_pos] |= (1 << item);
+            p_out[out++]     = (uint8_t)(token >> 8);
+            p_out[out++]     = (uint8_t)(token);
+            pos             += len;
+        }
+        else
+        {
+            p_out[out++] = p_in[pos++];
+        }
+
+        item++;
+    }
+
+    return out;
+}
+
+
+uint32_t payload_codec_compress(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out, uint16_t * p_out_len)
+{
+    if (*p_out_len < PAYLOAD_CODEC_BOUND(in_len))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint16_t len = lzss_encode(p_in, in_len, p_out);
+
+    if (len == 0)
+    {
+        p_out[0] = METHOD_STORED;
+        memcpy(&p_out[1], p_in, in_len);
+        len = PAYLOAD_CODEC_BOUND(in_len);
+    }
+
+    *p_out_len = len;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Decodes an LZSS stream without the method byte. */
+static uint32_t lzss_decode(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out, uint16_t * p_out_len)
+{
+    uint16_t pos  = 0;
+    uint16_t out  = 0;
+    uint16_t size = *p_out_len;
+
+    while (pos < in_len)
+    {
+        uint8_t flags = p_in[pos++];
+
+        for (uint8_t item = 0; (item < GROUP_SIZE) && (pos < in_len); item++)
+        {
+            if ((flags & (1 << item)) == 0)
+            {
+                if (out == size)
+                {
+                    return NRF_ERROR_NO_MEM;
+                }
+
+                p_out[out++] = p_in[pos++];
+                continue;
+            }
+
+            if (pos + 2 > in_len)
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+
+            uint16_t token    = ((uint16_t)p_in[pos] << 8) | p_in[pos + 1];
+            uint16_t distance = (token >> 4) + 1;
+            uint16_t len      = (token & 0x0F) + PAYLOAD_CODEC_MATCH_MIN;
+
+            pos += 2;
+
+            if (distance > out)
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+
+            if (len > size - out)
+            {
+                return NRF_ERROR_NO_MEM;
+            }
+
+            // Byte by byte, since a match may overlap the data it produces.
+            for (uint16_t i = 0; i < len; i++, out++)
+            {
+                p_out[out] = p_out[out - distance];
+            }
+        }
+    }
+
+    *p_out_len = out;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t payload_codec_decompress(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out, uint16_t * p_out_len)
+{
+    if (in_len == 0)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    switch (p_in[0])
+    {
+        case METHOD_STORED:
+            if (in_len - 1 > *p_out_len)
+            {
+                return NRF_ERROR_NO_MEM;
+            }
+
+            memcpy(p_out, &p_in[1], in_len - 1);
+            *p_out_len = in_len - 1;
+            return NRF_SUCCESS;
+
+        case METHOD_LZSS:
+            return lzss_decode(&p_in[1], in_len - 1, p_out, p_out_len);
+
+        default:
+            return NRF_ERROR_INVALID_DATA;
+    }
+}
@@ -0,0 +1,67 @@
+/** @file
+ *
+ * @defgroup payload_codec Payload compression
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Small-window LZSS codec for MQTT-SN payloads.
+ *
+ * @details Each payload is compressed on its own, so that a lost or reordered message does not
+ *          affect the decoding of others. Matches are searched for in the preceding
+ *          @ref PAYLOAD_CODEC_WINDOW bytes of the payload itself, so the codec needs no RAM besides
+ *          the input and output buffers and a few bytes of stack.
+ *
+ *          The first byte of an encoded payload selects the method. Payloads which do not shrink
+ *          are stored, so the encoded size never exceeds @ref PAYLOAD_CODEC_BOUND of the input.
+ *          An LZSS stream consists of groups of a flag byte followed by up to eight items. A clear
+ *          flag bit marks a literal byte, a set bit marks a two-byte match holding the distance
+ *          minus one in the upper 12 bits and the length minus @ref PAYLOAD_CODEC_MATCH_MIN in the
+ *          lower 4 bits.
+ *
+ * @note The module has no dependencies on the SDK besides the error codes and can be built for
+ *       the host, see tools/payload_codec_bench.c.
+ */
+
+#ifndef PAYLOAD_CODEC_H__
+#define PAYLOAD_CODEC_H__
+
+#include <stdint.h>
+
+#ifndef PAYLOAD_CODEC_WINDOW
+#define PAYLOAD_CODEC_WINDOW       256                                 /**< Largest match distance. Trades compression for search time, at most 4096. */
+#endif
+
+#define PAYLOAD_CODEC_MATCH_MIN    3                                   /**< Shortest encoded match. */
+#define PAYLOAD_CODEC_MATCH_MAX    (PAYLOAD_CODEC_MATCH_MIN + 15)      /**< Longest encoded match. */
+
+#define PAYLOAD_CODEC_BOUND(len)   ((len) + 1)                         /**< Largest encoded size of a payload of the given length. */
+
+/**@brief Compresses a payload.
+ *
+ * @param[in]     p_in       Payload.
+ * @param[in]     in_len     Payload length.
+ * @param[out]    p_out      Buffer for the encoded payload.
+ * @param[in,out] p_out_len  In: buffer size, at least @ref PAYLOAD_CODEC_BOUND of @p in_len.
+ *                           Out: encoded length.
+ *
+ * @retval NRF_SUCCESS       If the payload has been encoded.
+ * @retval NRF_ERROR_NO_MEM  If the output buffer is too small.
+ */
+uint32_t payload_codec_compress(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out, uint16_t * p_out_len);
+
+/**@brief Restores a payload encoded by @ref payload_codec_compress.
+ *
+ * @param[in]     p_in       Encoded payload.
+ * @param[in]     in_len     Encoded length.
+ * @param[out]    p_out      Buffer for the payload.
+ * @param[in,out] p_out_len  In: buffer size. Out: payload length.
+ *
+ * @retval NRF_SUCCESS             If the payload has been decoded.
+ * @retval NRF_ERROR_NO_MEM        If the output buffer is too small.
+ * @retval NRF_ERROR_INVALID_DATA  If the encoded payload is malformed.
+ */
+uint32_t payload_codec_decompress(const uint8_t * p_in, uint16_t in_len, uint8_t * p_out, uint16_t * p_out_len);
+
+#endif // PAYLOAD_CODEC_H__
+
+/** @} */
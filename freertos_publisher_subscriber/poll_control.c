@@ -0,0 +1,162 @@
+/** @file
+ *
+ * @brief Adaptive data poll period of a Sleepy End Device.
+ */
+
+#include "poll_control.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "mqttsn_session.h"
+#include "publish_pipeline.h"
+
+#include <openthread/link.h>
+
+#define NRF_LOG_MODULE_NAME POLL
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+static otInstance           * mp_instance;                             /**< OpenThread instance, NULL if polling is not adapted. */
+static poll_control_stats_t   m_stats;                                 /**< Poll control statistics. */
+static uint32_t               m_period;                                /**< Current poll period in [ms]. */
+static uint32_t               m_next_step;                             /**< Time of the next poll period increase. */
+static uint32_t               m_fast_since;                            /**< Time at which fast polling was entered. */
+static uint32_t               m_started_at;                            /**< Time of initialization. */
+static uint32_t               m_last_sent;                             /**< Pipeline sent counter seen by the last check. */
+static bool                   m_activity;                              /**< Activity signalled since the last check. */
+
+
+/**@brief Adds the time spent at the fast period since the last call to the statistics. */
+static void fast_time_update(uint32_t now)
+{
+    if (m_period == POLL_CONTROL_FAST_MS)
+    {
+        m_stats.fast_ms += now - m_fast_since;
+        m_fast_since     = now;
+    }
+}
+
+
+static void period_set(uint32_t period, uint32_t now)
+{
+    if (period == m_period)
+    {
+        return;
+    }
+
+    fast_time_update(now);
+
+    if (period == POLL_CONTROL_FAST_MS)
+    {
+        m_fast_since = now;
+        m_stats.speedups++;
+    }
+
+    m_period = period;
+    (void)otLinkSetPollPeriod(mp_instance, m_period);
+
+    NRF_LOG_DEBUG("Poll period %d ms\r\n", m_period);
+}
+
+
+/**@brief Returns true if traffic is pending or has been seen since the last check. */
+static bool activity_check(void)
+{
+    const publish_pipeline_stats_t * p_pipeline = publish_pipeline_stats_get();
+    mqttsn_session_state_t           state      = mqttsn_session_state_get();
+    bool                             activity   = m_activity;
+
+    m_activity = false;
+
+    // Queued messages, control handshakes and recent publishes all expect a response soon. A
+    // backlog held during a gateway outage does not, as it is not sent before the session is ready.
+    if (((p_pipeline->depth != 0) && mqttsn_session_is_ready()) || (p_pipeline->sent != m_last_sent))
+    {
+        activity = true;
+    }
+
+    if ((state == MQTTSN_SESSION_STATE_SEARCHING)  ||
+        (state == MQTTSN_SESSION_STATE_CONNECTING) ||
+        (state == MQTTSN_SESSION_STATE_REGISTERING) ||
+        (state == MQTTSN_SESSION_STATE_WAKING))
+    {
+        activity = true;
+    }
+
+    m_last_sent = p_pipeline->sent;
+
+    return activity;
+}
+
+
+static void counters_update(uint32_t now)
+{
+    const otMacCounters * p_counters = otLinkGetCounters(mp_instance);
+
+    m_stats.polls       = p_counters->mTxDataPoll;
+    m_stats.tx_frames   = p_counters->mTxTotal - p_counters->mTxDataPoll;
+    m_stats.rx_frames   = p_counters->mRxTotal;
+    m_stats.radio_on_ms = (uint32_t)((((uint64_t)m_stats.polls * POLL_CONTROL_POLL_RADIO_ON_US) +
+                                      ((uint64_t)(m_stats.tx_frames + m_stats.rx_frames) *
+                                       POLL_CONTROL_FRAME_RADIO_ON_US)) / 1000);
+    m_stats.uptime_ms   = now - m_started_at;
+    m_stats.period_ms   = m_period;
+}
+
+
+void poll_control_init(otInstance * p_instance)
+{
+    uint32_t now = app_clock_ms();
+
+    mp_instance  = p_instance;
+    m_period     = 0;
+    m_started_at = now;
+    m_last_sent  = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    period_set(POLL_CONTROL_FAST_MS, now);
+    m_next_step = now + POLL_CONTROL_FAST_HOLD_MS;
+}
+
+
+void poll_control_activity(void)
+{
+    m_activity = true;
+}
+
+
+uint32_t poll_control_process(void)
+{
+    if (mp_instance == NULL)
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint32_t now = app_clock_ms();
+
+    if (activity_check())
+    {
+        period_set(POLL_CONTROL_FAST_MS, now);
+        m_next_step = now + POLL_CONTROL_FAST_HOLD_MS;
+    }
+    else if ((m_period < POLL_CONTROL_MAX_MS) && app_clock_expired(now, m_next_step))
+    {
+        period_set(MIN(m_period * 2, POLL_CONTROL_MAX_MS), now);
+        m_next_step = now + (m_period * POLL_CONTROL_BACKOFF_POLLS);
+    }
+
+    // Accounts for an ongoing fast period without ending it.
+    fast_time_update(now);
+    counters_update(now);
+
+    return (m_period < POLL_CONTROL_MAX_MS) ? app_clock_remaining(now, m_next_step) : APP_CLOCK_NO_DEADLINE;
+}
+
+
+const poll_control_stats_t * poll_control_stats_get(void)
+{
+    return (mp_instance != NULL) ? &m_stats : NULL;
+}
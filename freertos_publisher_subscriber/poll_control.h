@@ -0,0 +1,91 @@
+/** @file
+ *
+ * @defgroup poll_control Sleepy End Device poll control
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Adaptive data poll period of a Sleepy End Device.
+ *
+ * @details A Sleepy End Device keeps its receiver off and polls its parent for buffered frames.
+ *          The poll period trades inbound latency against energy. The poll period is set to
+ *          @ref POLL_CONTROL_FAST_MS while messages are queued for sending, while the MQTT-SN
+ *          session exchanges control messages and for @ref POLL_CONTROL_FAST_HOLD_MS after a
+ *          publish or a received command. Afterwards it doubles every
+ *          @ref POLL_CONTROL_BACKOFF_POLLS polls up to @ref POLL_CONTROL_MAX_MS, which bounds the
+ *          latency of inbound commands in idle periods.
+ *
+ *          Radio-on time is estimated from the MAC counters, because the radio driver does not
+ *          account for it.
+ */
+
+#ifndef POLL_CONTROL_H__
+#define POLL_CONTROL_H__
+
+#include <stdint.h>
+
+#include <openthread/instance.h>
+
+#ifndef POLL_CONTROL_FAST_MS
+#define POLL_CONTROL_FAST_MS               250                         /**< Poll period during activity in [ms]. */
+#endif
+
+#ifndef POLL_CONTROL_MAX_MS
+#define POLL_CONTROL_MAX_MS                (30 * 1000)                 /**< Idle poll period, i.e. the worst-case inbound command latency in [ms]. */
+#endif
+
+#ifndef POLL_CONTROL_FAST_HOLD_MS
+#define POLL_CONTROL_FAST_HOLD_MS          2000                        /**< Time to keep polling fast after the last activity in [ms]. */
+#endif
+
+#ifndef POLL_CONTROL_BACKOFF_POLLS
+#define POLL_CONTROL_BACKOFF_POLLS         2                           /**< Polls at each period before it is doubled. */
+#endif
+
+#ifndef POLL_CONTROL_CHILD_TIMEOUT
+#define POLL_CONTROL_CHILD_TIMEOUT         240                         /**< Child timeout requested from the parent in [s]. Must exceed the idle poll period. */
+#endif
+
+#ifndef POLL_CONTROL_POLL_RADIO_ON_US
+#define POLL_CONTROL_POLL_RADIO_ON_US      3000                        /**< Estimated radio-on time of a data poll including the acknowledgment and frame pending window in [us]. */
+#endif
+
+#ifndef POLL_CONTROL_FRAME_RADIO_ON_US
+#define POLL_CONTROL_FRAME_RADIO_ON_US     2500                        /**< Estimated radio-on time of any other transmitted or received frame in [us]. */
+#endif
+
+/**@brief Poll control statistics. */
+typedef struct
+{
+    uint32_t period_ms;                                                /**< Current poll period. */
+    uint32_t speedups;                                                 /**< Number of times fast polling was entered. */
+    uint32_t fast_ms;                                                  /**< Time spent polling at the fast period. */
+    uint32_t polls;                                                    /**< Data polls sent. */
+    uint32_t tx_frames;                                                /**< Other frames transmitted. */
+    uint32_t rx_frames;                                                /**< Frames received. */
+    uint32_t radio_on_ms;                                              /**< Estimated radio-on time. */
+    uint32_t uptime_ms;                                                /**< Time since initialization. */
+} poll_control_stats_t;
+
+/**@brief Starts adaptive polling.
+ *
+ * @param[in] p_instance  OpenThread instance configured as a Sleepy End Device.
+ */
+void poll_control_init(otInstance * p_instance);
+
+/**@brief Signals activity which requires fast polling, e.g. a received command. */
+void poll_control_activity(void);
+
+/**@brief Adapts the poll period.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t poll_control_process(void);
+
+/**@brief Returns poll control statistics as of the last @ref poll_control_process, or NULL if
+ *        adaptive polling has not been started.
+ */
+const poll_control_stats_t * poll_control_stats_get(void);
+
+#endif // POLL_CONTROL_H__
+
+/** @} */
@@ -0,0 +1,168 @@
+/** @file
+ *
+ * @brief Windowed aggregation of samples into summary records.
+ */
+
+#include "publish_aggregator.h"
+
+#include <string.h>
+
+#include "app_util.h"
+#include "publish_pipeline.h"
+#include "sdk_errors.h"
+
+#define NRF_LOG_MODULE_NAME AGGREGATOR
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+STATIC_ASSERT(PUBLISH_AGGREGATOR_RECORD_MAX <= PUBLISH_PIPELINE_PAYLOAD_MAX);
+
+static publish_aggregator_t m_aggregators[PUBLISH_AGGREGATOR_COUNT];   /**< Aggregators. */
+static uint8_t              m_aggregator_count;                        /**< Number of aggregators in use. */
+
+
+/**@brief Starts a new window. */
+static void window_reset(publish_aggregator_t * p_aggregator)
+{
+    p_aggregator->count = 0;
+    p_aggregator->min   = INT16_MAX;
+    p_aggregator->max   = INT16_MIN;
+    p_aggregator->sum   = 0;
+}
+
+
+static uint8_t * put_le16(uint8_t * p_out, uint16_t value)
+{
+    p_out[0] = (uint8_t)value;
+    p_out[1] = (uint8_t)(value >> 8);
+
+    return p_out + 2;
+}
+
+
+/**@brief Queues the record of a full window and starts the next one. */
+static void window_publish(publish_aggregator_t * p_aggregator)
+{
+    uint8_t   record[PUBLISH_AGGREGATOR_RECORD_MAX];
+    uint8_t * p_out = record;
+
+    *p_out++ = p_aggregator->stats;
+
+    if (p_aggregator->stats & PUBLISH_AGGREGATOR_STAT_COUNT)
+    {
+        p_out = put_le16(p_out, p_aggregator->count);
+    }
+
+    if (p_aggregator->stats & PUBLISH_AGGREGATOR_STAT_MIN)
+    {
+        p_out = put_le16(p_out, (uint16_t)p_aggregator->min);
+    }
+
+    if (p_aggregator->stats & PUBLISH_AGGREGATOR_STAT_MAX)
+    {
+        p_out = put_le16(p_out, (uint16_t)p_aggregator->max);
+    }
+
+    if (p_aggregator->stats & PUBLISH_AGGREGATOR_STAT_MEAN)
+    {
+        // One division per window; the sum is scaled in 64 bits to keep the full range.
+        uint32_t mean = (uint32_t)(int32_t)(((int64_t)p_aggregator->sum * 256) / p_aggregator->count);
+
+        p_out = put_le16(p_out, (uint16_t)mean);
+        p_out = put_le16(p_out, (uint16_t)(mean >> 16));
+    }
+
+    uint32_t err_code = publish_pipeline_put(p_aggregator->p_topic, record, p_out - record);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        p_aggregator->records++;
+    }
+    else
+    {
+        p_aggregator->put_errors++;
+        NRF_LOG_ERROR("Record could not be queued. Error code: 0x%x\r\n", err_code);
+    }
+
+    window_reset(p_aggregator);
+}
+
+
+uint32_t publish_aggregator_add(const mqttsn_topics_entry_t * p_topic, uint16_t window, uint8_t stats)
+{
+    if ((window == 0) || ((stats & PUBLISH_AGGREGATOR_STAT_ALL) == 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (m_aggregator_count == PUBLISH_AGGREGATOR_COUNT)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    publish_aggregator_t * p_aggregator = &m_aggregators[m_aggregator_count++];
+
+    memset(p_aggregator, 0, sizeof(*p_aggregator));
+    p_aggregator->p_topic = p_topic;
+    p_aggregator->window  = window;
+    p_aggregator->stats   = stats & PUBLISH_AGGREGATOR_STAT_ALL;
+    window_reset(p_aggregator);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t publish_aggregator_put(const mqttsn_topics_entry_t * p_topic, const int16_t * p_samples, uint16_t count)
+{
+    for (uint8_t i = 0; i < m_aggregator_count; i++)
+    {
+        publish_aggregator_t * p_aggregator = &m_aggregators[i];
+
+        if (p_aggregator->p_topic != p_topic)
+        {
+            continue;
+        }
+
+        while (count > 0)
+        {
+            // Samples up to the end of the window are accumulated without further checks.
+            uint16_t chunk = MIN(count, p_aggregator->window - p_aggregator->count);
+            int16_t  min   = p_aggregator->min;
+            int16_t  max   = p_aggregator->max;
+            int32_t  sum   = p_aggregator->sum;
+
+            for (uint16_t j = 0; j < chunk; j++)
+            {
+                int16_t value = p_samples[j];
+
+                // Compiled to conditional selects rather than branches.
+                min  = MIN(min, value);
+                max  = MAX(max, value);
+                sum += value;
+            }
+
+            p_aggregator->min      = min;
+            p_aggregator->max      = max;
+            p_aggregator->sum      = sum;
+            p_aggregator->count   += chunk;
+            p_aggregator->samples += chunk;
+            p_samples             += chunk;
+            count                 -= chunk;
+
+            if (p_aggregator->count == p_aggregator->window)
+            {
+                window_publish(p_aggregator);
+            }
+        }
+
+        return NRF_SUCCESS;
+    }
+
+    return NRF_ERROR_NOT_FOUND;
+}
+
+
+const publish_aggregator_t * publish_aggregator_get(uint8_t index)
+{
+    return (index < m_aggregator_count) ? &m_aggregators[index] : NULL;
+}
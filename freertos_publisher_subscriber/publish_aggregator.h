@@ -0,0 +1,80 @@
+/** @file
+ *
+ * @defgroup publish_aggregator Publish aggregator
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Windowed aggregation of samples into summary records.
+ *
+ * @details Samples of an aggregated topic are not published. Instead, the minimum, maximum, sum
+ *          and count are updated in constant time per sample, and a summary record is queued in
+ *          the publish pipeline when the window is full.
+ *
+ *          The record starts with a byte holding the statistics it contains, followed by each of
+ *          them in the order of their flags, little-endian: count as uint16, minimum and maximum
+ *          as int16, and the mean as int32 in Q24.8 fixed point.
+ */
+
+#ifndef PUBLISH_AGGREGATOR_H__
+#define PUBLISH_AGGREGATOR_H__
+
+#include <stdint.h>
+
+#include "mqttsn_topics.h"
+
+#ifndef PUBLISH_AGGREGATOR_COUNT
+#define PUBLISH_AGGREGATOR_COUNT       2                               /**< Number of topics which can be aggregated. */
+#endif
+
+#define PUBLISH_AGGREGATOR_STAT_COUNT  0x01                            /**< Number of samples in the window. */
+#define PUBLISH_AGGREGATOR_STAT_MIN    0x02                            /**< Smallest sample. */
+#define PUBLISH_AGGREGATOR_STAT_MAX    0x04                            /**< Largest sample. */
+#define PUBLISH_AGGREGATOR_STAT_MEAN   0x08                            /**< Mean of the samples. */
+#define PUBLISH_AGGREGATOR_STAT_ALL    0x0F                            /**< All statistics. */
+
+#define PUBLISH_AGGREGATOR_RECORD_MAX  11                              /**< Length of a record with all statistics. */
+
+/**@brief Aggregator of a topic. */
+typedef struct
+{
+    const mqttsn_topics_entry_t * p_topic;                             /**< Aggregated topic. */
+    uint16_t                      window;                              /**< Samples per window. */
+    uint8_t                       stats;                               /**< Statistics published, a combination of PUBLISH_AGGREGATOR_STAT_ flags. */
+    uint16_t                      count;                               /**< Samples in the current window. */
+    int16_t                       min;                                 /**< Smallest sample in the current window. */
+    int16_t                       max;                                 /**< Largest sample in the current window. */
+    int32_t                       sum;                                 /**< Sum of the current window, which cannot overflow with 16-bit counts. */
+    uint32_t                      samples;                             /**< Samples aggregated. */
+    uint32_t                      records;                             /**< Records queued in the publish pipeline. */
+    uint32_t                      put_errors;                          /**< Records rejected by the publish pipeline. */
+} publish_aggregator_t;
+
+/**@brief Adds an aggregator for a topic.
+ *
+ * @param[in] p_topic  Topic to aggregate.
+ * @param[in] window   Samples per window.
+ * @param[in] stats    Statistics to publish, a combination of PUBLISH_AGGREGATOR_STAT_ flags.
+ *
+ * @retval NRF_SUCCESS              If the aggregator has been added.
+ * @retval NRF_ERROR_INVALID_PARAM  If the window is empty or no statistics are selected.
+ * @retval NRF_ERROR_NO_MEM         If @ref PUBLISH_AGGREGATOR_COUNT aggregators have been added already.
+ */
+uint32_t publish_aggregator_add(const mqttsn_topics_entry_t * p_topic, uint16_t window, uint8_t stats);
+
+/**@brief Aggregates samples and queues the records of full windows. Not interrupt safe.
+ *
+ * @param[in] p_topic    Topic of the samples.
+ * @param[in] p_samples  Samples.
+ * @param[in] count      Number of samples.
+ *
+ * @retval NRF_SUCCESS          If the samples have been aggregated.
+ * @retval NRF_ERROR_NOT_FOUND  If the topic is not aggregated; the samples have to be published as they are.
+ */
+uint32_t publish_aggregator_put(const mqttsn_topics_entry_t * p_topic, const int16_t * p_samples, uint16_t count);
+
+/**@brief Returns an aggregator by index, or NULL if there is none. */
+const publish_aggregator_t * publish_aggregator_get(uint8_t index);
+
+#endif // PUBLISH_AGGREGATOR_H__
+
+/** @} */
@@ -0,0 +1,142 @@
+/** @file
+ *
+ * @brief Report-by-exception filter for samples of numeric values.
+ */
+
+#include "publish_filter.h"
+
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util_platform.h"
+
+static publish_filter_t m_filters[PUBLISH_FILTER_COUNT];               /**< Filters. */
+static uint8_t          m_filter_count;                                /**< Number of filters in use. */
+
+
+uint32_t publish_filter_add(const mqttsn_topics_entry_t    * p_topic,
+                            uint32_t                         deadband,
+                            uint32_t                         heartbeat_ms,
+                            publish_filter_heartbeat_handler_t heartbeat_handler)
+{
+    if (m_filter_count == PUBLISH_FILTER_COUNT)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    publish_filter_t * p_filter = &m_filters[m_filter_count];
+
+    memset(p_filter, 0, sizeof(*p_filter));
+    p_filter->p_topic           = p_topic;
+    p_filter->deadband          = deadband;
+    p_filter->heartbeat_ms      = heartbeat_ms;
+    p_filter->heartbeat_handler = heartbeat_handler;
+
+    CRITICAL_REGION_ENTER();
+    m_filter_count++;
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+bool publish_filter_pass(const mqttsn_topics_entry_t * p_topic, int32_t value, uint32_t now)
+{
+    bool pass = true;
+
+    CRITICAL_REGION_ENTER();
+
+    for (uint8_t i = 0; i < m_filter_count; i++)
+    {
+        publish_filter_t * p_filter = &m_filters[i];
+
+        if (p_filter->p_topic != p_topic)
+        {
+            continue;
+        }
+
+        int64_t change    = (int64_t)value - p_filter->last_value;
+        bool    exception = !p_filter->primed || (change > p_filter->deadband) || (-change > p_filter->deadband);
+        bool    heartbeat = (p_filter->heartbeat_ms != 0) &&
+                            app_clock_expired(now, p_filter->last_at + p_filter->heartbeat_ms);
+
+        pass = exception || heartbeat;
+
+        if (pass)
+        {
+            p_filter->primed     = true;
+            p_filter->last_value = value;
+            p_filter->last_at    = now;
+            p_filter->passed++;
+
+            if (!exception)
+            {
+                p_filter->heartbeats++;
+            }
+        }
+        else
+        {
+            p_filter->suppressed++;
+        }
+        break;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return pass;
+}
+
+
+uint32_t publish_filter_process(void)
+{
+    uint32_t timeout_ms = APP_CLOCK_NO_DEADLINE;
+    uint32_t now        = app_clock_ms();
+
+    for (uint8_t i = 0; i < m_filter_count; i++)
+    {
+        publish_filter_t * p_filter = &m_filters[i];
+        bool               due      = false;
+        int32_t            value    = 0;
+
+        if ((p_filter->heartbeat_handler == NULL) || (p_filter->heartbeat_ms == 0))
+        {
+            continue;
+        }
+
+        // Samples pass from interrupt context.
+        CRITICAL_REGION_ENTER();
+
+        if (p_filter->primed)
+        {
+            uint32_t deadline = p_filter->last_at + p_filter->heartbeat_ms;
+
+            due = app_clock_expired(now, deadline);
+
+            if (due)
+            {
+                p_filter->last_at = now;
+                p_filter->passed++;
+                p_filter->heartbeats++;
+                value    = p_filter->last_value;
+                deadline = now + p_filter->heartbeat_ms;
+            }
+
+            timeout_ms = MIN(timeout_ms, app_clock_remaining(now, deadline));
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        if (due)
+        {
+            p_filter->heartbeat_handler(p_filter->p_topic, value);
+        }
+    }
+
+    return timeout_ms;
+}
+
+
+const publish_filter_t * publish_filter_get(uint8_t index)
+{
+    return (index < m_filter_count) ? &m_filters[index] : NULL;
+}
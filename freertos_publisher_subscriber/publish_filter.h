@@ -0,0 +1,91 @@
+/** @file
+ *
+ * @defgroup publish_filter Publish filter
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Report-by-exception filter for samples of numeric values.
+ *
+ * @details A sample passes if its value differs from the last value passed by more than the
+ *          deadband of its topic, or if the heartbeat interval has elapsed since then, so that
+ *          subscribers see a steady signal at least once per interval. Samples of topics without
+ *          a filter always pass. Heartbeats are driven by @ref publish_filter_process, which
+ *          hands the last passed value to the heartbeat handler of the topic once the interval has
+ *          elapsed without a sample passing.
+ */
+
+#ifndef PUBLISH_FILTER_H__
+#define PUBLISH_FILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mqttsn_topics.h"
+
+#ifndef PUBLISH_FILTER_COUNT
+#define PUBLISH_FILTER_COUNT    4                                      /**< Number of topics which can be filtered. */
+#endif
+
+/**@brief Heartbeat handler, called from @ref publish_filter_process to republish a value.
+ *
+ * @param[in] p_topic  Topic of the value.
+ * @param[in] value    Value of the last sample passed.
+ */
+typedef void (*publish_filter_heartbeat_handler_t)(const mqttsn_topics_entry_t * p_topic, int32_t value);
+
+/**@brief Filter of a topic. */
+typedef struct
+{
+    const mqttsn_topics_entry_t      * p_topic;                        /**< Filtered topic. */
+    publish_filter_heartbeat_handler_t heartbeat_handler;              /**< Handler republishing the last value, NULL to only pass late samples. */
+    uint32_t                           deadband;                       /**< Largest change which is suppressed. */
+    uint32_t                           heartbeat_ms;                   /**< Longest time without a passed sample in [ms], 0 to disable. */
+    bool                               primed;                         /**< Whether a sample has passed. */
+    int32_t                            last_value;                     /**< Value of the last sample passed. */
+    uint32_t                           last_at;                        /**< Time of the last sample passed. */
+    uint32_t                           passed;                         /**< Samples passed. */
+    uint32_t                           suppressed;                     /**< Samples dropped within the deadband. */
+    uint32_t                           heartbeats;                     /**< Samples passed or republished only because the heartbeat interval had elapsed. */
+} publish_filter_t;
+
+/**@brief Adds a filter for a topic.
+ *
+ * @param[in] p_topic            Topic to filter.
+ * @param[in] deadband           Largest change of the value which is suppressed. 0 passes every change.
+ * @param[in] heartbeat_ms       Longest time without a passed sample in [ms], 0 to disable.
+ * @param[in] heartbeat_handler  Handler republishing the last value once the heartbeat interval
+ *                               has elapsed. NULL leaves heartbeats to samples arriving late.
+ *
+ * @retval NRF_SUCCESS       If the filter has been added.
+ * @retval NRF_ERROR_NO_MEM  If @ref PUBLISH_FILTER_COUNT filters have been added already.
+ */
+uint32_t publish_filter_add(const mqttsn_topics_entry_t    * p_topic,
+                            uint32_t                         deadband,
+                            uint32_t                         heartbeat_ms,
+                            publish_filter_heartbeat_handler_t heartbeat_handler);
+
+/**@brief Decides whether a sample is published. May be called from interrupt context.
+ *
+ * @param[in] p_topic  Topic of the sample.
+ * @param[in] value    Value of the sample.
+ * @param[in] now      Current time in milliseconds.
+ *
+ * @return True if the sample has to be published.
+ */
+bool publish_filter_pass(const mqttsn_topics_entry_t * p_topic, int32_t value, uint32_t now);
+
+/**@brief Calls the heartbeat handlers of the filters whose interval has elapsed.
+ *
+ * @details To be called from the task publishing the samples. Filters through which no sample
+ *          has passed yet have no value to republish.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t publish_filter_process(void);
+
+/**@brief Returns a filter by index, or NULL if the index is not in use. */
+const publish_filter_t * publish_filter_get(uint8_t index);
+
+#endif // PUBLISH_FILTER_H__
+
+/** @} */
@@ -0,0 +1,398 @@
+/** @file
+ *
+ * @brief Queues outbound samples and publishes them from the Thread stack task.
+ */
+
+#include "publish_pipeline.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "app_clock.h"
+#include "app_util_platform.h"
+#include "latency_trace.h"
+#include "mqttsn_gateways.h"
+#include "mqttsn_mtu.h"
+#include "mqttsn_rtt.h"
+#include "mqttsn_session.h"
+#include "payload_codec.h"
+#include "thread_utils.h"
+#include "token_bucket.h"
+
+#define NRF_LOG_MODULE_NAME PIPELINE
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+/**@brief A queued sample. */
+typedef struct
+{
+    uint32_t seq;                                                      /**< Sequence number, used to detect concurrent drops. */
+    uint32_t queued_ms;                                                /**< Time of queuing in [ms], see @ref app_clock_ms. */
+    uint8_t  topic;                                                    /**< Index of the topic in the topic table, valid across resets. */
+    uint16_t len;                                                      /**< Payload length. */
+    uint8_t  payload[PUBLISH_PIPELINE_PAYLOAD_MAX];                    /**< Payload. */
+} sample_t;
+
+#define SAMPLE_SIZE(len)    (offsetof(sample_t, payload) + (len))      /**< Size of a sample record in the flash log. */
+
+STATIC_ASSERT(SAMPLE_SIZE(PUBLISH_PIPELINE_PAYLOAD_MAX) <= FLASH_LOG_RECORD_MAX);
+
+static mqttsn_client_t        * mp_client;                             /**< MQTT-SN client used for publishing. */
+static const mqttsn_topics_entry_t * mp_topics;                        /**< Topic table. */
+static uint8_t                  m_topic_count;                         /**< Number of topics in the table. */
+static sample_t                 m_queue[PUBLISH_PIPELINE_QUEUE_SIZE];  /**< Sample ring buffer. */
+static uint16_t                 m_head;                                /**< Index of the oldest sample. */
+static uint32_t                 m_seq;                                 /**< Sequence number of the next queued sample. */
+static publish_pipeline_stats_t m_stats;                               /**< Pipeline statistics. */
+static token_bucket_t           m_drain_bucket;                        /**< Limits the publish rate of the backlog. */
+
+static bool                     m_attached;                            /**< Whether the device is attached to a Thread partition. */
+static uint32_t                 m_detached_at;                         /**< Time at which the device detached. */
+
+
+/**@brief Copies the oldest sample. Returns false if the queue is empty. */
+static bool queue_peek(sample_t * p_sample)
+{
+    bool found = false;
+
+    CRITICAL_REGION_ENTER();
+
+    if (m_stats.depth > 0)
+    {
+        *p_sample = m_queue[m_head];
+        found     = true;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return found;
+}
+
+
+/**@brief Removes the oldest sample unless it has been dropped in the meantime. */
+static void queue_pop(uint32_t seq)
+{
+    CRITICAL_REGION_ENTER();
+
+    if ((m_stats.depth > 0) && (m_queue[m_head].seq == seq))
+    {
+        m_head = (m_head + 1) % PUBLISH_PIPELINE_QUEUE_SIZE;
+        m_stats.depth--;
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Returns the current time in milliseconds. May be called from any context. */
+static uint32_t queue_time_ms(void)
+{
+    return (current_int_priority_get() == APP_IRQ_PRIORITY_THREAD) ? app_clock_ms() : app_clock_ms_from_isr();
+}
+
+
+/**@brief Moves the oldest RAM samples to the flash log.
+ *
+ * @details Samples in flash are always older than those in RAM, so draining flash first keeps
+ *          the publish order.
+ */
+static void queue_spill(void)
+{
+#if PUBLISH_PIPELINE_FLASH_SPILL
+    sample_t sample;
+
+    if (m_stats.depth < PUBLISH_PIPELINE_SPILL_THRESHOLD)
+    {
+        return;
+    }
+
+    while ((m_stats.depth > PUBLISH_PIPELINE_SPILL_THRESHOLD / 2) && queue_peek(&sample))
+    {
+        if (flash_log_append(&sample, SAMPLE_SIZE(sample.len)) == NRF_SUCCESS)
+        {
+            m_stats.spilled++;
+        }
+        else
+        {
+            m_stats.spill_errors++;
+        }
+
+        queue_pop(sample.seq);
+    }
+#endif
+}
+
+
+void publish_pipeline_init(mqttsn_client_t * p_client, const mqttsn_topics_entry_t * p_topics, uint8_t topic_count)
+{
+    mp_client     = p_client;
+    mp_topics     = p_topics;
+    m_topic_count = topic_count;
+    m_head        = 0;
+    m_seq         = 0;
+    m_attached    = false;
+    m_detached_at = app_clock_ms();
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    token_bucket_init(&m_drain_bucket, PUBLISH_PIPELINE_DRAIN_RATE, PUBLISH_PIPELINE_DRAIN_BURST, m_detached_at);
+
+#if PUBLISH_PIPELINE_FLASH_SPILL
+    flash_log_init(PUBLISH_PIPELINE_DROP_NEWEST ? FLASH_LOG_DROP_NEWEST : FLASH_LOG_DROP_OLDEST);
+#endif
+}
+
+
+uint32_t publish_pipeline_put(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len)
+{
+    // The client would send the ID of a predefined or short topic as a normal one.
+    if ((p_topic < mp_topics) || (p_topic >= mp_topics + m_topic_count) || mqttsn_topics_is_static(p_topic))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (len > PUBLISH_PIPELINE_PAYLOAD_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint32_t err_code = NRF_SUCCESS;
+
+    CRITICAL_REGION_ENTER();
+
+    if (m_stats.depth == PUBLISH_PIPELINE_QUEUE_SIZE)
+    {
+        m_stats.dropped++;
+
+#if PUBLISH_PIPELINE_DROP_NEWEST
+        err_code = NRF_ERROR_NO_MEM;
+#else
+        m_head = (m_head + 1) % PUBLISH_PIPELINE_QUEUE_SIZE;
+        m_stats.depth--;
+#endif
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        sample_t * p_sample = &m_queue[(m_head + m_stats.depth) % PUBLISH_PIPELINE_QUEUE_SIZE];
+
+        p_sample->topic     = (uint8_t)(p_topic - mp_topics);
+        p_sample->seq       = m_seq++;
+        p_sample->queued_ms = queue_time_ms();
+        p_sample->len       = len;
+        memcpy(p_sample->payload, p_payload, len);
+
+        m_stats.depth++;
+        m_stats.queued++;
+        m_stats.max_depth = MAX(m_stats.max_depth, m_stats.depth);
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+void publish_pipeline_role_set(otDeviceRole role)
+{
+    bool     attached = (role >= OT_DEVICE_ROLE_CHILD);
+    uint32_t now      = app_clock_ms();
+
+    if (attached == m_attached)
+    {
+        return;
+    }
+
+    m_attached = attached;
+
+    if (attached)
+    {
+        uint32_t detached_ms = now - m_detached_at;
+
+        m_stats.detached_ms += detached_ms;
+        NRF_LOG_INFO("Attached after %d ms, %d samples queued.\r\n", detached_ms, m_stats.depth);
+    }
+    else
+    {
+        m_detached_at = now;
+        m_stats.detaches++;
+        NRF_LOG_INFO("Detached, publishing paused.\r\n");
+    }
+}
+
+
+/**@brief Removes the oldest sample of the backlog. */
+static void backlog_pop(const sample_t * p_sample, bool in_flash)
+{
+    if (in_flash)
+    {
+        flash_log_pop();
+    }
+    else
+    {
+        queue_pop(p_sample->seq);
+    }
+}
+
+
+/**@brief Copies the oldest sample of the backlog, looking at flash before RAM.
+ *
+ * @param[out] p_sample    Sample buffer.
+ * @param[out] p_in_flash  Whether the sample comes from the flash log.
+ */
+static bool backlog_peek(sample_t * p_sample, bool * p_in_flash)
+{
+#if PUBLISH_PIPELINE_FLASH_SPILL
+    uint16_t len = sizeof(*p_sample);
+
+    if (flash_log_peek(p_sample, &len) == NRF_SUCCESS)
+    {
+        *p_in_flash = true;
+        return true;
+    }
+#endif
+
+    *p_in_flash = false;
+    return queue_peek(p_sample);
+}
+
+
+uint32_t publish_pipeline_process(void)
+{
+    sample_t sample;
+    bool     in_flash;
+    uint32_t burst = 0;
+
+    if (!m_attached || !mqttsn_session_is_ready())
+    {
+        // Page erases stall the CPU, so flash is only written while the radio is not in use.
+        queue_spill();
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint16_t payload_max = publish_pipeline_payload_max();
+
+    while (backlog_peek(&sample, &in_flash))
+    {
+        if (in_flash && (sample.topic >= m_topic_count))
+        {
+            // Recovered from flash, but written with a different topic table.
+            flash_log_pop();
+            m_stats.spill_errors++;
+            continue;
+        }
+
+        const mqttsn_topics_entry_t * p_topic = &mp_topics[sample.topic];
+
+        if (!token_bucket_take(&m_drain_bucket, app_clock_ms()))
+        {
+            return token_bucket_wait_ms(&m_drain_bucket);
+        }
+
+        uint8_t   encoded[PAYLOAD_CODEC_BOUND(PUBLISH_PIPELINE_PAYLOAD_MAX)];
+        uint8_t * p_payload  = sample.payload;
+        uint16_t  len        = sample.len;
+        uint32_t  started_at = app_clock_stamp();
+        // Samples read back from flash may have been queued before a reset.
+        uint32_t  queue_ms   = in_flash ? LATENCY_TRACE_NO_STAMP : (app_clock_ms() - sample.queued_ms);
+
+        if (p_topic->compressed)
+        {
+            len = sizeof(encoded);
+            uint32_t err_code = payload_codec_compress(sample.payload, sample.len, encoded, &len);
+
+            if (err_code != NRF_SUCCESS)
+            {
+                // Sending the raw sample would be misread by the subscriber.
+                m_stats.send_errors++;
+                NRF_LOG_ERROR("Sample could not be encoded. Error code: 0x%x\r\n", err_code);
+                backlog_pop(&sample, in_flash);
+                continue;
+            }
+
+            p_payload = encoded;
+        }
+
+        uint16_t msg_id;
+        uint32_t err_code = mqttsn_client_publish(mp_client,
+                                                  p_topic->topic.topic_id,
+                                                  p_payload,
+                                                  len,
+                                                  &msg_id);
+        if (err_code != NRF_SUCCESS)
+        {
+            // The client packet queue is full; keep the sample and retry later.
+            m_stats.send_errors++;
+            APP_LOG_ERROR_LIMITED("PUBLISH message could not be sent. Error code: 0x%x\r\n", err_code);
+            return PUBLISH_PIPELINE_RETRY_MS;
+        }
+
+        mqttsn_rtt_request_sent(MQTTSN_RTT_REQUEST_PUBLISH, msg_id);
+
+        latency_trace_sent(msg_id, queue_ms, started_at, app_clock_stamp());
+
+        backlog_pop(&sample, in_flash);
+
+        if (p_topic->compressed)
+        {
+            m_stats.compressed++;
+            m_stats.compressed_in  += sample.len;
+            m_stats.compressed_out += len;
+        }
+
+        if (len > payload_max)
+        {
+            m_stats.fragmented++;
+        }
+
+        m_stats.sent++;
+        m_stats.max_burst = MAX(m_stats.max_burst, ++burst);
+    }
+
+    return APP_CLOCK_NO_DEADLINE;
+}
+
+
+bool publish_pipeline_is_attached(void)
+{
+    return m_attached;
+}
+
+
+uint16_t publish_pipeline_payload_max(void)
+{
+    static const mqttsn_remote_t unknown_gateway;                      // Not compressible, the worst case.
+
+    const mqttsn_remote_t * p_gateway = mqttsn_session_gateway_get();
+    mqttsn_mtu_budget_t     budget;
+
+    if (p_gateway == NULL)
+    {
+        p_gateway = &unknown_gateway;
+    }
+
+    mqttsn_mtu_budget_get(thread_ot_instance_get(),
+                          p_gateway->addr,
+                          mqttsn_gateways_hops_get(p_gateway),
+                          &budget);
+
+    return budget.payload_max;
+}
+
+
+bool publish_pipeline_is_empty(void)
+{
+#if PUBLISH_PIPELINE_FLASH_SPILL
+    if (!flash_log_is_empty())
+    {
+        return false;
+    }
+#endif
+
+    return m_stats.depth == 0;
+}
+
+
+const publish_pipeline_stats_t * publish_pipeline_stats_get(void)
+{
+    return &m_stats;
+}
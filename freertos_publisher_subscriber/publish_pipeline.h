@@ -0,0 +1,144 @@
+/** @file
+ *
+ * @defgroup publish_pipeline Publish pipeline
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Queues outbound samples and publishes them from the Thread stack task.
+ *
+ * @details Producers, including interrupt handlers, only copy their samples into the queue.
+ *          The queue is drained from the Thread stack task while the device is attached to a
+ *          Thread partition and the MQTT-SN session is ready. While detached, samples are kept
+ *          and no publish is attempted; after re-attaching the queue is flushed in one burst.
+ *
+ *          When the RAM queue fills up, the oldest samples are spilled to a flash log, so that
+ *          outages of minutes to hours do not lose data. The backlog is drained oldest first at a
+ *          rate limited by a token bucket, so that recovering nodes do not flood the network.
+ *
+ *          Samples of topics marked as compressed are encoded with the payload codec when they are
+ *          sent, so that interrupt handlers only pay for the copy.
+ */
+
+#ifndef PUBLISH_PIPELINE_H__
+#define PUBLISH_PIPELINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flash_log.h"
+#include "mqttsn_client.h"
+#include "mqttsn_topics.h"
+#include <openthread/thread.h>
+
+#ifndef PUBLISH_PIPELINE_QUEUE_SIZE
+#define PUBLISH_PIPELINE_QUEUE_SIZE     16                             /**< Number of samples kept in RAM. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_PAYLOAD_MAX
+#define PUBLISH_PIPELINE_PAYLOAD_MAX    128                            /**< Maximum payload length of a queued sample, before compression. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_DROP_NEWEST
+#define PUBLISH_PIPELINE_DROP_NEWEST    0                              /**< Overflow policy. 1 rejects new samples when full, 0 drops the oldest ones. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_FLASH_SPILL
+#define PUBLISH_PIPELINE_FLASH_SPILL    1                              /**< Spill samples to the flash log when the RAM queue fills up. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_SPILL_THRESHOLD
+#define PUBLISH_PIPELINE_SPILL_THRESHOLD (PUBLISH_PIPELINE_QUEUE_SIZE * 3 / 4) /**< RAM queue depth at which samples are spilled to flash. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_DRAIN_RATE
+#define PUBLISH_PIPELINE_DRAIN_RATE     10                             /**< Sustained publish rate in samples per second. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_DRAIN_BURST
+#define PUBLISH_PIPELINE_DRAIN_BURST    PUBLISH_PIPELINE_QUEUE_SIZE    /**< Samples which may be published back to back. */
+#endif
+
+#ifndef PUBLISH_PIPELINE_RETRY_MS
+#define PUBLISH_PIPELINE_RETRY_MS       100                            /**< Delay before retrying a publish rejected by the client in [ms]. */
+#endif
+
+/**@brief Publish pipeline statistics. */
+typedef struct
+{
+    uint32_t queued;                                                   /**< Samples accepted into the queue. */
+    uint32_t sent;                                                     /**< Samples handed over to the MQTT-SN client. */
+    uint32_t dropped;                                                  /**< Samples lost because the RAM queue was full. */
+    uint32_t spilled;                                                  /**< Samples moved from RAM to the flash log. */
+    uint32_t spill_errors;                                             /**< Samples lost because the flash log was full, or recovered with an unknown topic. */
+    uint32_t send_errors;                                              /**< Publish attempts rejected by the client. */
+    uint32_t fragmented;                                               /**< Samples sent which did not fit into a single frame. */
+    uint32_t compressed;                                               /**< Samples sent to compressed topics. */
+    uint32_t compressed_in;                                            /**< Payload bytes of samples sent to compressed topics. */
+    uint32_t compressed_out;                                           /**< Encoded bytes of samples sent to compressed topics. */
+    uint32_t max_burst;                                                /**< Largest number of samples sent in one drain pass. */
+    uint32_t detaches;                                                 /**< Number of times the device left the Thread partition. */
+    uint32_t detached_ms;                                              /**< Total time spent detached, excluding the current period. */
+    uint16_t depth;                                                    /**< Samples currently queued. */
+    uint16_t max_depth;                                                /**< Highest queue depth observed. */
+} publish_pipeline_stats_t;
+
+/**@brief Initializes the publish pipeline and recovers the samples left in the flash log.
+ *
+ * @details Samples refer to their topic by its index in the topic table, so that samples
+ *          recovered from flash after a reset are published to the same topic.
+ *
+ * @param[in] p_client     MQTT-SN client used for publishing.
+ * @param[in] p_topics     Topic table. All topics published to must be in this table.
+ * @param[in] topic_count  Number of topics in the table.
+ */
+void publish_pipeline_init(mqttsn_client_t * p_client, const mqttsn_topics_entry_t * p_topics, uint8_t topic_count);
+
+/**@brief Queues a sample. May be called from interrupt context.
+ *
+ * @details If the RAM queue is full, the oldest sample is dropped or the new one is rejected,
+ *          depending on @ref PUBLISH_PIPELINE_DROP_NEWEST.
+ *
+ * @param[in] p_topic    Normal topic to publish to, an entry of the topic table. The topic ID
+ *                       is resolved when the sample is sent. Predefined and short topics are
+ *                       published with @ref mqttsn_fastpath_post, as the MQTT-SN client only
+ *                       sends normal topic IDs.
+ *                       Samples to compressed topics are encoded when they are sent.
+ * @param[in] p_payload  Sample payload.
+ * @param[in] len        Payload length.
+ *
+ * @retval NRF_SUCCESS               If the sample has been queued.
+ * @retval NRF_ERROR_INVALID_PARAM   If the topic is not in the topic table or not a normal topic.
+ * @retval NRF_ERROR_NO_MEM          If the queue is full and new samples are rejected.
+ * @retval NRF_ERROR_INVALID_LENGTH  If the payload is longer than @ref PUBLISH_PIPELINE_PAYLOAD_MAX.
+ */
+uint32_t publish_pipeline_put(const mqttsn_topics_entry_t * p_topic, const uint8_t * p_payload, uint16_t len);
+
+/**@brief Updates the Thread device role used to gate publishing. */
+void publish_pipeline_role_set(otDeviceRole role);
+
+/**@brief Spills samples to flash while publishing is not possible, and publishes the backlog if the device is attached and the
+ *        session is ready.
+ *
+ * @return Milliseconds until the function has to be called again, or @ref APP_CLOCK_NO_DEADLINE.
+ */
+uint32_t publish_pipeline_process(void);
+
+/**@brief Returns true if the device is attached to a Thread partition. */
+bool publish_pipeline_is_attached(void);
+
+/**@brief Returns the largest payload which is sent to the current gateway in a single frame.
+ *
+ * @details Batching and aggregation should target this size to avoid 6LoWPAN fragmentation. If no
+ *          gateway is selected, the budget of the worst-case destination is returned.
+ */
+uint16_t publish_pipeline_payload_max(void);
+
+/**@brief Returns true if no sample is waiting to be published, neither in RAM nor in flash. */
+bool publish_pipeline_is_empty(void);
+
+/**@brief Returns publish pipeline statistics. */
+const publish_pipeline_stats_t * publish_pipeline_stats_get(void);
+
+#endif // PUBLISH_PIPELINE_H__
+
+/** @} */
@@ -0,0 +1,221 @@
+/** @file
+ *
+ * @brief Periodic acquisition of sensor samples into double-buffered blocks.
+ */
+
+#include "sampler.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "timers.h"
+
+#include "app_clock.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "publish_aggregator.h"
+#include "publish_pipeline.h"
+#include "sdk_errors.h"
+
+#define NRF_LOG_MODULE_NAME SAMPLER
+#include "app_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define NO_BLOCK              (-1)                                     /**< No block has been handed over. */
+#define SIM_PERIOD            64                                       /**< Period of the simulated triangle wave in samples. */
+#define SIM_AMPLITUDE         1000                                     /**< Peak value of the simulated triangle wave. */
+
+STATIC_ASSERT(SAMPLER_BLOCK_SIZE <= PUBLISH_PIPELINE_PAYLOAD_MAX);
+
+/**@brief Block of samples. */
+typedef struct
+{
+    uint16_t seq;                                                      /**< Block sequence number. */
+    int16_t  samples[SAMPLER_BLOCK_SAMPLES];                           /**< Samples. */
+} block_t;
+
+static sampler_init_t  m_config;                                       /**< Configuration. */
+static TimerHandle_t   m_timer;                                        /**< Sampling timer. */
+static uint32_t        m_period_us;                                    /**< Timer period, rounded to ticks, in [us]. */
+
+static block_t         m_blocks[2];                                    /**< Block being filled and block handed over. */
+static uint8_t         m_fill;                                         /**< Index of the block being filled. */
+static uint8_t         m_count;                                        /**< Samples in the block being filled. */
+static int8_t          m_ready;                                        /**< Index of the block handed over, or NO_BLOCK. */
+static uint16_t        m_seq;                                          /**< Sequence number of the next block. */
+static bool            m_stamped;                                      /**< Whether m_last_stamp is valid. */
+static uint32_t        m_last_stamp;                                   /**< Timestamp of the previous sample. */
+
+static sampler_stats_t m_stats;                                        /**< Sampler statistics. */
+
+
+/**@brief Measures the deviation of the sampling interval from the period. */
+static void jitter_update(void)
+{
+    uint32_t now = app_clock_stamp();
+
+    if (m_stamped)
+    {
+        uint32_t interval_us = app_clock_stamp_us(m_last_stamp, now);
+        uint32_t jitter_us   = (interval_us > m_period_us) ? (interval_us - m_period_us)
+                                                           : (m_period_us - interval_us);
+
+        m_stats.jitter_max_us    = MAX(m_stats.jitter_max_us, jitter_us);
+        m_stats.jitter_total_us += jitter_us;
+    }
+
+    m_stamped    = true;
+    m_last_stamp = now;
+}
+
+
+/**@brief Takes a sample. Runs in the timer daemon task. */
+static void timer_callback(TimerHandle_t timer)
+{
+    UNUSED_PARAMETER(timer);
+
+    jitter_update();
+
+    m_blocks[m_fill].samples[m_count++] = m_config.source();
+    m_stats.samples++;
+
+    if (m_count < SAMPLER_BLOCK_SAMPLES)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    if (m_ready != NO_BLOCK)
+    {
+        // The older block has not been queued yet; its buffer is refilled instead of waiting.
+        m_stats.dropped_blocks++;
+    }
+
+    m_blocks[m_fill].seq = m_seq++;
+    m_ready              = m_fill;
+    m_fill              ^= 1;
+
+    CRITICAL_REGION_EXIT();
+
+    m_count = 0;
+
+    if (m_config.ready_handler != NULL)
+    {
+        m_config.ready_handler();
+    }
+}
+
+
+uint32_t sampler_init(const sampler_init_t * p_init)
+{
+    TickType_t period = pdMS_TO_TICKS(p_init->period_ms);
+
+    if (period == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_config    = *p_init;
+    m_period_us = (uint32_t)(((uint64_t)period * 1000000) / configTICK_RATE_HZ);
+    m_ready     = NO_BLOCK;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    m_timer = xTimerCreate("Sampler", period, pdTRUE, NULL, timer_callback);
+
+    return (m_timer != NULL) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+
+uint32_t sampler_start(void)
+{
+    // The timer is stopped, so the daemon task does not touch the blocks.
+    m_count   = 0;
+    m_stamped = false;
+
+    return (xTimerStart(m_timer, 0) == pdPASS) ? NRF_SUCCESS : NRF_ERROR_BUSY;
+}
+
+
+void sampler_stop(void)
+{
+    UNUSED_RETURN_VALUE(xTimerStop(m_timer, portMAX_DELAY));
+}
+
+
+uint32_t sampler_process(void)
+{
+    block_t block;
+    bool    ready = false;
+
+    CRITICAL_REGION_ENTER();
+
+    if (m_ready != NO_BLOCK)
+    {
+        block   = m_blocks[m_ready];
+        m_ready = NO_BLOCK;
+        ready   = true;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    if (!ready)
+    {
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    // Aggregated topics publish a summary per window instead of the raw blocks.
+    if (publish_aggregator_put(m_config.p_topic, block.samples, SAMPLER_BLOCK_SAMPLES) == NRF_SUCCESS)
+    {
+        m_stats.blocks++;
+        return APP_CLOCK_NO_DEADLINE;
+    }
+
+    uint8_t payload[SAMPLER_BLOCK_SIZE];
+
+    payload[0] = (uint8_t)block.seq;
+    payload[1] = (uint8_t)(block.seq >> 8);
+
+    for (uint8_t i = 0; i < SAMPLER_BLOCK_SAMPLES; i++)
+    {
+        payload[2 + 2 * i]     = (uint8_t)block.samples[i];
+        payload[2 + 2 * i + 1] = (uint8_t)((uint16_t)block.samples[i] >> 8);
+    }
+
+    uint32_t err_code = publish_pipeline_put(m_config.p_topic, payload, sizeof(payload));
+
+    if (err_code == NRF_SUCCESS)
+    {
+        m_stats.blocks++;
+    }
+    else
+    {
+        m_stats.put_errors++;
+        NRF_LOG_ERROR("Block %d could not be queued. Error code: 0x%x\r\n", block.seq, err_code);
+    }
+
+    return APP_CLOCK_NO_DEADLINE;
+}
+
+
+int16_t sampler_source_simulated(void)
+{
+    static uint32_t phase;
+    static uint32_t noise = 1;
+
+    phase = (phase + 1) % SIM_PERIOD;
+    noise = noise * 1664525 + 1013904223;
+
+    int32_t triangle = (phase < SIM_PERIOD / 2) ? (int32_t)phase : (int32_t)(SIM_PERIOD - phase);
+
+    // Ramps from -SIM_AMPLITUDE to SIM_AMPLITUDE and back, with noise of -8 to 7.
+    return (int16_t)((triangle * 4 * SIM_AMPLITUDE) / SIM_PERIOD - SIM_AMPLITUDE + (int32_t)(noise >> 28) - 8);
+}
+
+
+const sampler_stats_t * sampler_stats_get(void)
+{
+    return (m_timer != NULL) ? &m_stats : NULL;
+}
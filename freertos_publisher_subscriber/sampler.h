@@ -0,0 +1,93 @@
+/** @file
+ *
+ * @defgroup sampler Periodic sampler
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Periodic acquisition of sensor samples into double-buffered blocks.
+ *
+ * @details A FreeRTOS software timer reads the sample source in the timer daemon task and fills
+ *          one of two blocks. A full block is handed over and acquisition continues in the other
+ *          one at once, so it never waits for the network. The Thread stack task queues the
+ *          handed over block in the publish pipeline from @ref sampler_process. If it has not
+ *          done so by the time the next block is full, the older block is dropped.
+ *
+ *          A block is published as a little-endian 16-bit block sequence number followed by the
+ *          samples as little-endian 16-bit signed integers, unless the topic is aggregated by the
+ *          publish aggregator.
+ */
+
+#ifndef SAMPLER_H__
+#define SAMPLER_H__
+
+#include <stdint.h>
+
+#include "mqttsn_topics.h"
+
+#ifndef SAMPLER_BLOCK_SAMPLES
+#define SAMPLER_BLOCK_SAMPLES      16                                  /**< Samples per block. */
+#endif
+
+#define SAMPLER_BLOCK_SIZE         (2 + 2 * SAMPLER_BLOCK_SAMPLES)     /**< Payload length of a block. */
+
+/**@brief Reads a sample. Called from the timer daemon task, must not block. */
+typedef int16_t (*sampler_source_t)(void);
+
+/**@brief Signals that a block is ready for @ref sampler_process. Called from the timer daemon task. */
+typedef void (*sampler_ready_handler_t)(void);
+
+/**@brief Sampler configuration. */
+typedef struct
+{
+    const mqttsn_topics_entry_t * p_topic;                             /**< Topic to publish the blocks to. */
+    uint32_t                      period_ms;                           /**< Sampling period in [ms]. */
+    sampler_source_t              source;                              /**< Sample source. */
+    sampler_ready_handler_t       ready_handler;                       /**< Wakes up the task calling @ref sampler_process. */
+} sampler_init_t;
+
+/**@brief Sampler statistics. */
+typedef struct
+{
+    uint32_t samples;                                                  /**< Samples taken. */
+    uint32_t blocks;                                                   /**< Blocks queued in the publish pipeline or aggregated. */
+    uint32_t dropped_blocks;                                           /**< Blocks overwritten before they were queued. */
+    uint32_t put_errors;                                               /**< Blocks rejected by the publish pipeline. */
+    uint32_t jitter_max_us;                                            /**< Largest deviation of a sampling interval from the period. */
+    uint64_t jitter_total_us;                                          /**< Sum of the deviations of all sampling intervals. */
+} sampler_stats_t;
+
+/**@brief Creates the sampling timer.
+ *
+ * @param[in] p_init  Configuration.
+ *
+ * @retval NRF_SUCCESS              If the sampler has been initialized.
+ * @retval NRF_ERROR_INVALID_PARAM  If the period is shorter than a FreeRTOS tick.
+ * @retval NRF_ERROR_NO_MEM         If the timer could not be allocated.
+ */
+uint32_t sampler_init(const sampler_init_t * p_init);
+
+/**@brief Starts sampling into an empty block.
+ *
+ * @retval NRF_SUCCESS     If sampling has started.
+ * @retval NRF_ERROR_BUSY  If the timer command queue is full.
+ */
+uint32_t sampler_start(void);
+
+/**@brief Stops sampling. Samples of the incomplete block are discarded on the next start. */
+void sampler_stop(void);
+
+/**@brief Queues a full block in the publish pipeline, or aggregates it if the topic has an aggregator.
+ *
+ * @return Always @ref APP_CLOCK_NO_DEADLINE, the ready handler signals new blocks.
+ */
+uint32_t sampler_process(void);
+
+/**@brief Simulated source: a triangle wave with a period of 64 samples plus noise. */
+int16_t sampler_source_simulated(void);
+
+/**@brief Returns sampler statistics, or NULL if the sampler has not been initialized. */
+const sampler_stats_t * sampler_stats_get(void);
+
+#endif // SAMPLER_H__
+
+/** @} */
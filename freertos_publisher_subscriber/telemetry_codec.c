@@ -0,0 +1,293 @@
+/** @file
+ *
+ * @brief Delta and zig-zag varint encoding of integer sensor samples.
+ */
+
+#include "telemetry_codec.h"
+
+#include <string.h>
+
+#include "nrf_error.h"
+
+#define HEADER_SIZE          2                                         /**< Size of the message header. */
+#define HEADER_KEYFRAME      0x80                                      /**< Keyframe flag of the first header byte. */
+#define HEADER_DISTANCE_POS  4                                         /**< Position of the reference distance in the first header byte. */
+#define HEADER_DISTANCE_MASK 0x07                                      /**< Mask of the reference distance. */
+#define HEADER_SEQ_HIGH_MASK 0x0F                                      /**< Mask of the upper sequence number bits in the first header byte. */
+#define HEADER_SEQ_MASK      0x0FFF                                    /**< Mask of the sequence number. */
+
+#define VARINT_MORE          0x80                                      /**< Continuation flag of a varint byte. */
+#define VARINT_SIZE_MAX      5                                         /**< Largest size of a 32-bit varint. */
+
+#if (TELEMETRY_CODEC_HISTORY - 1) > HEADER_DISTANCE_MASK
+#error "The reference distance does not fit into the header."
+#endif
+
+#if ((HEADER_SEQ_MASK + 1) % TELEMETRY_CODEC_HISTORY) != 0
+#error "TELEMETRY_CODEC_HISTORY must divide the sequence number range."
+#endif
+
+#if TELEMETRY_CODEC_KEYFRAME_INTERVAL > UINT8_MAX
+#error "TELEMETRY_CODEC_KEYFRAME_INTERVAL must fit into 8 bits."
+#endif
+
+
+static uint32_t zigzag_encode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+static int32_t zigzag_decode(uint32_t value)
+{
+    return (int32_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+
+static uint16_t varint_write(uint32_t value, uint8_t * p_out)
+{
+    uint16_t len = 0;
+
+    while (value >= VARINT_MORE)
+    {
+        p_out[len++] = (uint8_t)(value | VARINT_MORE);
+        value      >>= 7;
+    }
+
+    p_out[len++] = (uint8_t)value;
+
+    return len;
+}
+
+
+/**@brief Reads a varint. Returns its length, or 0 if it is truncated or too long. */
+static uint16_t varint_read(const uint8_t * p_in, uint16_t len, uint32_t * p_value)
+{
+    uint32_t value = 0;
+
+    for (uint16_t i = 0; (i < len) && (i < VARINT_SIZE_MAX); i++)
+    {
+        value |= (uint32_t)(p_in[i] & ~VARINT_MORE) << (7 * i);
+
+        if ((p_in[i] & VARINT_MORE) == 0)
+        {
+            *p_value = value;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+void telemetry_codec_encoder_init(telemetry_codec_encoder_t * p_encoder, uint8_t channels)
+{
+    memset(p_encoder, 0, sizeof(*p_encoder));
+    p_encoder->channels = channels;
+}
+
+
+uint32_t telemetry_codec_encode(telemetry_codec_encoder_t * p_encoder,
+                                const int32_t             * p_values,
+                                uint8_t                   * p_out,
+                                uint16_t                  * p_len)
+{
+    if (*p_len < TELEMETRY_CODEC_SIZE_MAX(p_encoder->channels))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    telemetry_codec_sample_t * p_reference = &p_encoder->reference;
+    uint32_t                   distance    = p_encoder->seq - p_reference->seq;
+    bool                       keyframe    = !p_reference->valid ||
+                                             (distance >= TELEMETRY_CODEC_HISTORY) ||
+                                             (p_encoder->since_keyframe >= TELEMETRY_CODEC_KEYFRAME_INTERVAL);
+    uint16_t                   len         = HEADER_SIZE;
+
+    if (keyframe)
+    {
+        p_out[0] = HEADER_KEYFRAME;
+        p_encoder->since_keyframe = 0;
+        p_encoder->keyframes++;
+    }
+    else
+    {
+        p_out[0] = (uint8_t)(distance << HEADER_DISTANCE_POS);
+        p_encoder->deltas++;
+    }
+
+    p_out[0] |= (uint8_t)((p_encoder->seq >> 8) & HEADER_SEQ_HIGH_MASK);
+    p_out[1]  = (uint8_t)p_encoder->seq;
+
+    for (uint8_t i = 0; i < p_encoder->channels; i++)
+    {
+        // Wrapping subtraction, the decoder adds the difference back the same way.
+        int32_t value = keyframe ? p_values[i] : (int32_t)((uint32_t)p_values[i] - (uint32_t)p_reference->values[i]);
+
+        len += varint_write(zigzag_encode(value), &p_out[len]);
+    }
+
+    telemetry_codec_sample_t * p_pending = &p_encoder->pending[p_encoder->seq % TELEMETRY_CODEC_HISTORY];
+
+    p_pending->valid = false;
+    p_pending->seq   = p_encoder->seq;
+    memcpy(p_pending->values, p_values, p_encoder->channels * sizeof(int32_t));
+
+    p_encoder->seq++;
+    p_encoder->since_keyframe++;
+    *p_len = len;
+
+    return NRF_SUCCESS;
+}
+
+
+void telemetry_codec_sent(telemetry_codec_encoder_t * p_encoder, uint16_t msg_id)
+{
+    uint8_t index = (p_encoder->seq - 1) % TELEMETRY_CODEC_HISTORY;
+
+    p_encoder->pending[index].valid = true;
+    p_encoder->msg_ids[index]       = msg_id;
+}
+
+
+void telemetry_codec_acked(telemetry_codec_encoder_t * p_encoder, uint16_t msg_id)
+{
+    for (uint8_t i = 0; i < TELEMETRY_CODEC_HISTORY; i++)
+    {
+        telemetry_codec_sample_t * p_pending = &p_encoder->pending[i];
+
+        if (!p_pending->valid || (p_encoder->msg_ids[i] != msg_id))
+        {
+            continue;
+        }
+
+        // Acknowledgements may arrive out of order; keep the newest reference.
+        if (!p_encoder->reference.valid || ((int32_t)(p_pending->seq - p_encoder->reference.seq) > 0))
+        {
+            p_encoder->reference = *p_pending;
+        }
+
+        p_pending->valid = false;
+        return;
+    }
+}
+
+
+void telemetry_codec_keyframe_request(telemetry_codec_encoder_t * p_encoder)
+{
+    p_encoder->since_keyframe = TELEMETRY_CODEC_KEYFRAME_INTERVAL;
+}
+
+
+void telemetry_codec_decoder_init(telemetry_codec_decoder_t * p_decoder, uint8_t channels)
+{
+    memset(p_decoder, 0, sizeof(*p_decoder));
+    p_decoder->channels = channels;
+}
+
+
+/**@brief Forgets the samples of the sequence numbers up to @p seq which have not been decoded. */
+static void history_gap_clear(telemetry_codec_decoder_t * p_decoder, uint16_t seq)
+{
+    // Set again once the message has been decoded.
+    p_decoder->history[seq % TELEMETRY_CODEC_HISTORY].valid = false;
+
+    if (!p_decoder->started)
+    {
+        p_decoder->started  = true;
+        p_decoder->last_seq = seq;
+        return;
+    }
+
+    uint16_t gap = (seq - p_decoder->last_seq - 1) & HEADER_SEQ_MASK;
+
+    if (seq == p_decoder->last_seq)
+    {
+        // Duplicate.
+        return;
+    }
+
+    if (gap > TELEMETRY_CODEC_HISTORY)
+    {
+        gap = TELEMETRY_CODEC_HISTORY;
+    }
+
+    for (uint16_t i = 0; i < gap; i++)
+    {
+        p_decoder->history[(p_decoder->last_seq + 1 + i) % TELEMETRY_CODEC_HISTORY].valid = false;
+    }
+
+    p_decoder->last_seq = seq;
+}
+
+
+uint32_t telemetry_codec_decode(telemetry_codec_decoder_t * p_decoder,
+                                const uint8_t             * p_in,
+                                uint16_t                    len,
+                                int32_t                   * p_values)
+{
+    if (len < HEADER_SIZE)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    uint8_t                          header      = p_in[0];
+    uint16_t                         seq         = ((uint16_t)(header & HEADER_SEQ_HIGH_MASK) << 8) | p_in[1];
+    bool                             keyframe    = (header & HEADER_KEYFRAME) != 0;
+    uint8_t                          distance    = (header >> HEADER_DISTANCE_POS) & HEADER_DISTANCE_MASK;
+    const telemetry_codec_sample_t * p_reference = NULL;
+
+    history_gap_clear(p_decoder, seq);
+
+    if (!keyframe)
+    {
+        uint16_t ref_seq = (seq - distance) & HEADER_SEQ_MASK;
+
+        if (distance == 0)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+
+        p_reference = &p_decoder->history[ref_seq % TELEMETRY_CODEC_HISTORY];
+
+        if (!p_reference->valid || (p_reference->seq != ref_seq))
+        {
+            p_decoder->missing_reference++;
+            return NRF_ERROR_NOT_FOUND;
+        }
+    }
+
+    uint16_t pos = HEADER_SIZE;
+
+    for (uint8_t i = 0; i < p_decoder->channels; i++)
+    {
+        uint32_t value;
+        uint16_t value_len = varint_read(&p_in[pos], len - pos, &value);
+
+        if (value_len == 0)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+
+        pos        += value_len;
+        p_values[i] = zigzag_decode(value);
+
+        if (p_reference != NULL)
+        {
+            p_values[i] = (int32_t)((uint32_t)p_reference->values[i] + (uint32_t)p_values[i]);
+        }
+    }
+
+    if (pos != len)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    telemetry_codec_sample_t * p_entry = &p_decoder->history[seq % TELEMETRY_CODEC_HISTORY];
+
+    p_entry->valid = true;
+    p_entry->seq   = seq;
+    memcpy(p_entry->values, p_values, p_decoder->channels * sizeof(int32_t));
+
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/** @file
+ *
+ * @defgroup telemetry_codec Telemetry codec
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Delta and zig-zag varint encoding of integer sensor samples.
+ *
+ * @details A sample is a fixed number of signed 32-bit channels. Keyframes carry the values
+ *          themselves, other messages carry the difference to the last sample acknowledged by the
+ *          gateway. Values and differences are zig-zag mapped and written as base-128 varints, so
+ *          slowly changing channels take a single byte each.
+ *
+ *          Every message starts with a two byte header holding the keyframe flag, the distance to
+ *          the reference sample and a 12-bit sequence number. The decoder keeps the last
+ *          @ref TELEMETRY_CODEC_HISTORY samples, so a delta can be decoded as long as its reference
+ *          has been received. Samples of skipped sequence numbers are forgotten, so that a lost
+ *          reference is not confused with an older sample of the same sequence number. This holds
+ *          for gaps of up to 4095 messages; a 4-bit sequence number would alias after 16.
+ *          Keyframes are sent periodically and whenever the reference is too old, which bounds the
+ *          time a subscriber needs to resynchronize.
+ *
+ * @note The size of typical streams is measured on the host, see tools/telemetry_codec_bench.c.
+ *
+ * @note The encoder and decoder are not reentrant. Encoding from an interrupt handler requires
+ *       the acknowledgement to be passed in a critical region.
+ */
+
+#ifndef TELEMETRY_CODEC_H__
+#define TELEMETRY_CODEC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef TELEMETRY_CODEC_CHANNELS_MAX
+#define TELEMETRY_CODEC_CHANNELS_MAX      4                            /**< Largest number of channels of a sample. */
+#endif
+
+#ifndef TELEMETRY_CODEC_KEYFRAME_INTERVAL
+#define TELEMETRY_CODEC_KEYFRAME_INTERVAL 16                           /**< Messages between keyframes. */
+#endif
+
+#define TELEMETRY_CODEC_HISTORY           8                            /**< Samples kept by the decoder. Deltas reference at most HISTORY - 1 messages back. */
+
+#define TELEMETRY_CODEC_SIZE_MAX(channels) (2 + 5 * (channels))        /**< Largest encoded size of a sample. */
+
+/**@brief A sample and its sequence number. */
+typedef struct
+{
+    bool     valid;                                                    /**< Whether the entry holds a sample. */
+    uint32_t seq;                                                      /**< Sequence number. */
+    int32_t  values[TELEMETRY_CODEC_CHANNELS_MAX];                     /**< Channel values. */
+} telemetry_codec_sample_t;
+
+/**@brief Encoder state. */
+typedef struct
+{
+    uint8_t                  channels;                                 /**< Number of channels. */
+    uint32_t                 seq;                                      /**< Sequence number of the next message. */
+    uint8_t                  since_keyframe;                           /**< Messages since the last keyframe. */
+    telemetry_codec_sample_t reference;                                /**< Last acknowledged sample. */
+    telemetry_codec_sample_t pending[TELEMETRY_CODEC_HISTORY];         /**< Samples waiting for acknowledgement, by sequence number. */
+    uint16_t                 msg_ids[TELEMETRY_CODEC_HISTORY];         /**< Message IDs of the pending samples. */
+    uint32_t                 keyframes;                                /**< Keyframes encoded. */
+    uint32_t                 deltas;                                   /**< Delta messages encoded. */
+} telemetry_codec_encoder_t;
+
+/**@brief Decoder state. */
+typedef struct
+{
+    uint8_t                  channels;                                 /**< Number of channels. */
+    telemetry_codec_sample_t history[TELEMETRY_CODEC_HISTORY];         /**< Recently decoded samples, by sequence number. */
+    bool                     started;                                  /**< Whether a message has been received. */
+    uint16_t                 last_seq;                                 /**< Sequence number of the last message received. */
+    uint32_t                 missing_reference;                        /**< Deltas dropped because their reference was not received. */
+} telemetry_codec_decoder_t;
+
+/**@brief Initializes an encoder.
+ *
+ * @param[out] p_encoder  Encoder.
+ * @param[in]  channels   Number of channels, at most @ref TELEMETRY_CODEC_CHANNELS_MAX.
+ */
+void telemetry_codec_encoder_init(telemetry_codec_encoder_t * p_encoder, uint8_t channels);
+
+/**@brief Encodes a sample.
+ *
+ * @param[in]     p_encoder  Encoder.
+ * @param[in]     p_values   Channel values.
+ * @param[out]    p_out      Buffer for the message.
+ * @param[in,out] p_len      In: buffer size, at least @ref TELEMETRY_CODEC_SIZE_MAX. Out: message length.
+ *
+ * @retval NRF_SUCCESS       If the sample has been encoded.
+ * @retval NRF_ERROR_NO_MEM  If the buffer is too small.
+ */
+uint32_t telemetry_codec_encode(telemetry_codec_encoder_t * p_encoder,
+                                const int32_t             * p_values,
+                                uint8_t                   * p_out,
+                                uint16_t                  * p_len);
+
+/**@brief Associates the message encoded last with the message ID of its PUBLISH. */
+void telemetry_codec_sent(telemetry_codec_encoder_t * p_encoder, uint16_t msg_id);
+
+/**@brief Makes the sample published with the given message ID the reference of further deltas.
+ *
+ * @details To be called on @ref MQTTSN_EVENT_PUBLISHED. Unknown message IDs are ignored.
+ */
+void telemetry_codec_acked(telemetry_codec_encoder_t * p_encoder, uint16_t msg_id);
+
+/**@brief Forces the next message to be a keyframe, e.g. after the session has been re-established. */
+void telemetry_codec_keyframe_request(telemetry_codec_encoder_t * p_encoder);
+
+/**@brief Initializes a decoder.
+ *
+ * @param[out] p_decoder  Decoder.
+ * @param[in]  channels   Number of channels, at most @ref TELEMETRY_CODEC_CHANNELS_MAX.
+ */
+void telemetry_codec_decoder_init(telemetry_codec_decoder_t * p_decoder, uint8_t channels);
+
+/**@brief Decodes a message.
+ *
+ * @param[in]  p_decoder  Decoder.
+ * @param[in]  p_in       Message.
+ * @param[in]  len        Message length.
+ * @param[out] p_values   Channel values.
+ *
+ * @retval NRF_SUCCESS             If the sample has been decoded.
+ * @retval NRF_ERROR_NOT_FOUND     If the reference of a delta has not been received. The next
+ *                                 keyframe resynchronizes the decoder.
+ * @retval NRF_ERROR_INVALID_DATA  If the message is malformed.
+ */
+uint32_t telemetry_codec_decode(telemetry_codec_decoder_t * p_decoder,
+                                const uint8_t             * p_in,
+                                uint16_t                    len,
+                                int32_t                   * p_values);
+
+#endif // TELEMETRY_CODEC_H__
+
+/** @} */
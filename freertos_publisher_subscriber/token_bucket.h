@@ -0,0 +1,103 @@
+/** @file
+ *
+ * @defgroup token_bucket Token bucket
+ * @{
+ * @ingroup freertos_coap_server_example
+ *
+ * @brief Token bucket rate limiter.
+ *
+ * @details Tokens are kept in thousandths so that rates below one token per millisecond are
+ *          refilled without rounding loss. The caller provides the current time and is
+ *          responsible for serializing access to the bucket.
+ */
+
+#ifndef TOKEN_BUCKET_H__
+#define TOKEN_BUCKET_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TOKEN_BUCKET_SCALE    1000                                     /**< Fractional token resolution. */
+
+/**@brief Token bucket state. */
+typedef struct
+{
+    uint32_t rate;                                                     /**< Refill rate in tokens per second. */
+    uint32_t capacity;                                                 /**< Maximum burst in tokens. */
+    uint32_t tokens;                                                   /**< Available tokens, scaled by @ref TOKEN_BUCKET_SCALE. */
+    uint32_t updated_at;                                               /**< Time of the last refill in milliseconds. */
+} token_bucket_t;
+
+/**@brief Initializes a full token bucket.
+ *
+ * @param[out] p_bucket  Bucket to initialize.
+ * @param[in]  rate      Refill rate in tokens per second.
+ * @param[in]  capacity  Maximum burst in tokens.
+ * @param[in]  now       Current time in milliseconds.
+ */
+static inline void token_bucket_init(token_bucket_t * p_bucket, uint32_t rate, uint32_t capacity, uint32_t now)
+{
+    p_bucket->rate       = rate;
+    p_bucket->capacity   = capacity;
+    p_bucket->tokens     = capacity * TOKEN_BUCKET_SCALE;
+    p_bucket->updated_at = now;
+}
+
+
+/**@brief Adds the tokens accumulated since the last update. */
+static inline void token_bucket_refill(token_bucket_t * p_bucket, uint32_t now)
+{
+    uint32_t elapsed = now - p_bucket->updated_at;
+    uint32_t limit   = p_bucket->capacity * TOKEN_BUCKET_SCALE;
+
+    // Milliseconds times tokens per second gives thousandths of a token.
+    if ((p_bucket->rate != 0) && (elapsed >= (limit - p_bucket->tokens) / p_bucket->rate))
+    {
+        p_bucket->tokens = limit;
+    }
+    else
+    {
+        p_bucket->tokens += elapsed * p_bucket->rate;
+    }
+
+    p_bucket->updated_at = now;
+}
+
+
+/**@brief Takes a token if one is available.
+ *
+ * @return True if the token has been taken, false if the rate is exceeded.
+ */
+static inline bool token_bucket_take(token_bucket_t * p_bucket, uint32_t now)
+{
+    token_bucket_refill(p_bucket, now);
+
+    if (p_bucket->tokens < TOKEN_BUCKET_SCALE)
+    {
+        return false;
+    }
+
+    p_bucket->tokens -= TOKEN_BUCKET_SCALE;
+    return true;
+}
+
+
+/**@brief Returns milliseconds until the next token becomes available. */
+static inline uint32_t token_bucket_wait_ms(const token_bucket_t * p_bucket)
+{
+    if (p_bucket->tokens >= TOKEN_BUCKET_SCALE)
+    {
+        return 0;
+    }
+
+    if (p_bucket->rate == 0)
+    {
+        return UINT32_MAX;
+    }
+
+    return (TOKEN_BUCKET_SCALE - p_bucket->tokens + p_bucket->rate - 1) / p_bucket->rate;
+}
+
+#endif // TOKEN_BUCKET_H__
+
+/** @} */
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Decoder of the binary log written with APP_LOG_BINARY set, see app_log.h.
+
+The format strings are stored in the .log_dict section of the ELF file. Extract them after the
+build (the log_dict target of the armgcc Makefile does this) and decode a capture of the RTT
+channel:
+
+    app_log_decode.py extract _build/nrf52840_xxaa.out _build/nrf52840_xxaa.logdict
+    JLinkRTTLogger -Device NRF52840_XXAA -If SWD -Speed 4000 -RTTChannel 1 app_log.bin
+    app_log_decode.py decode _build/nrf52840_xxaa.logdict app_log.bin --elf _build/nrf52840_xxaa.out
+
+The capture is read from standard input if no file is given, so a live stream can be piped in.
+%s arguments are shown as addresses unless the ELF file is given to look them up.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+DICT_SECTION = '.log_dict'
+ID_STRING = 0xFFFF
+ID_DROPPED = 0xFFFE
+HEADER = struct.Struct('<HB3s')
+STAMP_HZ = 32768
+STAMP_WRAP = 1 << 24
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+
+class Elf:
+    """Minimal reader of the section headers of a little-endian ELF32 file."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError('%s is not a little-endian ELF32 file' % path)
+
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x2E)
+
+        headers = [struct.unpack_from('<IIIIIIIIII', self.data, shoff + i * shentsize) for i in range(shnum)]
+        names = headers[shstrndx]
+
+        self.sections = []
+        for name, type_, flags, addr, offset, size, _, _, _, _ in headers:
+            end = self.data.index(b'\0', names[4] + name)
+            self.sections.append({
+                'name': self.data[names[4] + name:end].decode(),
+                'type': type_,
+                'flags': flags,
+                'addr': addr,
+                'content': self.data[offset:offset + size] if type_ != SHT_NOBITS else b'',
+            })
+
+    def section(self, name):
+        for section in self.sections:
+            if section['name'] == name:
+                return section
+        return None
+
+    def string_at(self, addr):
+        """Returns the constant string at an address, or None if it is not in the file."""
+        for section in self.sections:
+            content = section['content']
+            if (section['flags'] & SHF_ALLOC) and section['addr'] <= addr < section['addr'] + len(content):
+                start = addr - section['addr']
+                end = content.find(b'\0', start)
+                return content[start:end if end >= 0 else len(content)].decode('latin-1')
+        return None
+
+
+def extract(elf_path):
+    """Returns the format strings of the dictionary by record ID.
+
+    The firmware writes the lower 16 bits of the address of the format string, so the IDs are
+    derived from the section address rather than from the offset within the section.
+    """
+    section = Elf(elf_path).section(DICT_SECTION)
+    if section is None:
+        raise ValueError('%s has no %s section, build with APP_LOG_BINARY=1' % (elf_path, DICT_SECTION))
+
+    formats = {}
+    base = section['addr']
+    content = section['content']
+    offset = 0
+    while offset < len(content):
+        if content[offset] == 0:
+            # Alignment padding between the strings.
+            offset += 1
+            continue
+        end = content.index(b'\0', offset)
+        formats[(base + offset) & 0xFFFF] = content[offset:end].decode('latin-1')
+        offset = end + 1
+    return formats
+
+
+def format_entry(fmt, args, elf):
+    """Formats a C format string with the 32-bit arguments of a record."""
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else 0
+
+    def convert(match):
+        flags, width, precision, length, conv = match.groups()
+        if conv == '%':
+            return '%'
+        if width == '*':
+            width = str(take())
+        spec = '%' + flags + (width or '') + ('.' + precision if precision else '')
+
+        value = take()
+        if length == 'll':
+            value |= take() << 32
+        if conv in 'di':
+            bits = 64 if length == 'll' else 32
+            value = value - (1 << bits) if value >> (bits - 1) else value
+            return (spec + 'd') % value
+        if conv == 'u':
+            return (spec + 'd') % value
+        if conv in 'oxX':
+            return (spec + conv) % value
+        if conv == 'c':
+            return (spec + 'c') % chr(value & 0xFF)
+        if conv == 'p':
+            return '0x%08x' % value
+        string = elf.string_at(value) if elf else None
+        return (spec + 's') % (string if string is not None else '<0x%08x>' % value)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def records(stream):
+    """Yields the records of a capture as (id, count, stamp, data) tuples."""
+    while True:
+        header = stream.read(HEADER.size)
+        if len(header) < HEADER.size:
+            return
+        id_, count, stamp = HEADER.unpack(header)
+        size = count if id_ == ID_STRING else 4 * count
+        data = stream.read(size)
+        if len(data) < size:
+            return
+        yield id_, count, int.from_bytes(stamp, 'little'), data
+
+
+def decode(formats, stream, out, elf):
+    time = 0
+    last_stamp = None
+
+    for id_, count, stamp, data in records(stream):
+        # Timestamps wrap after 512 s; longer gaps between records are not detected.
+        if last_stamp is not None:
+            time += (stamp - last_stamp) % STAMP_WRAP
+        last_stamp = stamp
+        prefix = '[%11.6f] ' % (time / STAMP_HZ)
+
+        if id_ == ID_STRING:
+            out.write(prefix + data.decode('latin-1') + '\n')
+            continue
+
+        args = struct.unpack('<%dI' % count, data)
+
+        if id_ == ID_DROPPED:
+            out.write(prefix + '<%d records dropped>\n' % args[0])
+        elif id_ not in formats:
+            out.write(prefix + '<unknown entry 0x%04x, dictionary out of date?>\n' % id_)
+        else:
+            level, module, fmt = formats[id_].split(':', 2)
+            text = format_entry(fmt, args, elf).rstrip('\r\n')
+            out.write(prefix + '<%s> %s: %s\n' % (level, module, text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    extract_parser = commands.add_parser('extract', help='extract the dictionary from an ELF file')
+    extract_parser.add_argument('elf')
+    extract_parser.add_argument('dictionary')
+
+    decode_parser = commands.add_parser('decode', help='decode a capture of the RTT channel')
+    decode_parser.add_argument('dictionary')
+    decode_parser.add_argument('capture', nargs='?')
+    decode_parser.add_argument('--elf', help='ELF file to look up %%s arguments in')
+
+    args = parser.parse_args()
+
+    if args.command == 'extract':
+        formats = extract(args.elf)
+        with open(args.dictionary, 'w') as f:
+            json.dump({'%d' % id_: fmt for id_, fmt in formats.items()}, f, indent=1, sort_keys=True)
+        return
+
+    with open(args.dictionary) as f:
+        formats = {int(id_): fmt for id_, fmt in json.load(f).items()}
+
+    elf = Elf(args.elf) if args.elf else None
+
+    if args.capture:
+        with open(args.capture, 'rb') as stream:
+            decode(formats, stream, sys.stdout, elf)
+    else:
+        decode(formats, sys.stdin.buffer, sys.stdout, elf)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,183 @@
+/** @file
+ *
+ * @brief Host benchmark of the payload codec.
+ *
+ * @details Reports the compression ratio and the CPU time per input byte for telemetry and log
+ *          payloads of the sizes published by the application. Build and run from this directory:
+ *
+ *          cc -O2 -I.. -I$SDK_ROOT/components/drivers_nrf/nrf_soc_nosd \
+ *             ../payload_codec.c payload_codec_bench.c -o payload_codec_bench
+ *          ./payload_codec_bench
+ *
+ *          On x86 the time is given in TSC cycles, elsewhere in nanoseconds. Host figures only
+ *          allow comparing settings; multiply by the ratio of a known Cortex-M4 measurement to
+ *          estimate the cost on the device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf_error.h"
+#include "payload_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIME_UNIT "cycles"
+#endif
+
+#define CORPUS_SIZE    16384                                           /**< Bytes of generated data per data set. */
+#define ROUNDS         20                                              /**< Passes over a data set per measurement. */
+
+static uint8_t m_corpus[CORPUS_SIZE];
+static uint16_t m_corpus_len;
+
+
+static uint64_t time_now(void)
+{
+#ifdef TIME_UNIT
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+/**@brief Generates button and sensor telemetry as published by the application. */
+static void telemetry_generate(void)
+{
+    uint32_t t = 215;
+    uint32_t h = 40;
+    uint32_t p = 1013;
+    uint32_t n = 0;
+
+    m_corpus_len = 0;
+
+    while (m_corpus_len < CORPUS_SIZE - 64)
+    {
+        t += (rand() % 3) - 1;
+        h += (rand() % 3) - 1;
+        p += (rand() % 3) - 1;
+
+        if (n++ % 4)
+        {
+            m_corpus_len += sprintf((char *)&m_corpus[m_corpus_len],
+                                    "{\"t\":%u.%u,\"h\":%u,\"p\":%u,\"n\":%u}",
+                                    t / 10, t % 10, h, p, n);
+        }
+        else
+        {
+            m_corpus_len += sprintf((char *)&m_corpus[m_corpus_len], "publish msg");
+        }
+    }
+}
+
+
+/**@brief Generates log lines in the format of the NRF_LOG text backend. */
+static void log_generate(void)
+{
+    static const char * const lines[] =
+    {
+        "<info> PIPELINE: Attached after %u ms, %u samples queued.\r\n",
+        "<info> SESSION: Gateway %u selected, cost %u ms.\r\n",
+        "<info> app: MQTT-SN event: Client has successfully published content.\r\n",
+        "<warning> KEEPALIVE: Keep-alive duration reduced to %u s, %u losses.\r\n",
+        "<info> POLL: Poll period %u ms after %u idle polls.\r\n",
+    };
+
+    m_corpus_len = 0;
+
+    while (m_corpus_len < CORPUS_SIZE - 128)
+    {
+        m_corpus_len += sprintf((char *)&m_corpus[m_corpus_len],
+                                lines[rand() % (sizeof(lines) / sizeof(lines[0]))],
+                                rand() % 5000, rand() % 16);
+    }
+}
+
+
+/**@brief Compresses the corpus in messages of the given size and prints the results. */
+static int corpus_measure(const char * p_name, uint16_t message_size)
+{
+    static uint8_t encoded[PAYLOAD_CODEC_BOUND(4096)];
+    static uint8_t decoded[4096];
+    uint32_t       in_total  = 0;
+    uint32_t       out_total = 0;
+    uint64_t       enc_time  = 0;
+    uint64_t       dec_time  = 0;
+
+    for (uint32_t round = 0; round < ROUNDS; round++)
+    {
+        for (uint16_t pos = 0; pos + message_size <= m_corpus_len; pos += message_size)
+        {
+            uint16_t encoded_len = sizeof(encoded);
+            uint16_t decoded_len = sizeof(decoded);
+            uint64_t start       = time_now();
+
+            if (payload_codec_compress(&m_corpus[pos], message_size, encoded, &encoded_len) != NRF_SUCCESS)
+            {
+                return -1;
+            }
+
+            uint64_t middle = time_now();
+
+            if ((payload_codec_decompress(encoded, encoded_len, decoded, &decoded_len) != NRF_SUCCESS) ||
+                (decoded_len != message_size) ||
+                (memcmp(decoded, &m_corpus[pos], message_size) != 0))
+            {
+                fprintf(stderr, "%s: round trip failed at %u\n", p_name, pos);
+                return -1;
+            }
+
+            enc_time  += middle - start;
+            dec_time  += time_now() - middle;
+            in_total  += message_size;
+            out_total += encoded_len;
+        }
+    }
+
+    printf("%-10s %5u %7.3f %10.1f %10.1f\n",
+           p_name,
+           message_size,
+           (double)out_total / in_total,
+           (double)enc_time / in_total,
+           (double)dec_time / in_total);
+
+    return 0;
+}
+
+
+int main(void)
+{
+    static const uint16_t sizes[] = {12, 24, 48, 96, 256, 1024};
+    int                   result  = 0;
+
+#ifndef TIME_UNIT
+#define TIME_UNIT "ns"
+#endif
+
+    printf("window %u bytes, time in %s per input byte\n", PAYLOAD_CODEC_WINDOW, TIME_UNIT);
+    printf("%-10s %5s %7s %10s %10s\n", "data", "size", "ratio", "compress", "decompress");
+
+    srand(1);
+    telemetry_generate();
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        result |= corpus_measure("telemetry", sizes[i]);
+    }
+
+    srand(1);
+    log_generate();
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        result |= corpus_measure("log", sizes[i]);
+    }
+
+    return result ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Compares the flash and RAM use of two builds per object file.
+
+Used by the size_report target of the armgcc Makefile to show what the release log profile
+saves over the debug one:
+
+    size_report.py --size arm-none-eabi-size _build_debug _build_release
+
+Object sizes are taken before the linker drops unused sections, so they show where the savings
+come from; the totals of the linked images are exact.
+"""
+
+import argparse
+import os
+import subprocess
+
+
+def sizes(size_tool, paths):
+    """Returns (flash, ram) in bytes by file name, from the Berkeley output of size."""
+    if not paths:
+        return {}
+
+    output = subprocess.check_output([size_tool] + paths, universal_newlines=True)
+    result = {}
+    for line in output.splitlines()[1:]:
+        text, data, bss, _, _, path = line.split(None, 5)
+        result[os.path.basename(path)] = (int(text) + int(data), int(data) + int(bss))
+    return result
+
+
+def objects(build_dir, target):
+    object_dir = os.path.join(build_dir, target)
+    return [os.path.join(object_dir, name) for name in sorted(os.listdir(object_dir)) if name.endswith('.o')]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('base', help='output directory of the reference build')
+    parser.add_argument('other', help='output directory of the compared build')
+    parser.add_argument('--size', default='arm-none-eabi-size', help='size tool of the toolchain')
+    parser.add_argument('--target', default='nrf52840_xxaa', help='name of the build target')
+    args = parser.parse_args()
+
+    base = sizes(args.size, objects(args.base, args.target))
+    other = sizes(args.size, objects(args.other, args.target))
+
+    rows = []
+    for name in sorted(set(base) & set(other)):
+        flash_saved = base[name][0] - other[name][0]
+        ram_saved = base[name][1] - other[name][1]
+        if flash_saved or ram_saved:
+            rows.append((name, base[name][0], other[name][0], flash_saved, ram_saved))
+
+    rows.sort(key=lambda row: row[3], reverse=True)
+
+    print('%-36s %10s %10s %12s %10s' % ('object', 'flash', 'flash new', 'flash saved', 'ram saved'))
+    for row in rows:
+        print('%-36s %10d %10d %12d %10d' % row)
+
+    image = args.target + '.out'
+    base_image = sizes(args.size, [os.path.join(args.base, image)])[image]
+    other_image = sizes(args.size, [os.path.join(args.other, image)])[image]
+
+    print()
+    print('%-36s %10d %10d %12d %10d' % ('image ' + image, base_image[0], other_image[0],
+                                         base_image[0] - other_image[0], base_image[1] - other_image[1]))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,165 @@
+/** @file
+ *
+ * @brief Host check of the telemetry codec.
+ *
+ * @details Encodes a simulated four-channel sensor stream, passes it through a lossy link with
+ *          acknowledgements and decodes it again. Single messages are lost before the gateway
+ *          and not acknowledged, bursts are lost behind the gateway after being acknowledged. Reports the encoded size per sample and fails if
+ *          a decoded sample differs from the encoded one. Build and run from this directory:
+ *
+ *          cc -O2 -I.. -I$SDK_ROOT/components/drivers_nrf/nrf_soc_nosd \
+ *             ../telemetry_codec.c telemetry_codec_bench.c -o telemetry_codec_bench
+ *          ./telemetry_codec_bench
+ *
+ *          Bursts are longer than the decoder history and than 16 messages, so that sequence
+ *          number aliasing would show up as mismatches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "telemetry_codec.h"
+
+#define CHANNELS       4                                               /**< Channels per sample: temperature, humidity, pressure, counter. */
+#define SAMPLES        100000                                          /**< Samples per scenario. */
+
+/**@brief Link behaviour of a scenario. */
+typedef struct
+{
+    const char * p_name;                                               /**< Scenario name. */
+    unsigned     loss_percent;                                         /**< Probability of losing a message before the gateway. */
+    unsigned     burst_permille;                                       /**< Probability of starting a burst loss behind the gateway. */
+    unsigned     burst_len;                                            /**< Messages lost in a burst. */
+} scenario_t;
+
+/**@brief Results of a scenario. */
+typedef struct
+{
+    uint32_t sent;                                                     /**< Messages encoded. */
+    uint32_t bytes;                                                    /**< Encoded bytes. */
+    uint32_t decoded;                                                  /**< Samples decoded. */
+    uint32_t not_found;                                                /**< Deltas dropped for a missing reference. */
+    uint32_t mismatches;                                               /**< Samples decoded to wrong values. */
+} result_t;
+
+
+/**@brief Generates the next sample of a slowly drifting sensor. */
+static void sample_next(int32_t * p_values)
+{
+    p_values[0] += (rand() % 3) - 1;
+    p_values[1] += (rand() % 3) - 1;
+    p_values[2] += (rand() % 5) - 2;
+    p_values[3] += 1;
+}
+
+
+static void scenario_run(const scenario_t * p_scenario, result_t * p_result)
+{
+    static telemetry_codec_encoder_t encoder;
+    static telemetry_codec_decoder_t decoder;
+    int32_t                          values[CHANNELS] = {215, 40, 101300, 0};
+    unsigned                         burst            = 0;
+
+    memset(p_result, 0, sizeof(*p_result));
+    telemetry_codec_encoder_init(&encoder, CHANNELS);
+    telemetry_codec_decoder_init(&decoder, CHANNELS);
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        uint8_t  message[TELEMETRY_CODEC_SIZE_MAX(CHANNELS)];
+        uint16_t len = sizeof(message);
+        int32_t  decoded[CHANNELS];
+        uint16_t msg_id = (uint16_t)(i + 1);
+
+        sample_next(values);
+
+        if (telemetry_codec_encode(&encoder, values, message, &len) != NRF_SUCCESS)
+        {
+            p_result->mismatches++;
+            continue;
+        }
+
+        telemetry_codec_sent(&encoder, msg_id);
+        p_result->sent++;
+        p_result->bytes += len;
+
+        if ((unsigned)(rand() % 100) < p_scenario->loss_percent)
+        {
+            continue;
+        }
+
+        // The gateway acknowledges what it receives, but may fail to forward it.
+        telemetry_codec_acked(&encoder, msg_id);
+
+        if ((burst == 0) && ((unsigned)(rand() % 1000) < p_scenario->burst_permille))
+        {
+            burst = p_scenario->burst_len;
+        }
+
+        if (burst != 0)
+        {
+            burst--;
+            continue;
+        }
+
+        switch (telemetry_codec_decode(&decoder, message, len, decoded))
+        {
+            case NRF_SUCCESS:
+                p_result->decoded++;
+
+                if (memcmp(decoded, values, sizeof(decoded)) != 0)
+                {
+                    p_result->mismatches++;
+                }
+                break;
+
+            case NRF_ERROR_NOT_FOUND:
+                p_result->not_found++;
+                break;
+
+            default:
+                p_result->mismatches++;
+                break;
+        }
+    }
+}
+
+
+int main(void)
+{
+    static const scenario_t scenarios[] =
+    {
+        {"lossless",  0,  0,  0},
+        {"loss 10%", 10,  0,  0},
+        {"burst 16",  2, 10, 16},
+        {"burst 40",  2, 10, 40},
+    };
+    uint32_t                mismatches = 0;
+
+    printf("%u channels, %u raw bytes per sample\n", CHANNELS, (unsigned)(CHANNELS * sizeof(int32_t)));
+    printf("%-10s %8s %7s %10s %10s\n", "link", "bytes", "ratio", "not_found", "mismatch");
+
+    srand(1);
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        result_t result;
+        double   size;
+
+        scenario_run(&scenarios[i], &result);
+        size = (double)result.bytes / result.sent;
+
+        printf("%-10s %8.2f %7.2f %10u %10u\n",
+               scenarios[i].p_name,
+               size,
+               CHANNELS * sizeof(int32_t) / size,
+               (unsigned)result.not_found,
+               (unsigned)result.mismatches);
+
+        mismatches += result.mismatches;
+    }
+
+    return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}